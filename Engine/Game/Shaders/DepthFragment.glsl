@@ -0,0 +1,5 @@
+#version 460
+
+//Depth only, the pre-pass writes no color
+void main() {
+}
@@ -0,0 +1,40 @@
+#version 460
+layout(location=0) in vec3 my_vertex_position;
+
+layout(location = 0) uniform mat4 model;
+layout(location = 1) uniform uint draw_offset;
+
+layout(std140, row_major, binding = 0) uniform Frame
+{
+	mat4 view;
+	mat4 proj;
+	vec3 camera_position;
+	vec3 light_color;
+	vec3 light_direction;
+	vec3 ambient_color;
+};
+
+layout(std430, binding = 2) readonly buffer Instances
+{
+	mat4 instances[];
+};
+
+layout(std430, binding = 3) readonly buffer Draws
+{
+	uint first_visible[];
+};
+
+layout(std430, binding = 4) readonly buffer Visible
+{
+	uint visible_instances[];
+};
+
+//Same transform as VertexShader.glsl so both passes write identical depths
+invariant gl_Position;
+
+void main()
+{
+	mat4 world = model*instances[visible_instances[first_visible[draw_offset + gl_DrawID] + gl_InstanceID]];
+	vec3 surface_position = (world*vec4(my_vertex_position,1.0)).xyz;
+	gl_Position = proj*view*vec4(surface_position, 1.0);
+}
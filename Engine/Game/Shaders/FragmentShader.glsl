@@ -1,27 +1,146 @@
-#version 330
+#version 460
+//HAS_UV, HAS_BASE_COLOR_MAP, HAS_OCCLUSION_MAP and HAS_NORMAL_MAP are defined by ShaderPermutations
+//right after #version. Maps are only defined together with HAS_UV.
 
 //in vec4 color;
 out vec4 outColor;
 
-uniform float diffuse_constant;
-uniform float specular_constant;
-uniform float n;
-uniform vec3 light_color;
-uniform vec3 light_direction;
-uniform vec3 ambient_color;
-uniform vec3 camera_position;
+layout(std140, row_major, binding = 0) uniform Frame
+{
+	mat4 view;
+	mat4 proj;
+	vec3 camera_position;
+	vec3 light_color;
+	vec3 light_direction;
+	vec3 ambient_color;
+	vec3 camera_front;
+	vec4 cluster_depth; //near, far, scale and bias from log(depth) to slice
+	vec4 viewport; //Size of the render target in xy
+	uvec4 cluster_grid; //Clusters in xyz, light count in w
+};
 
-uniform sampler2D diffuse_texture;
+layout(std140, binding = 1) uniform Material
+{
+	float diffuse_constant;
+	float specular_constant;
+	float shininess;
+};
+
+struct Light
+{
+	vec4 position_radius;
+	vec4 color_intensity;
+	vec4 direction_cos_outer; //w = -1 for point lights
+	vec4 cos_inner;
+};
+
+layout(std430, binding = 5) readonly buffer Lights
+{
+	Light lights[];
+};
+
+//Offset into light_indices and light count of every cluster
+layout(std430, binding = 6) readonly buffer Clusters
+{
+	uvec2 clusters[];
+};
+
+layout(std430, binding = 7) readonly buffer LightIndices
+{
+	uint light_indices[];
+};
+
+#ifdef HAS_BASE_COLOR_MAP
+layout(binding = 0) uniform sampler2D diffuse_texture;
+#endif
+#ifdef HAS_OCCLUSION_MAP
+layout(binding = 1) uniform sampler2D orm_texture;
+#endif
+#ifdef HAS_NORMAL_MAP
+layout(binding = 2) uniform sampler2D normal_texture;
+#endif
 
 in vec3 surface_normal;
 in vec3 surface_position;
+#ifdef HAS_UV
 in vec2 uv0;
+#endif
+
+#ifdef HAS_NORMAL_MAP
+//There are no vertex tangents, the frame is rebuilt from screen space derivatives of the position
+//and uv, like the glTF sample viewer does. XY come from the BC5 texture, Z is rebuilt.
+//Degenerate uv (all texels of the pixel on a line) have no frame, the surface normal is kept.
+vec3 NormalFromMap(vec3 nnormal)
+{
+	vec2 uv_dx = dFdx(uv0);
+	vec2 uv_dy = dFdy(uv0);
+	float determinant = uv_dx.s * uv_dy.t - uv_dy.s * uv_dx.t;
+	if (abs(determinant) < 1e-12)
+	{
+		return nnormal;
+	}
+	vec3 t_ = (uv_dy.t * dFdx(surface_position) - uv_dx.t * dFdy(surface_position)) / determinant;
+	vec3 t = normalize(t_ - nnormal * dot(nnormal, t_));
+	vec3 b = cross(nnormal, t);
+	vec3 tangent_normal;
+	tangent_normal.xy = texture(normal_texture, uv0).xy * 2.0 - 1.0;
+	tangent_normal.z = sqrt(max(1.0 - dot(tangent_normal.xy, tangent_normal.xy), 0.0));
+	return normalize(mat3(t, b, nnormal) * tangent_normal);
+}
+#endif
+
+uint ClusterIndex()
+{
+	float depth = dot(surface_position - camera_position, camera_front);
+	float slice = clamp(floor(log(max(depth, cluster_depth.x)) * cluster_depth.z + cluster_depth.w), 0.0, float(cluster_grid.z - 1u));
+	uvec2 tile = uvec2(clamp(gl_FragCoord.xy / viewport.xy * vec2(cluster_grid.xy), vec2(0.0), vec2(cluster_grid.xy - 1u)));
+	return tile.x + tile.y * cluster_grid.x + uint(slice) * cluster_grid.x * cluster_grid.y;
+}
+
+//Same Phong terms as the directional light, with a windowed inverse square falloff that reaches 0 at the radius
+vec3 ClusteredLights(vec3 nnormal, vec3 diffuse_color)
+{
+	vec3 result = vec3(0.0);
+	uvec2 cluster = clusters[ClusterIndex()];
+	vec3 V = normalize(camera_position - surface_position);
+	for (uint i = 0u; i < cluster.y; ++i)
+	{
+		Light light = lights[light_indices[cluster.x + i]];
+		vec3 L = light.position_radius.xyz - surface_position;
+		float light_distance = length(L);
+		L /= light_distance;
+		float window = clamp(1.0 - pow(light_distance / light.position_radius.w, 4.0), 0.0, 1.0);
+		float attenuation = window * window / (light_distance * light_distance + 1.0);
+		if (light.direction_cos_outer.w > -1.0)
+		{
+			attenuation *= smoothstep(light.direction_cos_outer.w, light.cos_inner.x, dot(-L, light.direction_cos_outer.xyz));
+		}
+		float NdotL = max(dot(nnormal, L), 0.0);
+		vec3 radiance = light.color_intensity.rgb * light.color_intensity.a * attenuation;
+		vec3 R = reflect(-L, nnormal);
+		result += (diffuse_constant * diffuse_color * NdotL + specular_constant * pow(max(dot(R, V), 0.0), shininess)) * radiance;
+	}
+	return result;
+}
 
 void main() {
 	vec3 nnormal =  normalize(surface_normal);
+#ifdef HAS_NORMAL_MAP
+	nnormal = NormalFromMap(nnormal);
+#endif
 	vec3 nlight_direction = normalize(light_direction);
 	//vec3 diffuse_color = vec3(0.3,0.3,1.0);
+#ifdef HAS_BASE_COLOR_MAP
 	vec3 diffuse_color = texture(diffuse_texture, uv0).xyz;
+#else
+	vec3 diffuse_color = vec3(1.0);
+#endif
+#ifdef HAS_OCCLUSION_MAP
+	float occlusion = texture(orm_texture, uv0).r;
+#else
+	float occlusion = 1.0;
+#endif
+	vec3 ambient = ambient_color*diffuse_color*occlusion;
    //outColor = vec4(color);
    //outColor = vec4(0.3,0.3,1.0, 1.0);
    float NdotL = max(dot(nnormal, nlight_direction),0.0);
@@ -34,15 +153,15 @@ void main() {
    vec3 R = reflect(nlight_direction,nnormal);
    //vec3 R = reflect(nnormal , nlight_direction);
    float RdotV = max(dot(R,V),0.0);
-   vec3 specular = specular_constant * light_color * pow(RdotV,n);
+   vec3 specular = specular_constant * light_color * pow(RdotV,shininess);
    
-   vec3 color = ambient_color*diffuse_color + diffuse + specular; 
+   vec3 color = ambient + diffuse + specular + ClusteredLights(nnormal, diffuse_color); 
    outColor = vec4(color, 1.0);
-   //outColor = vec4(ambient_color*diffuse_color + diffuse_constant*diffuse_color*light_color*max(dot(nnormal, nlight_direction),0.0) + specular_constant * light_color * pow(max(dot(V,R),0.0),n),1.0);
+   //outColor = vec4(ambient_color*diffuse_color + diffuse_constant*diffuse_color*light_color*max(dot(nnormal, nlight_direction),0.0) + specular_constant * light_color * pow(max(dot(V,R),0.0),shininess),1.0);
    
   }else{
   
-  outColor =  vec4(diffuse_color*ambient_color,1.0);
+  outColor =  vec4(ambient + ClusteredLights(nnormal, diffuse_color),1.0);
   }
 
    
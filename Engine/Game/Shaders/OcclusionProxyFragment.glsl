@@ -0,0 +1,8 @@
+#version 460
+
+//Color writes are masked while the proxies are drawn, only the samples passed count
+out vec4 outColor;
+
+void main() {
+	outColor = vec4(1.0);
+}
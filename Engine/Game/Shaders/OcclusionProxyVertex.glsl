@@ -0,0 +1,19 @@
+#version 460
+layout(location=0) in vec3 position;
+
+layout(location = 0) uniform mat4 box;
+
+layout(std140, row_major, binding = 0) uniform Frame
+{
+	mat4 view;
+	mat4 proj;
+	vec3 camera_position;
+	vec3 light_color;
+	vec3 light_direction;
+	vec3 ambient_color;
+};
+
+void main()
+{
+	gl_Position = proj*view*box*vec4(position, 1.0);
+}
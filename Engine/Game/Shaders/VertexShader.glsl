@@ -1,20 +1,62 @@
 #version 460
+//HAS_UV and the map features are defined by ShaderPermutations right after #version
 layout(location=0) in vec3 my_vertex_position;
+#ifdef HAS_UV
 layout(location=1) in vec2 vertex_uv0;
+#endif
 layout(location=2) in vec3 normal;
 
 layout(location = 0) uniform mat4 model;
-layout(location = 1) uniform mat4 view;
-layout(location = 2) uniform mat4 proj;
+layout(location = 1) uniform uint draw_offset;
+
+layout(std140, row_major, binding = 0) uniform Frame
+{
+	mat4 view;
+	mat4 proj;
+	vec3 camera_position;
+	vec3 light_color;
+	vec3 light_direction;
+	vec3 ambient_color;
+	vec3 camera_front;
+	vec4 cluster_depth; //near, far, scale and bias from log(depth) to slice
+	vec4 viewport; //Size of the render target in xy
+	uvec4 cluster_grid; //Clusters in xyz, light count in w
+};
+
+//Column major transforms of every instance in the model
+layout(std430, binding = 2) readonly buffer Instances
+{
+	mat4 instances[];
+};
+
+//Per draw data of the current glMultiDrawElementsIndirect, indexed by draw_offset + gl_DrawID
+layout(std430, binding = 3) readonly buffer Draws
+{
+	uint first_visible[];
+};
+
+//Instances that passed culling this frame, grouped per draw
+layout(std430, binding = 4) readonly buffer Visible
+{
+	uint visible_instances[];
+};
+
+//Must match DepthVertex.glsl bit for bit, the main pass tests GL_EQUAL against the pre-pass
+invariant gl_Position;
 
 out vec3 surface_normal;
 out vec3 surface_position;
+#ifdef HAS_UV
 out vec2 uv0;
+#endif
 
 void main()
 {
-	surface_normal = transpose(inverse(mat3(model))) * normal;
-	surface_position = (model*vec4(my_vertex_position,1.0)).xyz;
-	gl_Position = proj*view*model*vec4(my_vertex_position, 1.0);
+	mat4 world = model*instances[visible_instances[first_visible[draw_offset + gl_DrawID] + gl_InstanceID]];
+	surface_normal = transpose(inverse(mat3(world))) * normal;
+	surface_position = (world*vec4(my_vertex_position,1.0)).xyz;
+	gl_Position = proj*view*vec4(surface_position, 1.0);
+#ifdef HAS_UV
 	uv0 = vertex_uv0;
+#endif
 }
@@ -9,25 +9,36 @@
 #include "ModuleDebugDraw.h"
 #include "ModuleCamera.h"
 #include "ModuleTexture.h"
+#include "RenderThread.h"
+#include "FrameLimiter.h"
+#include "ModuleHeadless.h"
 
 
 
 using namespace std;
 
-Application::Application()
+Application::Application(const HeadlessSettings* headlessSettings)
 {
 	vectorPos = 0;
 	frameRate.resize(100);
 	milliSeconds.resize(100);
+	workMilliseconds.resize(100);
+	limiter = new FrameLimiter();
 	// Order matters: they will Init/start/update in this order
 	modules.push_back(window = new ModuleWindow());
 	modules.push_back(render = new ModuleOpenGL());
 	modules.push_back(input = new ModuleInput());
 	modules.push_back(camera = new ModuleCamera());
 	modules.push_back(render_exercise = new ModuleRenderExercise());
-	modules.push_back(editor = new ModuleEditor());
+	if (headlessSettings == nullptr) {
+		modules.push_back(editor = new ModuleEditor());
+	}
 	modules.push_back(debug_draw = new ModuleDebugDraw());
 	modules.push_back(textureModule = new ModuleTexture());
+	if (headlessSettings != nullptr) {
+		//Last, so its Init sees a loaded renderer and its PostUpdate runs once the frame is submitted
+		modules.push_back(headless = new ModuleHeadless(*headlessSettings));
+	}
 
 
 
@@ -39,6 +50,7 @@ Application::~Application()
     {
         delete *it;
     }
+	delete limiter;
 }
 
 bool Application::Init()
@@ -48,12 +60,15 @@ bool Application::Init()
 	for(list<Module*>::iterator it = modules.begin(); it != modules.end() && ret; ++it)
 		ret = (*it)->Init();
 
+	limiter->Init();
+
 	return ret;
 }
 
 update_status Application::Update()
 {
-	Uint64 start = SDL_GetPerformanceCounter();
+	//In low latency mode this is where the frame waits, before input is polled
+	limiter->BeginFrame();
 	update_status ret = UPDATE_CONTINUE;
 
 	for(list<Module*>::iterator it = modules.begin(); it != modules.end() && ret == UPDATE_CONTINUE; ++it)
@@ -65,11 +80,12 @@ update_status Application::Update()
 	for(list<Module*>::iterator it = modules.begin(); it != modules.end() && ret == UPDATE_CONTINUE; ++it)
 		ret = (*it)->PostUpdate();
 
-	
-	Uint64 end = SDL_GetPerformanceCounter();
+	limiter->EndFrame();
 
-	frameRate[vectorPos] = 1.0f / ((end - start) / (float)SDL_GetPerformanceFrequency());
-	milliSeconds[vectorPos] = (end - start) / (float)SDL_GetPerformanceFrequency()*1000.0f;
+	float interval = limiter->GetIntervalMs();
+	frameRate[vectorPos] = interval > 0.0f ? 1000.0f / interval : 0.0f;
+	milliSeconds[vectorPos] = interval;
+	workMilliseconds[vectorPos] = limiter->GetWorkMs();
 
 	if (vectorPos != frameRate.size() - 1) {
 		vectorPos++;
@@ -78,6 +94,7 @@ update_status Application::Update()
 		for (int i = 0; i < frameRate.size() -1; i++) {
 			frameRate[i] = frameRate[i + 1];
 			milliSeconds[i] = milliSeconds[i + 1];
+			workMilliseconds[i] = workMilliseconds[i + 1];
 		}
 	}
 
@@ -88,14 +105,23 @@ bool Application::CleanUp()
 {
 	bool ret = true;
 
+	//Modules release GL objects on the way out, the context has to be back on this thread first
+	render->GetRenderThread()->Stop();
+
 	for(list<Module*>::reverse_iterator it = modules.rbegin(); it != modules.rend() && ret; ++it)
 		ret = (*it)->CleanUp();
 
+	limiter->CleanUp();
+
 	return ret;
 }
 
 
 void Application::RequestBrowser(const char* url) {
+#ifdef _WIN32
 	ShellExecuteA(NULL, "open", url, NULL, NULL, 0);
+#else
+	SDL_OpenURL(url);
+#endif
 }
 
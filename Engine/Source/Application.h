@@ -16,12 +16,16 @@ class ModuleEditor;
 class ModuleDebugDraw;
 class ModuleCamera;
 class ModuleTexture;
+class FrameLimiter;
+class ModuleHeadless;
+struct HeadlessSettings;
 
 class Application
 {
 public:
 
-	Application();
+	//With headless settings the editor is left out and ModuleHeadless drives the run
+	Application(const HeadlessSettings* headlessSettings = nullptr);
 	~Application();
 
 	bool Init();
@@ -36,10 +40,14 @@ public:
     ModuleCamera* GetCamera() { return camera; }
     ModuleTexture* GetTextureModule() { return textureModule; }
     ModuleRenderExercise* GetModuleRenderExercise() { return render_exercise; }
+    ModuleHeadless* GetHeadless() { return headless; }
+    bool IsHeadless() const { return headless != nullptr; }
     
     void RequestBrowser(const char* url);
     const std::vector<float>* GetFrameRate() { return &frameRate; };
     const std::vector<float>* GetMilliseconds() { return &milliSeconds; };
+    const std::vector<float>* GetWorkMilliseconds() { return &workMilliseconds; };
+    FrameLimiter* GetFrameLimiter() { return limiter; }
 
 
 private:
@@ -52,11 +60,14 @@ private:
     ModuleDebugDraw* debug_draw = nullptr;
     ModuleCamera* camera = nullptr;
     ModuleTexture* textureModule = nullptr;
+    ModuleHeadless* headless = nullptr;
 
 
    
     std::vector<float> frameRate;
-    std::vector<float> milliSeconds;
+    std::vector<float> milliSeconds; //Interval between frame starts, including any pacing wait
+    std::vector<float> workMilliseconds; //Part of each frame spent working
+    FrameLimiter* limiter = nullptr;
     int vectorPos = 0;
 
     std::list<Module*> modules;
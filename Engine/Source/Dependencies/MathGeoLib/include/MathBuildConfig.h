@@ -17,10 +17,15 @@
 	@brief Specifies all build flags for the library. */
 #pragma once
 
-#if !defined(WIN32)
+#if defined(_WIN32) && !defined(WIN32)
 #define WIN32
 #endif
 
+// sprintf_s is MSVC only, snprintf takes the same arguments
+#if !defined(_MSC_VER) && !defined(sprintf_s)
+#define sprintf_s snprintf
+#endif
+
 // Ric
 // Warning disabled ---
 #pragma warning( disable : 4577 ) // Warning that exceptions are disabled
@@ -16,7 +16,9 @@
 /** @file Clock.h
 	@brief The Clock class. Supplies timing facilities. */
 
+#if defined(_WIN32) && !defined(WIN32)
 #define WIN32
+#endif
 
 #ifdef WIN32
 #define Polygon Polygon_unused
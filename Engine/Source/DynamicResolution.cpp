@@ -0,0 +1,101 @@
+#include "DynamicResolution.h"
+#include "Globals.h"
+#include "GLState.h"
+#include <GL/glew.h>
+#include <algorithm>
+#include <cmath>
+
+//Frames averaged for every adjustment
+#define DYNAMIC_RESOLUTION_SAMPLES 8
+//Frame times within this fraction of the target leave the scale alone
+#define DYNAMIC_RESOLUTION_DEAD_BAND 0.05f
+//Fraction of the full correction applied per frame
+#define DYNAMIC_RESOLUTION_DAMPING 0.25f
+
+DynamicResolution::DynamicResolution() {
+
+}
+
+DynamicResolution::~DynamicResolution() {
+
+}
+
+//The history is zero filled until Application has recorded that many frames
+void DynamicResolution::Update(const std::vector<float>& milliSeconds) {
+	float total = 0.0f;
+	int samples = 0;
+	for (auto it = milliSeconds.rbegin(); it != milliSeconds.rend() && samples < DYNAMIC_RESOLUTION_SAMPLES; ++it) {
+		if (*it > 0.0f) {
+			total += *it;
+			++samples;
+		}
+	}
+	if (samples == 0) {
+		return;
+	}
+	measuredMs = total / samples;
+
+	if (!enabled) {
+		scale = std::min(std::max(1.0f, minScale), maxScale);
+		return;
+	}
+	float ratio = targetMs / measuredMs;
+	if (fabsf(ratio - 1.0f) > DYNAMIC_RESOLUTION_DEAD_BAND) {
+		float wanted = scale * sqrtf(ratio);
+		scale += (wanted - scale) * DYNAMIC_RESOLUTION_DAMPING;
+	}
+	scale = std::min(std::max(scale, minScale), maxScale);
+}
+
+void DynamicResolution::Allocate(unsigned width, unsigned height) {
+	Destroy();
+	this->width = width;
+	this->height = height;
+
+	glGenTextures(1, &colorTexture);
+	GLState::BindTexture(0, colorTexture);
+	glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGBA8, width, height);
+	GLState::BindTexture(0, 0);
+
+	glGenRenderbuffers(1, &depthBuffer);
+	glBindRenderbuffer(GL_RENDERBUFFER, depthBuffer);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height);
+	glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+	glGenFramebuffers(1, &framebuffer);
+	glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, colorTexture, 0);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, depthBuffer);
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+		LOG("Dynamic resolution: framebuffer %ux%u is incomplete", width, height);
+	}
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void DynamicResolution::Begin(unsigned windowWidth, unsigned windowHeight, unsigned renderWidth, unsigned renderHeight, float maxScale) {
+	unsigned neededWidth = std::max((unsigned)ceilf(windowWidth * maxScale), renderWidth);
+	unsigned neededHeight = std::max((unsigned)ceilf(windowHeight * maxScale), renderHeight);
+	if (framebuffer == 0 || neededWidth > width || neededHeight > height) {
+		Allocate(std::max(neededWidth, width), std::max(neededHeight, height));
+	}
+
+	glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+	glViewport(0, 0, renderWidth, renderHeight);
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+}
+
+void DynamicResolution::End(unsigned windowWidth, unsigned windowHeight, unsigned renderWidth, unsigned renderHeight, unsigned outputFramebuffer) {
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, outputFramebuffer);
+	glBlitFramebuffer(0, 0, renderWidth, renderHeight, 0, 0, windowWidth, windowHeight, GL_COLOR_BUFFER_BIT, GL_LINEAR);
+	glBindFramebuffer(GL_FRAMEBUFFER, outputFramebuffer);
+	glViewport(0, 0, windowWidth, windowHeight);
+}
+
+void DynamicResolution::Destroy() {
+	glDeleteFramebuffers(1, &framebuffer);
+	GLState::DeleteTextures(1, &colorTexture);
+	glDeleteRenderbuffers(1, &depthBuffer);
+	framebuffer = colorTexture = depthBuffer = 0;
+	width = height = 0;
+}
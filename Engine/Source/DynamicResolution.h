@@ -0,0 +1,40 @@
+#pragma once
+#include <vector>
+
+// Renders the scene into an offscreen target whose resolution follows the measured frame time,
+// then stretches it over the window. Pixel cost grows with the square of the scale, so every
+// adjustment moves the scale by the square root of target / measured, damped and with a dead band
+// so it does not chase noise.
+// The target is allocated for the largest allowed scale and rendered into a corner of it, changing
+// the scale never reallocates.
+class DynamicResolution
+{
+public:
+	DynamicResolution();
+	~DynamicResolution();
+
+	//Main thread, once per frame with the frame time history kept by Application
+	void Update(const std::vector<float>& milliSeconds);
+	//Render thread: bind the target and clear it, then blit it to the default framebuffer
+	void Begin(unsigned windowWidth, unsigned windowHeight, unsigned renderWidth, unsigned renderHeight, float maxScale);
+	void End(unsigned windowWidth, unsigned windowHeight, unsigned renderWidth, unsigned renderHeight, unsigned outputFramebuffer);
+	void Destroy();
+
+	inline float GetScale() const { return enabled ? scale : 1.0f; }
+	inline float GetMeasuredMs() const { return measuredMs; }
+
+	bool enabled = false;
+	float targetMs = 16.6f;
+	float minScale = 0.5f;
+	float maxScale = 1.0f;
+
+private:
+	void Allocate(unsigned width, unsigned height);
+
+	float scale = 1.0f;
+	float measuredMs = 0.0f;
+	unsigned framebuffer = 0;
+	unsigned colorTexture = 0;
+	unsigned depthBuffer = 0;
+	unsigned width = 0, height = 0;
+};
@@ -0,0 +1,94 @@
+#include "FrameLimiter.h"
+#include "Globals.h"
+#include "SDL.h"
+#include <thread>
+#ifdef _WIN32
+#pragma comment( lib, "winmm.lib" )
+#endif
+
+//Below this the wait spins, SDL_Delay is only good to about a millisecond even with timeBeginPeriod(1)
+#define FRAME_LIMITER_SPIN_MS 2.0
+//Weight of the newest frame in the work prediction
+#define FRAME_LIMITER_PREDICTION_WEIGHT 0.1f
+//Extra margin a low latency frame starts with on top of the prediction
+#define FRAME_LIMITER_LATENCY_MARGIN_MS 1.0f
+
+FrameLimiter::FrameLimiter() {
+
+}
+
+FrameLimiter::~FrameLimiter() {
+
+}
+
+void FrameLimiter::Init() {
+#ifdef _WIN32
+	timeBeginPeriod(1);
+#endif
+	frequency = SDL_GetPerformanceFrequency();
+	frameStart = SDL_GetPerformanceCounter();
+}
+
+void FrameLimiter::CleanUp() {
+#ifdef _WIN32
+	timeEndPeriod(1);
+#endif
+}
+
+uint64_t FrameLimiter::Period() const {
+	return maxFps > 0 ? frequency / maxFps : 0;
+}
+
+void FrameLimiter::WaitUntil(uint64_t deadline) const {
+	while (true) {
+		uint64_t now = SDL_GetPerformanceCounter();
+		if (now >= deadline) {
+			return;
+		}
+		double remainingMs = (deadline - now) * 1000.0 / frequency;
+		if (remainingMs > FRAME_LIMITER_SPIN_MS) {
+			SDL_Delay((Uint32)(remainingMs - FRAME_LIMITER_SPIN_MS));
+		}
+		else {
+			std::this_thread::yield();
+		}
+	}
+}
+
+void FrameLimiter::BeginFrame() {
+	const uint64_t period = Period();
+	if (period != 0 && lowLatency && deadline != 0) {
+		uint64_t early = (uint64_t)((predictedWorkMs + FRAME_LIMITER_LATENCY_MARGIN_MS) * frequency / 1000.0f);
+		if (deadline > early) {
+			WaitUntil(deadline - early);
+		}
+	}
+
+	uint64_t now = SDL_GetPerformanceCounter();
+	intervalMs = (now - frameStart) * 1000.0f / frequency;
+	frameStart = now;
+}
+
+void FrameLimiter::EndFrame() {
+	uint64_t now = SDL_GetPerformanceCounter();
+	workMs = (now - frameStart) * 1000.0f / frequency;
+	predictedWorkMs += (workMs - predictedWorkMs) * FRAME_LIMITER_PREDICTION_WEIGHT;
+
+	const uint64_t period = Period();
+	if (period == 0) {
+		deadline = 0;
+		return;
+	}
+	//deadline is when the next frame should start, one period after this one's slot
+	if (deadline == 0) {
+		deadline = frameStart;
+	}
+	deadline += period;
+	//A frame that missed its slot by more than a whole period restarts the schedule instead of rushing to catch up
+	if (now > deadline + period) {
+		deadline = now;
+	}
+	if (!lowLatency) {
+		WaitUntil(deadline);
+	}
+}
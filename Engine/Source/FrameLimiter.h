@@ -0,0 +1,39 @@
+#pragma once
+#include <cstdint>
+
+// Caps the frame rate against a fixed schedule of deadlines, so a late frame does not push every
+// following one back. Waits sleep while the deadline is far and spin for the last couple of
+// milliseconds, where sleeping would overshoot.
+// In low latency mode the wait moves from the end of the frame to its start, just before input is
+// polled, and ends early by the predicted frame cost: frames are shown at the same cadence but the
+// input they use is as fresh as possible.
+class FrameLimiter
+{
+public:
+	FrameLimiter();
+	~FrameLimiter();
+
+	void Init();
+	void CleanUp();
+	void BeginFrame();
+	void EndFrame();
+
+	//Time from the previous frame's start to this one's, what the user sees
+	inline float GetIntervalMs() const { return intervalMs; }
+	//Time this frame spent working, the interval minus any pacing wait
+	inline float GetWorkMs() const { return workMs; }
+
+	int maxFps = 0; //0 leaves the rate to vsync or the hardware
+	bool lowLatency = false;
+
+private:
+	void WaitUntil(uint64_t deadline) const;
+	uint64_t Period() const;
+
+	uint64_t frequency = 0;
+	uint64_t frameStart = 0;
+	uint64_t deadline = 0;
+	float intervalMs = 0.0f;
+	float workMs = 0.0f;
+	float predictedWorkMs = 0.0f; //Moving average, how early a low latency frame has to start
+};
@@ -0,0 +1,165 @@
+#include "FrameProfiler.h"
+#include "SDL.h"
+#include <GL/glew.h>
+
+//Queries are generated in blocks as passes are added, never freed until Destroy
+#define FRAME_PROFILER_QUERY_BLOCK 16
+
+FrameProfiler::FrameProfiler() {
+
+}
+
+FrameProfiler::~FrameProfiler() {
+
+}
+
+void FrameProfiler::Destroy() {
+	for (GpuFrame& frame : gpuFrames) {
+		if (!frame.queries.empty()) {
+			glDeleteQueries((GLsizei)frame.queries.size(), frame.queries.data());
+		}
+		frame.queries.clear();
+		frame.zones.clear();
+		frame.used = 0;
+		frame.issued = false;
+	}
+	recording = nullptr;
+}
+
+//Frames are read oldest first as soon as their last timestamp is available. The slot about to be
+//reused is dropped if it is still not, waiting for it would stall the pipeline this measures.
+void FrameProfiler::BeginGpuFrame(bool enabled) {
+	GpuFrame& next = gpuFrames[gpuFrameNumber % FRAME_PROFILER_LATENCY];
+	for (unsigned age = FRAME_PROFILER_LATENCY; age > 0; --age) {
+		if (gpuFrameNumber < age) {
+			continue;
+		}
+		GpuFrame& frame = gpuFrames[(gpuFrameNumber - age) % FRAME_PROFILER_LATENCY];
+		if (frame.issued && IsAvailable(frame)) {
+			ReadBack(frame);
+			frame.issued = false;
+		}
+	}
+	if (next.issued) {
+		++droppedFrames;
+		next.issued = false;
+	}
+
+	recording = nullptr;
+	gpuStack.clear();
+	if (enabled) {
+		recording = &next;
+		recording->used = 0;
+		recording->zones.clear();
+		recording->number = gpuFrameNumber;
+		BeginGpu("Frame");
+	}
+	++gpuFrameNumber;
+}
+
+void FrameProfiler::EndGpuFrame() {
+	if (recording == nullptr) {
+		return;
+	}
+	while (!gpuStack.empty()) {
+		EndGpu();
+	}
+	recording->issued = true;
+	recording = nullptr;
+}
+
+void FrameProfiler::BeginGpu(const char* name) {
+	if (recording == nullptr) {
+		return;
+	}
+	gpuStack.push_back(recording->zones.size());
+	recording->zones.push_back({ name, Timestamp(), 0, (int)gpuStack.size() - 1 });
+}
+
+void FrameProfiler::EndGpu() {
+	if (recording == nullptr || gpuStack.empty()) {
+		return;
+	}
+	recording->zones[gpuStack.back()].end = Timestamp();
+	gpuStack.pop_back();
+}
+
+unsigned FrameProfiler::Timestamp() {
+	if (recording->used == recording->queries.size()) {
+		size_t size = recording->queries.size();
+		recording->queries.resize(size + FRAME_PROFILER_QUERY_BLOCK);
+		glGenQueries(FRAME_PROFILER_QUERY_BLOCK, &recording->queries[size]);
+	}
+	glQueryCounter(recording->queries[recording->used], GL_TIMESTAMP);
+	return recording->used++;
+}
+
+//The frame zone is closed last, once its end is available every other timestamp is too
+bool FrameProfiler::IsAvailable(const GpuFrame& frame) const {
+	GLuint available = GL_FALSE;
+	glGetQueryObjectuiv(frame.queries[frame.zones.front().end], GL_QUERY_RESULT_AVAILABLE, &available);
+	return available == GL_TRUE;
+}
+
+void FrameProfiler::ReadBack(const GpuFrame& frame) {
+	std::vector<uint64_t> times(frame.used);
+	for (unsigned i = 0; i < frame.used; ++i) {
+		GLuint64 time = 0;
+		glGetQueryObjectui64v(frame.queries[i], GL_QUERY_RESULT, &time);
+		times[i] = time;
+	}
+
+	const uint64_t start = times[frame.zones.front().begin];
+	std::vector<ProfilerZone> zones(frame.zones.size());
+	for (size_t i = 0; i < frame.zones.size(); ++i) {
+		const GpuZone& zone = frame.zones[i];
+		zones[i].name = zone.name;
+		zones[i].startMs = (times[zone.begin] - start) / 1000000.0f;
+		zones[i].ms = (times[zone.end] - times[zone.begin]) / 1000000.0f;
+		zones[i].depth = zone.depth;
+	}
+
+	std::lock_guard<std::mutex> lock(mutex);
+	gpuZones.swap(zones);
+	gpuFrameMs = gpuZones.front().ms;
+	gpuLatency = gpuFrameNumber - frame.number;
+}
+
+void FrameProfiler::GetGpuZones(std::vector<ProfilerZone>& zones, float& frameMs) const {
+	std::lock_guard<std::mutex> lock(mutex);
+	zones = gpuZones;
+	frameMs = gpuFrameMs;
+}
+
+void FrameProfiler::BeginCpuFrame() {
+	cpuFrameStart = SDL_GetPerformanceCounter();
+	cpuRecording.clear();
+	cpuStack.clear();
+}
+
+//Zones left open by an early return end with the frame
+void FrameProfiler::EndCpuFrame() {
+	while (!cpuStack.empty()) {
+		EndCpu();
+	}
+	cpuFrameMs = (SDL_GetPerformanceCounter() - cpuFrameStart) * 1000.0f / SDL_GetPerformanceFrequency();
+	cpuZones.swap(cpuRecording);
+}
+
+void FrameProfiler::BeginCpu(const char* name) {
+	ProfilerZone zone;
+	zone.name = name;
+	zone.startMs = (SDL_GetPerformanceCounter() - cpuFrameStart) * 1000.0f / SDL_GetPerformanceFrequency();
+	zone.depth = (int)cpuStack.size();
+	cpuStack.push_back(cpuRecording.size());
+	cpuRecording.push_back(zone);
+}
+
+void FrameProfiler::EndCpu() {
+	if (cpuStack.empty()) {
+		return;
+	}
+	ProfilerZone& zone = cpuRecording[cpuStack.back()];
+	zone.ms = (SDL_GetPerformanceCounter() - cpuFrameStart) * 1000.0f / SDL_GetPerformanceFrequency() - zone.startMs;
+	cpuStack.pop_back();
+}
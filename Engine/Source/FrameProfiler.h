@@ -0,0 +1,94 @@
+#pragma once
+#include <vector>
+#include <mutex>
+#include <atomic>
+#include <cstdint>
+
+//Frames of GPU queries kept in flight, a frame not read back by the time its slot comes round again is dropped
+#define FRAME_PROFILER_LATENCY 4
+
+struct ProfilerZone
+{
+	const char* name = nullptr; //Zones are named with string literals
+	float startMs = 0.0f; //From the start of the frame
+	float ms = 0.0f;
+	int depth = 0;
+};
+
+// Per pass timings of the main thread and of the GPU, laid out as one timeline per frame.
+// GPU zones are pairs of GL_TIMESTAMP queries issued by the render thread around each pass, so
+// they nest and show where a pass starts and not only how long it takes. Every frame has its own
+// pool of queries, and results are only read once GL_QUERY_RESULT_AVAILABLE says so, usually
+// two or three frames later, so the profiler never makes the CPU wait for the GPU.
+// CPU zones are measured with SDL_GetPerformanceCounter around the main thread side of the same passes.
+class FrameProfiler
+{
+public:
+	FrameProfiler();
+	~FrameProfiler();
+
+	//Context current
+	void Destroy();
+
+	//Render thread, recorded first and last in every frame
+	void BeginGpuFrame(bool enabled);
+	void EndGpuFrame();
+	//Render thread, between the two above
+	void BeginGpu(const char* name);
+	void EndGpu();
+
+	//Main thread
+	void BeginCpuFrame();
+	void EndCpuFrame();
+	void BeginCpu(const char* name);
+	void EndCpu();
+
+	//Main thread: the last frame read back from the GPU, GetGpuLatency frames old
+	void GetGpuZones(std::vector<ProfilerZone>& zones, float& frameMs) const;
+	inline unsigned GetGpuLatency() const { return gpuLatency; }
+	inline unsigned GetDroppedFrames() const { return droppedFrames; }
+	//Main thread: the last frame the main thread completed
+	inline const std::vector<ProfilerZone>& GetCpuZones() const { return cpuZones; }
+	inline float GetCpuFrameMs() const { return cpuFrameMs; }
+
+	bool enabled = true;
+
+private:
+	struct GpuZone
+	{
+		const char* name;
+		unsigned begin, end; //Indices into the frame's queries
+		int depth;
+	};
+
+	struct GpuFrame
+	{
+		std::vector<unsigned> queries;
+		unsigned used = 0;
+		std::vector<GpuZone> zones;
+		unsigned number = 0;
+		bool issued = false;
+	};
+
+	unsigned Timestamp();
+	bool IsAvailable(const GpuFrame& frame) const;
+	void ReadBack(const GpuFrame& frame);
+
+	GpuFrame gpuFrames[FRAME_PROFILER_LATENCY];
+	GpuFrame* recording = nullptr; //Null while disabled
+	std::vector<unsigned> gpuStack; //Open zones of the recording frame
+	unsigned gpuFrameNumber = 0;
+	//Written by the render thread outside the mutex, read by the editor
+	std::atomic<unsigned> gpuLatency{ 0 };
+	std::atomic<unsigned> droppedFrames{ 0 };
+
+	mutable std::mutex mutex; //Guards the GPU results, written by the render thread
+	std::vector<ProfilerZone> gpuZones;
+	float gpuFrameMs = 0.0f;
+
+	uint64_t cpuFrameStart = 0;
+	std::vector<ProfilerZone> cpuRecording;
+	std::vector<size_t> cpuStack;
+	std::vector<ProfilerZone> cpuZones;
+	float cpuFrameMs = 0.0f;
+};
@@ -0,0 +1,190 @@
+#include "FrustumCuller.h"
+#include "Geometry/AABB.h"
+#include "Geometry/Frustum.h"
+#include "Geometry/Plane.h"
+#include "Math/MathFunc.h"
+#include "SDL.h"
+#include <immintrin.h>
+#include <random>
+
+FrustumCuller::FrustumCuller() {
+
+}
+
+FrustumCuller::~FrustumCuller() {
+
+}
+
+void FrustumCuller::Clear() {
+	minX.clear(); minY.clear(); minZ.clear();
+	maxX.clear(); maxY.clear(); maxZ.clear();
+	visible.clear();
+	boxCount = 0;
+	visibleCount = 0;
+}
+
+void FrustumCuller::Reserve(unsigned count) {
+	unsigned padded = (count + LANES - 1) / LANES * LANES;
+	minX.reserve(padded); minY.reserve(padded); minZ.reserve(padded);
+	maxX.reserve(padded); maxY.reserve(padded); maxZ.reserve(padded);
+	visible.reserve(padded);
+}
+
+unsigned FrustumCuller::AddBox(const AABB& box) {
+	//Overwrite the padding left by the previous box if there is any
+	minX.resize(boxCount); minY.resize(boxCount); minZ.resize(boxCount);
+	maxX.resize(boxCount); maxY.resize(boxCount); maxZ.resize(boxCount);
+
+	minX.push_back(box.minPoint.x); minY.push_back(box.minPoint.y); minZ.push_back(box.minPoint.z);
+	maxX.push_back(box.maxPoint.x); maxY.push_back(box.maxPoint.y); maxZ.push_back(box.maxPoint.z);
+	++boxCount;
+
+	//Padding boxes are empty at the origin, their results are never read
+	unsigned padded = (boxCount + LANES - 1) / LANES * LANES;
+	minX.resize(padded, 0.0f); minY.resize(padded, 0.0f); minZ.resize(padded, 0.0f);
+	maxX.resize(padded, 0.0f); maxY.resize(padded, 0.0f); maxZ.resize(padded, 0.0f);
+	visible.resize(padded, 1);
+	return boxCount - 1;
+}
+
+void FrustumCuller::SetAllVisible() {
+	for (unsigned i = 0; i < visible.size(); ++i) {
+		visible[i] = 1;
+	}
+	visibleCount = boxCount;
+}
+
+//Later culling stages (occlusion) remove boxes that passed the frustum test
+void FrustumCuller::Hide(unsigned index) {
+	if (visible[index] != 0) {
+		visible[index] = 0;
+		--visibleCount;
+	}
+}
+
+AABB FrustumCuller::GetBox(unsigned index) const {
+	return AABB(float3(minX[index], minY[index], minZ[index]), float3(maxX[index], maxY[index], maxZ[index]));
+}
+
+//Reference path, also used by the benchmark
+void FrustumCuller::CullScalar(const Frustum& frustum) {
+	Plane planes[6];
+	frustum.GetPlanes(planes);
+
+	visibleCount = 0;
+	for (unsigned i = 0; i < boxCount; ++i) {
+		bool inside = true;
+		for (int p = 0; p < 6 && inside; ++p) {
+			const float3& n = planes[p].normal;
+			float distance = fminf(n.x * minX[i], n.x * maxX[i])
+				+ fminf(n.y * minY[i], n.y * maxY[i])
+				+ fminf(n.z * minZ[i], n.z * maxZ[i]) - planes[p].d;
+			inside = distance <= 0.0f;
+		}
+		visible[i] = inside ? 1 : 0;
+		visibleCount += inside ? 1 : 0;
+	}
+}
+
+//min(n*min, n*max) per axis picks the nearest corner without a branch on the normal sign
+void FrustumCuller::Cull(const Frustum& frustum) {
+	Plane planes[6];
+	frustum.GetPlanes(planes);
+
+	visibleCount = 0;
+	const unsigned padded = (unsigned)visible.size();
+
+#ifdef __AVX__
+	__m256 nx[6], ny[6], nz[6], d[6];
+	for (int p = 0; p < 6; ++p) {
+		nx[p] = _mm256_set1_ps(planes[p].normal.x);
+		ny[p] = _mm256_set1_ps(planes[p].normal.y);
+		nz[p] = _mm256_set1_ps(planes[p].normal.z);
+		d[p] = _mm256_set1_ps(planes[p].d);
+	}
+	const __m256 zero = _mm256_setzero_ps();
+
+	for (unsigned i = 0; i < padded; i += 8) {
+		__m256 x0 = _mm256_loadu_ps(&minX[i]), x1 = _mm256_loadu_ps(&maxX[i]);
+		__m256 y0 = _mm256_loadu_ps(&minY[i]), y1 = _mm256_loadu_ps(&maxY[i]);
+		__m256 z0 = _mm256_loadu_ps(&minZ[i]), z1 = _mm256_loadu_ps(&maxZ[i]);
+		__m256 outside = zero;
+		for (int p = 0; p < 6; ++p) {
+			__m256 distance = _mm256_min_ps(_mm256_mul_ps(nx[p], x0), _mm256_mul_ps(nx[p], x1));
+			distance = _mm256_add_ps(distance, _mm256_min_ps(_mm256_mul_ps(ny[p], y0), _mm256_mul_ps(ny[p], y1)));
+			distance = _mm256_add_ps(distance, _mm256_min_ps(_mm256_mul_ps(nz[p], z0), _mm256_mul_ps(nz[p], z1)));
+			outside = _mm256_or_ps(outside, _mm256_cmp_ps(distance, d[p], _CMP_GT_OQ));
+		}
+		int mask = _mm256_movemask_ps(outside);
+		for (int lane = 0; lane < 8; ++lane) {
+			visible[i + lane] = (mask >> lane) & 1 ? 0 : 1;
+		}
+	}
+#else
+	__m128 nx[6], ny[6], nz[6], d[6];
+	for (int p = 0; p < 6; ++p) {
+		nx[p] = _mm_set1_ps(planes[p].normal.x);
+		ny[p] = _mm_set1_ps(planes[p].normal.y);
+		nz[p] = _mm_set1_ps(planes[p].normal.z);
+		d[p] = _mm_set1_ps(planes[p].d);
+	}
+	const __m128 zero = _mm_setzero_ps();
+
+	for (unsigned i = 0; i < padded; i += 4) {
+		__m128 x0 = _mm_loadu_ps(&minX[i]), x1 = _mm_loadu_ps(&maxX[i]);
+		__m128 y0 = _mm_loadu_ps(&minY[i]), y1 = _mm_loadu_ps(&maxY[i]);
+		__m128 z0 = _mm_loadu_ps(&minZ[i]), z1 = _mm_loadu_ps(&maxZ[i]);
+		__m128 outside = zero;
+		for (int p = 0; p < 6; ++p) {
+			__m128 distance = _mm_min_ps(_mm_mul_ps(nx[p], x0), _mm_mul_ps(nx[p], x1));
+			distance = _mm_add_ps(distance, _mm_min_ps(_mm_mul_ps(ny[p], y0), _mm_mul_ps(ny[p], y1)));
+			distance = _mm_add_ps(distance, _mm_min_ps(_mm_mul_ps(nz[p], z0), _mm_mul_ps(nz[p], z1)));
+			outside = _mm_or_ps(outside, _mm_cmpgt_ps(distance, d[p]));
+		}
+		int mask = _mm_movemask_ps(outside);
+		for (int lane = 0; lane < 4; ++lane) {
+			visible[i + lane] = (mask >> lane) & 1 ? 0 : 1;
+		}
+	}
+#endif
+
+	for (unsigned i = 0; i < boxCount; ++i) {
+		visibleCount += visible[i];
+	}
+}
+
+void FrustumCuller::Benchmark(unsigned boxCount, double& scalarMs, double& simdMs) {
+	FrustumCuller culler;
+	culler.Reserve(boxCount);
+	std::mt19937 random(1234);
+	std::uniform_real_distribution<float> position(-500.0f, 500.0f);
+	std::uniform_real_distribution<float> size(0.5f, 5.0f);
+	for (unsigned i = 0; i < boxCount; ++i) {
+		float3 minPoint(position(random), position(random), position(random));
+		culler.AddBox(AABB(minPoint, minPoint + float3(size(random), size(random), size(random))));
+	}
+
+	Frustum frustum;
+	frustum.type = FrustumType::PerspectiveFrustum;
+	frustum.pos = float3::zero;
+	frustum.front = float3::unitZ;
+	frustum.up = float3::unitY;
+	frustum.nearPlaneDistance = 0.1f;
+	frustum.farPlaneDistance = 1000.0f;
+	frustum.verticalFov = math::pi / 2.0f;
+	frustum.horizontalFov = math::pi / 2.0f;
+
+	const Uint64 frequency = SDL_GetPerformanceFrequency();
+	Uint64 start = SDL_GetPerformanceCounter();
+	culler.CullScalar(frustum);
+	Uint64 end = SDL_GetPerformanceCounter();
+	unsigned scalarVisible = culler.GetVisibleCount();
+	scalarMs = (end - start) * 1000.0 / frequency;
+
+	start = SDL_GetPerformanceCounter();
+	culler.Cull(frustum);
+	end = SDL_GetPerformanceCounter();
+	simdMs = (end - start) * 1000.0 / frequency;
+
+	SDL_assert(scalarVisible == culler.GetVisibleCount());
+}
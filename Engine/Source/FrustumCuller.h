@@ -0,0 +1,47 @@
+#pragma once
+#include <vector>
+
+namespace math
+{
+	class AABB;
+	class Frustum;
+}
+using math::AABB;
+using math::Frustum;
+
+// World space boxes stored as separate min/max arrays per axis (SoA), so the
+// frustum test runs on 4 boxes per SSE iteration, or 8 with AVX when the
+// compiler targets it (/arch:AVX defines __AVX__).
+// A box is culled when its corner nearest to the inside of any plane is still outside.
+class FrustumCuller
+{
+public:
+	FrustumCuller();
+	~FrustumCuller();
+
+	void Clear();
+	void Reserve(unsigned count);
+	unsigned AddBox(const AABB& box);
+	void Cull(const Frustum& frustum);
+	void CullScalar(const Frustum& frustum);
+	void SetAllVisible();
+	void Hide(unsigned index);
+	AABB GetBox(unsigned index) const;
+
+	inline bool IsVisible(unsigned index) const { return visible[index] != 0; }
+	inline unsigned GetBoxCount() const { return boxCount; }
+	inline unsigned GetVisibleCount() const { return visibleCount; }
+	inline unsigned GetCulledCount() const { return boxCount - visibleCount; }
+
+	//Culls boxCount random boxes with both paths, results in milliseconds
+	static void Benchmark(unsigned boxCount, double& scalarMs, double& simdMs);
+
+private:
+	static const unsigned LANES = 8; //Arrays are padded to the widest path
+
+	std::vector<float> minX, minY, minZ;
+	std::vector<float> maxX, maxY, maxZ;
+	std::vector<unsigned char> visible;
+	unsigned boxCount = 0;
+	unsigned visibleCount = 0;
+};
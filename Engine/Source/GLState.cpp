@@ -0,0 +1,174 @@
+#include "GLState.h"
+#include <GL/glew.h>
+
+int GLState::program = GLState::UNKNOWN;
+int GLState::vao = GLState::UNKNOWN;
+int GLState::activeUnit = GLState::UNKNOWN;
+int GLState::textures[GL_STATE_TEXTURE_UNITS];
+int GLState::caps[GLState::CAP_COUNT];
+int GLState::depthFunc = GLState::UNKNOWN;
+int GLState::depthMask = GLState::UNKNOWN;
+int GLState::colorMask = GLState::UNKNOWN;
+unsigned GLState::filtered = 0;
+unsigned GLState::issued = 0;
+std::atomic<unsigned> GLState::lastFiltered{ 0 };
+std::atomic<unsigned> GLState::lastIssued{ 0 };
+
+//Capabilities that are shadowed, anything else goes straight to GL
+int GLState::CapIndex(unsigned cap) {
+	switch (cap) {
+	case GL_DEPTH_TEST: return 0;
+	case GL_CULL_FACE: return 1;
+	case GL_BLEND: return 2;
+	case GL_PROGRAM_POINT_SIZE: return 3;
+	case GL_SCISSOR_TEST: return 4;
+	default: return UNKNOWN;
+	}
+}
+
+//Returns true when the call can be skipped
+bool GLState::Filter(bool redundant) {
+	if (redundant) {
+		++filtered;
+	}
+	else {
+		++issued;
+	}
+	return redundant;
+}
+
+void GLState::UseProgram(unsigned program) {
+	if (Filter(GLState::program == (int)program)) {
+		return;
+	}
+	GLState::program = program;
+	glUseProgram(program);
+}
+
+void GLState::BindVertexArray(unsigned vao) {
+	if (Filter(GLState::vao == (int)vao)) {
+		return;
+	}
+	GLState::vao = vao;
+	glBindVertexArray(vao);
+}
+
+void GLState::BindTexture(unsigned unit, unsigned texture) {
+	if (Filter(textures[unit] == (int)texture)) {
+		return;
+	}
+	if (activeUnit != (int)unit) {
+		activeUnit = unit;
+		glActiveTexture(GL_TEXTURE0 + unit);
+	}
+	textures[unit] = texture;
+	glBindTexture(GL_TEXTURE_2D, texture);
+}
+
+void GLState::Enable(unsigned cap) {
+	SetEnabled(cap, true);
+}
+
+void GLState::Disable(unsigned cap) {
+	SetEnabled(cap, false);
+}
+
+void GLState::SetEnabled(unsigned cap, bool enabled) {
+	int index = CapIndex(cap);
+	if (index != UNKNOWN) {
+		if (Filter(caps[index] == (int)enabled)) {
+			return;
+		}
+		caps[index] = enabled;
+	}
+	if (enabled) {
+		glEnable(cap);
+	}
+	else {
+		glDisable(cap);
+	}
+}
+
+//Only asks the driver the first time after an Invalidate
+bool GLState::IsEnabled(unsigned cap) {
+	int index = CapIndex(cap);
+	if (index == UNKNOWN) {
+		return glIsEnabled(cap) == GL_TRUE;
+	}
+	if (Filter(caps[index] != UNKNOWN)) {
+		return caps[index] != 0;
+	}
+	caps[index] = glIsEnabled(cap) == GL_TRUE;
+	return caps[index] != 0;
+}
+
+void GLState::DepthFunc(unsigned func) {
+	if (Filter(depthFunc == (int)func)) {
+		return;
+	}
+	depthFunc = func;
+	glDepthFunc(func);
+}
+
+void GLState::DepthMask(bool write) {
+	if (Filter(depthMask == (int)write)) {
+		return;
+	}
+	depthMask = write;
+	glDepthMask(write ? GL_TRUE : GL_FALSE);
+}
+
+void GLState::ColorMask(bool write) {
+	if (Filter(colorMask == (int)write)) {
+		return;
+	}
+	colorMask = write;
+	GLboolean mask = write ? GL_TRUE : GL_FALSE;
+	glColorMask(mask, mask, mask, mask);
+}
+
+void GLState::DeleteTextures(int count, const unsigned* textures) {
+	for (int i = 0; i < count; ++i) {
+		for (int& bound : GLState::textures) {
+			if (bound == (int)textures[i]) {
+				bound = 0;
+			}
+		}
+	}
+	glDeleteTextures(count, textures);
+}
+
+//A program deleted while in use stays current until the next glUseProgram, so it is forgotten rather than reset to 0
+void GLState::DeleteProgram(unsigned program) {
+	if (GLState::program == (int)program) {
+		GLState::program = UNKNOWN;
+	}
+	glDeleteProgram(program);
+}
+
+void GLState::DeleteVertexArrays(int count, const unsigned* vaos) {
+	for (int i = 0; i < count; ++i) {
+		if (vao == (int)vaos[i]) {
+			vao = 0;
+		}
+	}
+	glDeleteVertexArrays(count, vaos);
+}
+
+void GLState::Invalidate() {
+	program = vao = activeUnit = UNKNOWN;
+	depthFunc = depthMask = colorMask = UNKNOWN;
+	for (int& texture : textures) {
+		texture = UNKNOWN;
+	}
+	for (int& cap : caps) {
+		cap = UNKNOWN;
+	}
+}
+
+void GLState::NewFrame() {
+	lastFiltered.store(filtered, std::memory_order_relaxed);
+	lastIssued.store(issued, std::memory_order_relaxed);
+	filtered = issued = 0;
+	Invalidate();
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <atomic>
+
+#define GL_STATE_TEXTURE_UNITS 16
+
+// Shadow copy of the binds and capabilities the engine touches, so calls that would not change
+// anything never reach the driver and nothing has to be read back with glIsEnabled/glGet.
+// Only valid while every change of this state goes through it, code outside the engine that
+// leaves state behind has to be followed by Invalidate. Textures, programs and VAOs are deleted
+// through it too: GL unbinds a deleted object, and a recycled name must not look bound.
+// Textures are always GL_TEXTURE_2D.
+class GLState
+{
+public:
+	static void UseProgram(unsigned program);
+	static void BindVertexArray(unsigned vao);
+	static void BindTexture(unsigned unit, unsigned texture);
+	static void Enable(unsigned cap);
+	static void Disable(unsigned cap);
+	static void SetEnabled(unsigned cap, bool enabled);
+	static bool IsEnabled(unsigned cap);
+	static void DepthFunc(unsigned func);
+	static void DepthMask(bool write);
+	static void ColorMask(bool write);
+	static void DeleteTextures(int count, const unsigned* textures);
+	static void DeleteProgram(unsigned program);
+	static void DeleteVertexArrays(int count, const unsigned* vaos);
+
+	//Forgets everything, the next call of each kind is issued
+	static void Invalidate();
+	//Keeps the counters of the frame that ended and starts from a clean shadow
+	static void NewFrame();
+
+	//Calls skipped/issued during the last complete frame, safe to read from any thread
+	static inline unsigned GetFilteredCount() { return lastFiltered.load(std::memory_order_relaxed); }
+	static inline unsigned GetIssuedCount() { return lastIssued.load(std::memory_order_relaxed); }
+
+private:
+	static int CapIndex(unsigned cap);
+	static bool Filter(bool redundant);
+
+	static const int UNKNOWN = -1;
+	static const int CAP_COUNT = 5;
+
+	static int program;
+	static int vao;
+	static int activeUnit;
+	static int textures[GL_STATE_TEXTURE_UNITS];
+	static int caps[CAP_COUNT];
+	static int depthFunc;
+	static int depthMask;
+	static int colorMask;
+	static unsigned filtered, issued;
+	static std::atomic<unsigned> lastFiltered, lastIssued;
+};
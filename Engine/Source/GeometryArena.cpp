@@ -0,0 +1,159 @@
+#include "GeometryArena.h"
+#include "GLState.h"
+#include "Globals.h"
+#include <GL/glew.h>
+#include <cstddef>
+
+GeometryArena::GeometryArena() {
+
+}
+
+GeometryArena::~GeometryArena() {
+
+}
+
+void GeometryArena::Init(unsigned vertexCapacity, unsigned indexCapacity) {
+	this->vertexCapacity = vertexCapacity;
+	this->indexCapacity = indexCapacity;
+
+	glGenBuffers(1, &VBO);
+	glBindBuffer(GL_ARRAY_BUFFER, VBO);
+	glBufferData(GL_ARRAY_BUFFER, sizeof(ArenaVertex) * vertexCapacity, nullptr, GL_STATIC_DRAW);
+	glGenBuffers(1, &positionVBO);
+	glBindBuffer(GL_ARRAY_BUFFER, positionVBO);
+	glBufferData(GL_ARRAY_BUFFER, sizeof(float3) * vertexCapacity, nullptr, GL_STATIC_DRAW);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	glGenBuffers(1, &EBO);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(unsigned) * indexCapacity, nullptr, GL_STATIC_DRAW);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+
+	glGenVertexArrays(1, &VAO);
+	glGenVertexArrays(1, &positionVAO);
+	SetupVAO();
+}
+
+void GeometryArena::Destroy() {
+	GLState::DeleteVertexArrays(1, &VAO);
+	GLState::DeleteVertexArrays(1, &positionVAO);
+	glDeleteBuffers(1, &VBO);
+	glDeleteBuffers(1, &positionVBO);
+	glDeleteBuffers(1, &EBO);
+	VAO = VBO = EBO = 0;
+	positionVAO = positionVBO = 0;
+}
+
+void GeometryArena::SetupVAO() {
+	GLState::BindVertexArray(VAO);
+	glBindBuffer(GL_ARRAY_BUFFER, VBO);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+
+	glEnableVertexAttribArray(0);
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(ArenaVertex), (void*)offsetof(ArenaVertex, position));
+	glEnableVertexAttribArray(1);
+	glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(ArenaVertex), (void*)offsetof(ArenaVertex, uv));
+	glEnableVertexAttribArray(2);
+	glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, sizeof(ArenaVertex), (void*)offsetof(ArenaVertex, normal));
+
+	GLState::BindVertexArray(positionVAO);
+	glBindBuffer(GL_ARRAY_BUFFER, positionVBO);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+	glEnableVertexAttribArray(0);
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(float3), (void*)0);
+
+	GLState::BindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+//Doubles the full buffers and copies the used part on the GPU, then points the VAO at them
+void GeometryArena::Grow(unsigned minVertexCapacity, unsigned minIndexCapacity) {
+	unsigned newVertexCapacity = vertexCapacity;
+	unsigned newIndexCapacity = indexCapacity;
+	while (newVertexCapacity < minVertexCapacity) {
+		newVertexCapacity *= 2;
+	}
+	while (newIndexCapacity < minIndexCapacity) {
+		newIndexCapacity *= 2;
+	}
+
+	if (newVertexCapacity != vertexCapacity) {
+		unsigned newVBO = 0;
+		glGenBuffers(1, &newVBO);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, newVBO);
+		glBufferData(GL_COPY_WRITE_BUFFER, sizeof(ArenaVertex) * newVertexCapacity, nullptr, GL_STATIC_DRAW);
+		glBindBuffer(GL_COPY_READ_BUFFER, VBO);
+		glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, sizeof(ArenaVertex) * vertexCursor);
+		glDeleteBuffers(1, &VBO);
+		VBO = newVBO;
+
+		unsigned newPositionVBO = 0;
+		glGenBuffers(1, &newPositionVBO);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, newPositionVBO);
+		glBufferData(GL_COPY_WRITE_BUFFER, sizeof(float3) * newVertexCapacity, nullptr, GL_STATIC_DRAW);
+		glBindBuffer(GL_COPY_READ_BUFFER, positionVBO);
+		glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, sizeof(float3) * vertexCursor);
+		glDeleteBuffers(1, &positionVBO);
+		positionVBO = newPositionVBO;
+		vertexCapacity = newVertexCapacity;
+	}
+	if (newIndexCapacity != indexCapacity) {
+		unsigned newEBO = 0;
+		glGenBuffers(1, &newEBO);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, newEBO);
+		glBufferData(GL_COPY_WRITE_BUFFER, sizeof(unsigned) * newIndexCapacity, nullptr, GL_STATIC_DRAW);
+		glBindBuffer(GL_COPY_READ_BUFFER, EBO);
+		glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, sizeof(unsigned) * indexCursor);
+		glDeleteBuffers(1, &EBO);
+		EBO = newEBO;
+		indexCapacity = newIndexCapacity;
+	}
+	glBindBuffer(GL_COPY_READ_BUFFER, 0);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+	SetupVAO();
+	LOG("Geometry arena grown to %u vertices, %u indices", vertexCapacity, indexCapacity);
+}
+
+GeometryRange GeometryArena::Allocate(const std::vector<ArenaVertex>& vertices, const std::vector<unsigned>& indices) {
+	if (vertexCursor + vertices.size() > vertexCapacity || indexCursor + indices.size() > indexCapacity) {
+		Grow(vertexCursor + vertices.size(), indexCursor + indices.size());
+	}
+
+	GeometryRange range;
+	range.baseVertex = vertexCursor;
+	range.vertexCount = vertices.size();
+	range.firstIndex = indexCursor;
+	range.indexCount = indices.size();
+
+	glBindBuffer(GL_ARRAY_BUFFER, VBO);
+	glBufferSubData(GL_ARRAY_BUFFER, sizeof(ArenaVertex) * range.baseVertex, sizeof(ArenaVertex) * vertices.size(), vertices.data());
+	std::vector<float3> positions(vertices.size());
+	for (size_t i = 0; i < vertices.size(); ++i) {
+		positions[i] = vertices[i].position;
+	}
+	glBindBuffer(GL_ARRAY_BUFFER, positionVBO);
+	glBufferSubData(GL_ARRAY_BUFFER, sizeof(float3) * range.baseVertex, sizeof(float3) * positions.size(), positions.data());
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	//The EBO is bound through the VAO so the element binding of whatever VAO is current stays untouched
+	GLState::BindVertexArray(VAO);
+	glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, sizeof(unsigned) * range.firstIndex, sizeof(unsigned) * indices.size(), indices.data());
+	GLState::BindVertexArray(0);
+
+	vertexCursor += range.vertexCount;
+	indexCursor += range.indexCount;
+	++liveRanges;
+	return range;
+}
+
+void GeometryArena::Free(const GeometryRange& range) {
+	if (--liveRanges <= 0) {
+		liveRanges = 0;
+		vertexCursor = 0;
+		indexCursor = 0;
+	}
+	else if (range.baseVertex + range.vertexCount == vertexCursor && range.firstIndex + range.indexCount == indexCursor) {
+		vertexCursor = range.baseVertex;
+		indexCursor = range.firstIndex;
+	}
+}
@@ -0,0 +1,60 @@
+#pragma once
+#include <vector>
+#include "Math/float2.h"
+#include "Math/float3.h"
+
+//Interleaved layout shared by every static mesh, attributes 0 = position, 1 = uv, 2 = normal
+struct ArenaVertex
+{
+	float3 position;
+	float2 uv;
+	float3 normal;
+};
+
+//Where a mesh lives inside the arena. Indices are relative to baseVertex, and the ones in the
+//range only reference the vertexCount vertices from firstVertex on.
+struct GeometryRange
+{
+	unsigned baseVertex = 0;
+	unsigned firstVertex = 0;
+	unsigned vertexCount = 0;
+	unsigned firstIndex = 0;
+	unsigned indexCount = 0;
+};
+
+// Static geometry for one vertex format is sub-allocated out of a single VBO/EBO pair
+// with a single VAO, so switching meshes never touches vertex state.
+// Positions are also written to a second, position only stream with its own VAO over the
+// same EBO, for depth only passes that would otherwise fetch uv and normal for nothing.
+// Allocation is a bump pointer: ranges are only reclaimed once all of them are freed,
+// which matches how models are loaded and cleared as a whole.
+class GeometryArena
+{
+public:
+	GeometryArena();
+	~GeometryArena();
+
+	void Init(unsigned vertexCapacity, unsigned indexCapacity);
+	void Destroy();
+	GeometryRange Allocate(const std::vector<ArenaVertex>& vertices, const std::vector<unsigned>& indices);
+	void Free(const GeometryRange& range);
+
+	inline unsigned GetVAO() const { return VAO; }
+	inline unsigned GetPositionVAO() const { return positionVAO; }
+	inline unsigned GetVBO() const { return VBO; }
+	inline unsigned GetEBO() const { return EBO; }
+	inline unsigned GetVertexCount() const { return vertexCursor; }
+	inline unsigned GetIndexCount() const { return indexCursor; }
+	inline unsigned GetVertexCapacity() const { return vertexCapacity; }
+	inline unsigned GetIndexCapacity() const { return indexCapacity; }
+
+private:
+	void Grow(unsigned minVertexCapacity, unsigned minIndexCapacity);
+	void SetupVAO();
+
+	unsigned VBO = 0, EBO = 0, VAO = 0;
+	unsigned positionVBO = 0, positionVAO = 0;
+	unsigned vertexCapacity = 0, indexCapacity = 0;
+	unsigned vertexCursor = 0, indexCursor = 0;
+	int liveRanges = 0;
+};
@@ -1,8 +1,18 @@
 #pragma once
+#ifdef _WIN32
 #include <windows.h>
+#endif
 #include <stdio.h>
 
-#define LOG(format, ...) log(__FILE__, __LINE__, format, __VA_ARGS__);
+#ifndef _WIN32
+//Secure CRT calls used by the engine, for the portable headless build
+#define sprintf_s snprintf
+#define vsprintf_s vsnprintf
+#define fopen_s(file, name, mode) ((*(file) = fopen((name), (mode))) == nullptr)
+#define _wcsicmp wcscasecmp
+#endif
+
+#define LOG(format, ...) log(__FILE__, __LINE__, format, ##__VA_ARGS__);
 
 void log(const char file[], int line, const char* format, ...);
 
@@ -0,0 +1,243 @@
+#include "LightClusters.h"
+#include "Geometry/Frustum.h"
+#include "Math/float4x4.h"
+#include "Math/MathFunc.h"
+#include "SDL.h"
+#include <GL/glew.h>
+#include <immintrin.h>
+#include <future>
+#include <random>
+#include <algorithm>
+#include <climits>
+#include <cfloat>
+#include <cmath>
+
+#define CLUSTER_TILES (CLUSTER_X * CLUSTER_Y)
+#define CLUSTER_COUNT (CLUSTER_TILES * CLUSTER_Z)
+//Slices are split in this many chunks, the first one runs on the calling thread
+#define CLUSTER_CHUNKS 4
+//Below this, starting threads costs more than binning
+#define CLUSTER_THREADED_LIGHTS 64
+
+LightClusters::LightClusters() {
+
+}
+
+LightClusters::~LightClusters() {
+
+}
+
+float4 LightClusters::GetDepthParams(float nearPlane, float farPlane) {
+	float logRatio = logf(farPlane / nearPlane);
+	return float4(nearPlane, farPlane, CLUSTER_Z / logRatio, -CLUSTER_Z * logf(nearPlane) / logRatio);
+}
+
+static int SliceOf(float depth, const float4& params) {
+	if (depth <= params.x) {
+		return 0;
+	}
+	int slice = (int)floorf(logf(depth) * params.z + params.w);
+	return std::min(std::max(slice, 0), CLUSTER_Z - 1);
+}
+
+static int TileOf(float ndc, int tiles) {
+	int tile = (int)floorf((ndc * 0.5f + 0.5f) * tiles);
+	return std::min(std::max(tile, 0), tiles - 1);
+}
+
+void LightClusters::Bin(const std::vector<Light>& lights, const Frustum& frustum) {
+	Uint64 start = SDL_GetPerformanceCounter();
+
+	this->lights = lights;
+	lightCount = lights.size();
+	const unsigned padded = (lightCount + 3) & ~3u;
+	depth.resize(padded);
+	minSlice.assign(padded, INT_MAX); //Never inside any slice, also what padding and skipped lights keep
+	maxSlice.assign(padded, INT_MIN);
+	minTileX.resize(padded); maxTileX.resize(padded);
+	minTileY.resize(padded); maxTileY.resize(padded);
+
+	const float4 params = GetDepthParams(frustum.nearPlaneDistance, frustum.farPlaneDistance);
+	const float4x4 viewProj = frustum.ViewProjMatrix();
+
+	for (unsigned i = 0; i < lightCount; ++i) {
+		const float3 position = lights[i].positionRadius.xyz();
+		const float radius = lights[i].positionRadius.w;
+		depth[i] = (position - frustum.pos).Dot(frustum.front);
+		if (depth[i] + radius < frustum.nearPlaneDistance || depth[i] - radius > frustum.farPlaneDistance) {
+			continue;
+		}
+
+		//Screen rect of the projected box around the sphere, the whole screen when it reaches behind the camera
+		float minX = -1.0f, maxX = 1.0f, minY = -1.0f, maxY = 1.0f;
+		bool clipped = false;
+		float ndcMinX = FLT_MAX, ndcMaxX = -FLT_MAX, ndcMinY = FLT_MAX, ndcMaxY = -FLT_MAX;
+		for (int corner = 0; corner < 8 && !clipped; ++corner) {
+			float3 offset((corner & 1) ? radius : -radius, (corner & 2) ? radius : -radius, (corner & 4) ? radius : -radius);
+			float4 clip = viewProj * float4(position + offset, 1.0f);
+			if (clip.w <= frustum.nearPlaneDistance) {
+				clipped = true;
+				break;
+			}
+			ndcMinX = std::min(ndcMinX, clip.x / clip.w); ndcMaxX = std::max(ndcMaxX, clip.x / clip.w);
+			ndcMinY = std::min(ndcMinY, clip.y / clip.w); ndcMaxY = std::max(ndcMaxY, clip.y / clip.w);
+		}
+		if (!clipped) {
+			if (ndcMaxX < -1.0f || ndcMinX > 1.0f || ndcMaxY < -1.0f || ndcMinY > 1.0f) {
+				continue;
+			}
+			minX = ndcMinX; maxX = ndcMaxX; minY = ndcMinY; maxY = ndcMaxY;
+		}
+
+		minSlice[i] = SliceOf(depth[i] - radius, params);
+		maxSlice[i] = SliceOf(depth[i] + radius, params);
+		minTileX[i] = TileOf(minX, CLUSTER_X); maxTileX[i] = TileOf(maxX, CLUSTER_X);
+		minTileY[i] = TileOf(minY, CLUSTER_Y); maxTileY[i] = TileOf(maxY, CLUSTER_Y);
+	}
+
+	const unsigned chunkCount = lightCount < CLUSTER_THREADED_LIGHTS ? 1 : CLUSTER_CHUNKS;
+	chunks.resize(chunkCount);
+	for (unsigned i = 0; i < chunkCount; ++i) {
+		chunks[i].firstSlice = CLUSTER_Z * i / chunkCount;
+		chunks[i].lastSlice = CLUSTER_Z * (i + 1) / chunkCount;
+	}
+	std::vector<std::future<void>> jobs;
+	for (unsigned i = 1; i < chunkCount; ++i) {
+		jobs.push_back(std::async(std::launch::async, [this, i]() { BinSlices(chunks[i]); }));
+	}
+	BinSlices(chunks[0]);
+	for (std::future<void>& job : jobs) {
+		job.wait();
+	}
+
+	//Chunks cover consecutive slices, so their lists only need rebasing while concatenating
+	clusters.resize(CLUSTER_COUNT * 2);
+	indices.clear();
+	maxPerCluster = 0;
+	for (const Chunk& chunk : chunks) {
+		unsigned offset = indices.size();
+		const unsigned firstCluster = chunk.firstSlice * CLUSTER_TILES;
+		for (unsigned i = 0; i < chunk.counts.size(); ++i) {
+			clusters[(firstCluster + i) * 2] = offset;
+			clusters[(firstCluster + i) * 2 + 1] = chunk.counts[i];
+			offset += chunk.counts[i];
+			maxPerCluster = std::max(maxPerCluster, chunk.counts[i]);
+		}
+		indices.insert(indices.end(), chunk.indices.begin(), chunk.indices.end());
+	}
+	indexCount = indices.size();
+
+	binMs = (SDL_GetPerformanceCounter() - start) * 1000.0f / SDL_GetPerformanceFrequency();
+}
+
+//Counts the lights of every tile in the slice, then fills the lists at the prefix sums
+void LightClusters::BinSlices(Chunk& chunk) const {
+	chunk.counts.assign((chunk.lastSlice - chunk.firstSlice) * CLUSTER_TILES, 0);
+	chunk.indices.clear();
+
+	const unsigned padded = minSlice.size();
+	std::vector<unsigned> candidates;
+	candidates.reserve(lightCount);
+	unsigned offsets[CLUSTER_TILES];
+
+	for (unsigned slice = chunk.firstSlice; slice < chunk.lastSlice; ++slice) {
+		candidates.clear();
+		const __m128i current = _mm_set1_epi32(slice);
+		for (unsigned i = 0; i < padded; i += 4) {
+			__m128i outside = _mm_or_si128(
+				_mm_cmpgt_epi32(_mm_loadu_si128((const __m128i*)&minSlice[i]), current),
+				_mm_cmpgt_epi32(current, _mm_loadu_si128((const __m128i*)&maxSlice[i])));
+			int inside = ~_mm_movemask_ps(_mm_castsi128_ps(outside)) & 0xF;
+			for (int lane = 0; inside != 0; ++lane, inside >>= 1) {
+				if (inside & 1) {
+					candidates.push_back(i + lane);
+				}
+			}
+		}
+
+		unsigned* counts = &chunk.counts[(slice - chunk.firstSlice) * CLUSTER_TILES];
+		for (unsigned light : candidates) {
+			for (int y = minTileY[light]; y <= maxTileY[light]; ++y) {
+				for (int x = minTileX[light]; x <= maxTileX[light]; ++x) {
+					++counts[x + y * CLUSTER_X];
+				}
+			}
+		}
+
+		unsigned offset = chunk.indices.size();
+		for (unsigned tile = 0; tile < CLUSTER_TILES; ++tile) {
+			offsets[tile] = offset;
+			offset += counts[tile];
+		}
+		chunk.indices.resize(offset);
+		for (unsigned light : candidates) {
+			for (int y = minTileY[light]; y <= maxTileY[light]; ++y) {
+				for (int x = minTileX[light]; x <= maxTileX[light]; ++x) {
+					chunk.indices[offsets[x + y * CLUSTER_X]++] = light;
+				}
+			}
+		}
+	}
+}
+
+//Binding a zero sized range is an error, empty lists upload a single unused element
+void LightClusters::Upload(StreamingBuffer* stream) {
+	if (lightBuffer == 0) {
+		glGenBuffers(1, &lightBuffer);
+		glGenBuffers(1, &clusterBuffer);
+		glGenBuffers(1, &indexBuffer);
+	}
+	static const Light noLight = {};
+	static const unsigned noIndex = 0;
+
+	GLint alignment = 4;
+	glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &alignment);
+	BufferSlice slice = lights.empty() ? stream->Stream(lightBuffer, &noLight, sizeof(Light), alignment)
+		: stream->Stream(lightBuffer, lights.data(), sizeof(Light) * lights.size(), alignment);
+	glBindBufferRange(GL_SHADER_STORAGE_BUFFER, LIGHT_SSBO_BINDING, slice.buffer, slice.offset, slice.size);
+
+	if (clusters.empty()) {
+		clusters.assign(CLUSTER_COUNT * 2, 0);
+	}
+	slice = stream->Stream(clusterBuffer, clusters.data(), sizeof(unsigned) * clusters.size(), alignment);
+	glBindBufferRange(GL_SHADER_STORAGE_BUFFER, CLUSTER_SSBO_BINDING, slice.buffer, slice.offset, slice.size);
+
+	slice = indices.empty() ? stream->Stream(indexBuffer, &noIndex, sizeof(unsigned), alignment)
+		: stream->Stream(indexBuffer, indices.data(), sizeof(unsigned) * indices.size(), alignment);
+	glBindBufferRange(GL_SHADER_STORAGE_BUFFER, LIGHT_INDEX_SSBO_BINDING, slice.buffer, slice.offset, slice.size);
+}
+
+void LightClusters::Destroy() {
+	glDeleteBuffers(1, &lightBuffer);
+	glDeleteBuffers(1, &clusterBuffer);
+	glDeleteBuffers(1, &indexBuffer);
+	lightBuffer = clusterBuffer = indexBuffer = 0;
+}
+
+double LightClusters::Benchmark(unsigned lightCount) {
+	std::mt19937 random(1234);
+	std::uniform_real_distribution<float> position(-50.0f, 50.0f);
+	std::uniform_real_distribution<float> radius(1.0f, 5.0f);
+	std::vector<Light> lights(lightCount);
+	for (Light& light : lights) {
+		light.positionRadius = float4(position(random), position(random), position(random) + 50.0f, radius(random));
+		light.colorIntensity = float4(1.0f, 1.0f, 1.0f, 1.0f);
+		light.directionCosOuter = float4(0.0f, -1.0f, 0.0f, -1.0f);
+		light.cosInner = float4::zero;
+	}
+
+	Frustum frustum;
+	frustum.type = FrustumType::PerspectiveFrustum;
+	frustum.pos = float3::zero;
+	frustum.front = float3::unitZ;
+	frustum.up = float3::unitY;
+	frustum.nearPlaneDistance = 0.1f;
+	frustum.farPlaneDistance = 200.0f;
+	frustum.verticalFov = math::pi / 2.0f;
+	frustum.horizontalFov = math::pi / 2.0f;
+
+	LightClusters clusters;
+	Uint64 start = SDL_GetPerformanceCounter();
+	clusters.Bin(lights, frustum);
+	return (SDL_GetPerformanceCounter() - start) * 1000.0 / SDL_GetPerformanceFrequency();
+}
@@ -0,0 +1,85 @@
+#pragma once
+#include <vector>
+#include "Math/float3.h"
+#include "Math/float4.h"
+#include "StreamingBuffer.h"
+
+namespace math
+{
+	class Frustum;
+}
+using math::Frustum;
+
+#define CLUSTER_X 16
+#define CLUSTER_Y 9
+#define CLUSTER_Z 24
+
+#define LIGHT_SSBO_BINDING 5
+#define CLUSTER_SSBO_BINDING 6
+#define LIGHT_INDEX_SSBO_BINDING 7
+
+//std430 layout of the Lights buffer in FragmentShader.glsl
+struct Light
+{
+	float4 positionRadius;
+	float4 colorIntensity;
+	float4 directionCosOuter; //w = cosine of the outer cone, -1 for point lights
+	float4 cosInner; //x = cosine of the inner cone
+};
+
+// Clustered forward lighting. The view frustum is split into a CLUSTER_X x CLUSTER_Y x CLUSTER_Z
+// grid of froxels, screen tiles with exponentially spaced depth slices, and every light is binned
+// on the CPU into the froxels its sphere may touch. The fragment shader finds its froxel and only
+// loops over that list.
+// Binning splits the depth slices between threads, each one writing its own contiguous part of the
+// lists. Within a slice, the lights reaching it are picked 4 at a time with SSE.
+class LightClusters
+{
+public:
+	LightClusters();
+	~LightClusters();
+
+	void Bin(const std::vector<Light>& lights, const Frustum& frustum);
+	void Upload(StreamingBuffer* stream);
+	void Destroy();
+
+	inline unsigned GetLightCount() const { return lightCount; }
+	inline unsigned GetIndexCount() const { return indexCount; }
+	inline unsigned GetMaxLightsPerCluster() const { return maxPerCluster; }
+	inline float GetBinMs() const { return binMs; }
+	//CPU side of what Upload sends, for renderers that shade without the GPU
+	inline const std::vector<Light>& GetLights() const { return lights; }
+	inline const std::vector<unsigned>& GetClusters() const { return clusters; }
+	inline const std::vector<unsigned>& GetIndices() const { return indices; }
+
+	//near, far and the scale/bias turning log(depth) into a slice, as the shader expects them
+	static float4 GetDepthParams(float nearPlane, float farPlane);
+	//Random lights around the origin, returns the milliseconds spent binning them
+	static double Benchmark(unsigned lightCount);
+
+private:
+	struct Chunk
+	{
+		unsigned firstSlice = 0, lastSlice = 0;
+		std::vector<unsigned> counts; //Per cluster of the chunk
+		std::vector<unsigned> indices;
+	};
+
+	void BinSlices(Chunk& chunk) const;
+
+	std::vector<Light> lights;
+	//SoA per light, padded to 4 so the slice test never needs a tail loop
+	std::vector<float> depth;
+	std::vector<int> minSlice, maxSlice;
+	std::vector<int> minTileX, maxTileX, minTileY, maxTileY;
+	std::vector<Chunk> chunks;
+
+	std::vector<unsigned> clusters; //Offset and count into indices, per cluster
+	std::vector<unsigned> indices;
+	unsigned lightCount = 0;
+	unsigned indexCount = 0;
+	unsigned maxPerCluster = 0;
+	float binMs = 0.0f;
+
+	unsigned lightBuffer = 0, clusterBuffer = 0, indexBuffer = 0;
+};
@@ -2,14 +2,17 @@
 #include "Application.h"
 #include "ModuleOpenGL.h"
 #include "Globals.h"
+#include "ModuleHeadless.h"
 
 #include "SDL.h"
+#ifdef _WIN32
 #pragma comment( lib, "Dependencies/SDL/lib/x64/SDL2.lib" )
 #pragma comment( lib, "Dependencies/SDL/lib/x64/SDL2main.lib" )
 
 extern "C" {
 	_declspec(dllexport) DWORD NvOptimusEnablement = 0x00000001;
 }
+#endif
 enum main_states
 {
 	MAIN_CREATION,  
@@ -26,6 +29,11 @@ int main(int argc, char ** argv)
 	int main_return = EXIT_FAILURE;
 	main_states state = MAIN_CREATION;
 
+	HeadlessSettings headless;
+	if (!ModuleHeadless::ParseCommandLine(argc, argv, headless)) {
+		return main_return;
+	}
+
 	while (state != MAIN_EXIT)
 	{
 		switch (state)
@@ -33,7 +41,7 @@ int main(int argc, char ** argv)
 		case MAIN_CREATION:
 
 			LOG("Application Creation --------------");
-			App = new Application();
+			App = new Application(headless.enabled ? &headless : nullptr);
 			state = MAIN_START;
 			break;
 
@@ -0,0 +1,40 @@
+#include "Material.h"
+#include "GLState.h"
+#include <GL/glew.h>
+
+//std140 layout of the Material block in FragmentShader.glsl
+struct MaterialBlock
+{
+	float diffuseConstant;
+	float specularConstant;
+	float shininess;
+	float padding;
+};
+
+void Material::CreateUniformBuffer() {
+	glGenBuffers(1, &uniformBuffer);
+	glBindBuffer(GL_UNIFORM_BUFFER, uniformBuffer);
+	glBufferData(GL_UNIFORM_BUFFER, sizeof(MaterialBlock), nullptr, GL_STATIC_DRAW);
+	UpdateUniformBuffer();
+}
+
+void Material::UpdateUniformBuffer() const {
+	MaterialBlock block = { diffuseConstant, specularConstant, shininess, 0.0f };
+	glBindBuffer(GL_UNIFORM_BUFFER, uniformBuffer);
+	glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(MaterialBlock), &block);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
+
+void Material::DestroyUniformBuffer() {
+	glDeleteBuffers(1, &uniformBuffer);
+	uniformBuffer = 0;
+}
+
+void Material::Bind() const {
+	//Units match the layout(binding) of the samplers in FragmentShader.glsl
+	GLState::BindTexture(0, baseColor);
+	GLState::BindTexture(1, occlusionRoughnessMetallic);
+	GLState::BindTexture(2, normal);
+
+	glBindBufferBase(GL_UNIFORM_BUFFER, MATERIAL_UBO_BINDING, uniformBuffer);
+}
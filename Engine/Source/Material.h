@@ -0,0 +1,26 @@
+#pragma once
+
+#define MATERIAL_UBO_BINDING 1
+
+// GPU side description of a glTF material once its maps have been packed:
+//  - baseColor: RGBA albedo
+//  - occlusionRoughnessMetallic: R = occlusion, G = roughness, B = metallic
+//  - normal: tangent space XY in BC5, Z is rebuilt in the shader
+// The Phong constants live in a small uniform buffer bound at MATERIAL_UBO_BINDING.
+struct Material
+{
+	unsigned baseColor = 0;
+	unsigned occlusionRoughnessMetallic = 0;
+	unsigned normal = 0;
+
+	float diffuseConstant = 0.640f;
+	float specularConstant = 0.550f;
+	float shininess = 29.25f;
+	unsigned uniformBuffer = 0;
+	unsigned shaderFeatures = 0; //SHADER_FEATURE_* bits of the maps loaded from the file, defaults do not count
+
+	void CreateUniformBuffer();
+	void UpdateUniformBuffer() const;
+	void DestroyUniformBuffer();
+	void Bind() const;
+};
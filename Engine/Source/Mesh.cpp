@@ -1,5 +1,5 @@
 #include "Application.h"
-#include <.\GL\glew.h>
+#include <GL/glew.h>
 #include "Mesh.h"
 #include "MathGeoLib.h"
 #include "SDL.h"
@@ -13,52 +13,70 @@ Mesh::~Mesh() {
 	delete meshAABB;
 }
 
-void Mesh::Load(const tinygltf::Model& srcModel, const tinygltf::Mesh& srcMesh, const tinygltf::Primitive& primitive) {
+void Mesh::Load(const tinygltf::Model& srcModel, const tinygltf::Mesh& srcMesh, const tinygltf::Primitive& primitive, GeometryArena* arena, bool occluder) {
 	name = srcMesh.name;
-	textureID = primitive.material;
-	LoadVBO(srcModel, srcMesh, primitive);
-	LoadEBO(srcModel, srcMesh, primitive);
-	if (indexCount != 0) {
-		CreateVAO();
+	materialIndex = primitive.material;
+	this->arena = arena;
+	this->occluder = occluder;
+
+	std::vector<ArenaVertex> vertices;
+	std::vector<unsigned> indices;
+	LoadVBO(srcModel, srcMesh, primitive, vertices);
+	LoadEBO(srcModel, srcMesh, primitive, indices);
+	range = arena->Allocate(vertices, indices);
+
+	if (occluder) {
+		occluderPositions.resize(vertices.size());
+		for (size_t i = 0; i < vertices.size(); i++) {
+			occluderPositions[i] = vertices[i].position;
+		}
+		occluderIndices = indices;
+	}
+}
+
+void Mesh::LoadBatch(const std::string& name, int materialIndex, bool hasUV, const std::vector<ArenaVertex>& vertices, const std::vector<unsigned>& indices,
+	const std::vector<MeshPart>& parts, GeometryArena* arena, const std::vector<float3>& occluderPositions, const std::vector<unsigned>& occluderIndices) {
+	this->name = name;
+	this->materialIndex = materialIndex;
+	this->arena = arena;
+	this->parts = parts;
+	vertexCount = vertices.size();
+	indexCount = indices.size();
+	textureCount = hasUV ? vertexCount : 0;
+	range = arena->Allocate(vertices, indices);
+
+	meshAABB->SetNegativeInfinity();
+	for (const MeshPart& part : parts) {
+		meshAABB->Enclose(part.bounds);
 	}
+
+	occluder = !occluderIndices.empty();
+	this->occluderPositions = occluderPositions;
+	this->occluderIndices = occluderIndices;
 }
 
-void Mesh::LoadVBO(const tinygltf::Model& srcModel, const tinygltf::Mesh& srcMesh, const tinygltf::Primitive& primitive) {
+void Mesh::LoadVBO(const tinygltf::Model& srcModel, const tinygltf::Mesh& srcMesh, const tinygltf::Primitive& primitive, std::vector<ArenaVertex>& vertices) {
 	const auto& itPos = primitive.attributes.find("POSITION");
 	const auto& itTexCoord = primitive.attributes.find("TEXCOORD_0");
 	const auto& itNormal = primitive.attributes.find("NORMAL");
 
-	size_t bufferSize = 0;
-
-	if (itPos != primitive.attributes.end()) {
-		bufferSize += sizeof(float) * 3;
-	}
-	if (itTexCoord != primitive.attributes.end()) {
-		bufferSize += sizeof(float) * 2;
-	}
-	if (itNormal != primitive.attributes.end()) {
-		bufferSize += sizeof(float) * 3;
-	}
-
 	if (itPos != primitive.attributes.end()) {
 		const tinygltf::Accessor& posAcc = srcModel.accessors[itPos->second];
 		vertexCount = posAcc.count;
 
 		SDL_assert(posAcc.type == TINYGLTF_TYPE_VEC3);
 		SDL_assert(posAcc.componentType == GL_FLOAT);
-		posAcc.maxValues;
 		const tinygltf::BufferView& posView = srcModel.bufferViews[posAcc.bufferView];
 		const tinygltf::Buffer& posBuffer = srcModel.buffers[posView.buffer];
 		const unsigned char* bufferPos = &(posBuffer.data[posAcc.byteOffset + posView.byteOffset]);
 
-
-		glGenBuffers(1, &VBO);
-		glBindBuffer(GL_ARRAY_BUFFER, VBO);
-		glBufferData(GL_ARRAY_BUFFER,  bufferSize *= posAcc.count , nullptr, GL_STATIC_DRAW);
-		float3* ptr = reinterpret_cast<float3*>(glMapBuffer(GL_ARRAY_BUFFER, GL_WRITE_ONLY));
+		//Missing attributes stay zeroed, every mesh shares the arena's vertex format
+		vertices.resize(posAcc.count, { float3::zero, float2::zero, float3::zero });
+		meshAABB->SetNegativeInfinity();
 
 		for (size_t i = 0; i < posAcc.count; i++) {
-			ptr[i] = *reinterpret_cast<const float3*>(bufferPos);
+			vertices[i].position = *reinterpret_cast<const float3*>(bufferPos);
+			meshAABB->Enclose(vertices[i].position);
 			if (posView.byteStride != 0) {
 				bufferPos += posView.byteStride;
 			}
@@ -67,8 +85,6 @@ void Mesh::LoadVBO(const tinygltf::Model& srcModel, const tinygltf::Mesh& srcMes
 			}
 			
 		}
-		meshAABB->SetFrom(ptr, vertexCount);
-		glUnmapBuffer(GL_ARRAY_BUFFER);
 
 	}
 
@@ -84,12 +100,8 @@ void Mesh::LoadVBO(const tinygltf::Model& srcModel, const tinygltf::Mesh& srcMes
 
 		textureCount = texCoordAcc.count;
 
-		float2* ptr = reinterpret_cast<float2*>(reinterpret_cast<char*>(glMapBuffer(GL_ARRAY_BUFFER, GL_WRITE_ONLY))+sizeof(float)*3*vertexCount);
-		//float2* ptr = reinterpret_cast<float2*>(glMapBuffer(GL_ARRAY_BUFFER, GL_WRITE_ONLY))+(sizeof(float)*3*vertexCount)/sizeof(float2); //This does not work because the division should encapsulate everything
-		
-
-		for (size_t i = 0; i < texCoordAcc.count; i++) {
-			ptr[i] = *reinterpret_cast<const float2*>(bufferTexCoord);
+		for (size_t i = 0; i < texCoordAcc.count && i < vertices.size(); i++) {
+			vertices[i].uv = *reinterpret_cast<const float2*>(bufferTexCoord);
 			if (texCoordView.byteStride != 0) {
 				bufferTexCoord += texCoordView.byteStride;
 			}
@@ -98,7 +110,6 @@ void Mesh::LoadVBO(const tinygltf::Model& srcModel, const tinygltf::Mesh& srcMes
 			}
 
 		}
-		glUnmapBuffer(GL_ARRAY_BUFFER);
 
 	}
 
@@ -111,19 +122,8 @@ void Mesh::LoadVBO(const tinygltf::Model& srcModel, const tinygltf::Mesh& srcMes
 		const tinygltf::Buffer& normalBuffer = srcModel.buffers[normalView.buffer];
 		const unsigned char* bufferNormal = &(normalBuffer.data[normalAcc.byteOffset + normalView.byteOffset]);
 
-		float3* ptr = nullptr;
-		if (itTexCoord != primitive.attributes.end()) {
-			ptr = reinterpret_cast<float3*>(reinterpret_cast<char*>(glMapBuffer(GL_ARRAY_BUFFER, GL_WRITE_ONLY)) + sizeof(float) * 5 * vertexCount);
-		}
-		else {
-			ptr = reinterpret_cast<float3*>(reinterpret_cast<char*>(glMapBuffer(GL_ARRAY_BUFFER, GL_WRITE_ONLY)) + sizeof(float) * 3 * vertexCount);
-		}
-		
-		//float2* ptr = reinterpret_cast<float2*>(glMapBuffer(GL_ARRAY_BUFFER, GL_WRITE_ONLY))+(sizeof(float)*3*vertexCount)/sizeof(float2); //This does not work because the division should encapsulate everything
-
-
-		for (size_t i = 0; i < normalAcc.count; i++) {
-			ptr[i] = *reinterpret_cast<const float3*>(bufferNormal);
+		for (size_t i = 0; i < normalAcc.count && i < vertices.size(); i++) {
+			vertices[i].normal = *reinterpret_cast<const float3*>(bufferNormal);
 			if (normalView.byteStride != 0) {
 				bufferNormal += normalView.byteStride;
 			}
@@ -132,13 +132,12 @@ void Mesh::LoadVBO(const tinygltf::Model& srcModel, const tinygltf::Mesh& srcMes
 			}
 
 		}
-		glUnmapBuffer(GL_ARRAY_BUFFER);
 
 	}
 
 }
 
-void Mesh::LoadEBO(const tinygltf::Model& srcModel, const tinygltf::Mesh& srcMesh, const tinygltf::Primitive& primitive) {
+void Mesh::LoadEBO(const tinygltf::Model& srcModel, const tinygltf::Mesh& srcMesh, const tinygltf::Primitive& primitive, std::vector<unsigned>& indices) {
 
 	if (primitive.indices >= 0) {
 
@@ -146,106 +145,47 @@ void Mesh::LoadEBO(const tinygltf::Model& srcModel, const tinygltf::Mesh& srcMes
 		const tinygltf::BufferView& indView = srcModel.bufferViews[indAcc.bufferView];
 		const unsigned char* buffer = &(srcModel.buffers[indView.buffer].data[indAcc.byteOffset + indView.byteOffset]);
 		indexCount = indAcc.count;
-		glGenBuffers(1, &EBO);
-		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-		glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(unsigned int) * indAcc.count, nullptr, GL_STATIC_DRAW);
-		uint32_t* ptr = reinterpret_cast<uint32_t*>(glMapBuffer(GL_ELEMENT_ARRAY_BUFFER, GL_WRITE_ONLY));
+		indices.resize(indAcc.count);
 		if (indAcc.componentType == TINYGLTF_PARAMETER_TYPE_UNSIGNED_INT) {
 			const uint32_t* bufferInd = reinterpret_cast<const uint32_t*>(buffer);
 			for (uint32_t i = 0; i < indAcc.count; i++) {
-				ptr[i] = bufferInd[i];
+				indices[i] = bufferInd[i];
 			}
 		}
 		else if (indAcc.componentType == TINYGLTF_PARAMETER_TYPE_UNSIGNED_SHORT) {
 			const unsigned short* bufferInd = reinterpret_cast<const unsigned short*>(buffer);
 			for (uint32_t i = 0; i < indAcc.count; i++) {
-				ptr[i] = bufferInd[i];
+				indices[i] = bufferInd[i];
 			}
 		}
 		else if (indAcc.componentType == TINYGLTF_PARAMETER_TYPE_UNSIGNED_BYTE) {
 			const unsigned char* bufferInd = reinterpret_cast<const unsigned char*>(buffer);
 			for (uint32_t i = 0; i < indAcc.count; i++) {
-				ptr[i] = bufferInd[i];
+				indices[i] = bufferInd[i];
 			}
 		}
-
-		glUnmapBuffer(GL_ELEMENT_ARRAY_BUFFER);
 	}
 	else {
+		//Without index every draw is still indexed, the arena is submitted with glMultiDrawElementsIndirect
 		indexCount = 0;
+		indices.resize(vertexCount);
+		for (int i = 0; i < vertexCount; i++) {
+			indices[i] = i;
+		}
 	}
 
 }
 
-void Mesh::CreateVAO() {
-	glGenVertexArrays(1, &VAO);
-
-	glBindVertexArray(VAO);
-	glBindBuffer(GL_ARRAY_BUFFER, VBO);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-
-	
-	glEnableVertexAttribArray(0);
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, (void*)0);
-
-	glEnableVertexAttribArray(1);
-	glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 0, (void*)(sizeof(float) * 3 * vertexCount));
-
-	glEnableVertexAttribArray(2);
-	if (textureCount != 0) {
-		glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, 0, (void*)(sizeof(float) * 5 * vertexCount));
-	}
-	else {
-		glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, 0, (void*)(sizeof(float) * 3 * vertexCount));
-	}
-	
-
-	glBindVertexArray(0);
-}
-
-void Mesh::Draw(const std::vector<unsigned>& textures, unsigned program_id) {
-
-	glUseProgram(program_id);
-
-	if (textures.size() > 0) {
-		glActiveTexture(GL_TEXTURE0);
-		glBindTexture(GL_TEXTURE_2D, textures[textureID]);
-		glUniform1i(glGetUniformLocation(program_id, "diffuse_texture"), 0);
-	}
-
-	glUniform1f(glGetUniformLocation(program_id, "diffuse_constant"), 0.640f);
-	glUniform1f(glGetUniformLocation(program_id, "specular_constant"), 0.550f);
-	glUniform1f(glGetUniformLocation(program_id, "n"), 29.25f);
-
-	glUniform3f(glGetUniformLocation(program_id, "light_color"), 0.992f, 0.857f, 0.510f);
-	glUniform3f(glGetUniformLocation(program_id, "light_direction"), -0.800f, 8.100f, -6.700);
-	glUniform3f(glGetUniformLocation(program_id, "ambient_color"), 0.802f, 0.739f, 0.739f);
-	glUniform3f(glGetUniformLocation(program_id, "camera_position"), App->GetCamera()->GetPosition()->x, App->GetCamera()->GetPosition()->y, App->GetCamera()->GetPosition()->z);
-
-	if (indexCount > 0) {
-		glBindVertexArray(VAO);
-		glDrawElements(GL_TRIANGLES, indexCount, GL_UNSIGNED_INT, nullptr);
-	}
-	else { //Without index and with textures coords
-		glBindBuffer(GL_ARRAY_BUFFER, VBO);
-		glEnableVertexAttribArray(0);
-		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, (void*)0);
-
-		glEnableVertexAttribArray(1);
-		glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 0, (void*)(sizeof(float)*3*vertexCount));
-
-		glDrawArrays(GL_TRIANGLES, 0, vertexCount);
-
-	}
-	
-
+//Transforms live in the model's instance buffer, firstInstance is this mesh's offset in it
+void Mesh::SetInstances(const std::vector<float4x4>& transforms, unsigned firstInstance) {
+	instances = transforms;
+	this->firstInstance = firstInstance;
 }
 
 
 void Mesh::DestroyBuffers() {
-	glDeleteBuffers(1, &VBO);
-	if (indexCount != 0) {
-		glDeleteBuffers(1, &EBO);
-		glDeleteBuffers(1, &VAO);
+	if (arena != nullptr) {
+		arena->Free(range);
+		arena = nullptr;
 	}
-}
\ No newline at end of file
+}
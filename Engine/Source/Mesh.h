@@ -5,6 +5,8 @@
 #define TINYGLTF_NO_EXTERNAL_IMAGE 
 #include "tiny_gltf.h"
 #include "Geometry/AABB.h"
+#include "Math/float4x4.h"
+#include "GeometryArena.h"
 
 namespace tinygltf
 {
@@ -13,11 +15,29 @@ namespace tinygltf
 	class Primitive;	
 }
 
+//One source primitive instance inside a static batch, indices relative to the batch's range
+struct MeshPart
+{
+	unsigned firstIndex = 0;
+	unsigned indexCount = 0;
+	unsigned firstVertex = 0; //The vertices the part's indices reference, relative to the batch
+	unsigned vertexCount = 0;
+	AABB bounds; //World space, like the batch's vertices
+};
 
 class Mesh
 {
 private:
-	unsigned VBO = 0, EBO = 0, VAO = 0, programID = 0, textureID = 0;
+	GeometryArena* arena = nullptr;
+	GeometryRange range;
+	std::vector<float4x4> instances;
+	unsigned firstInstance = 0;
+	bool occluder = false;
+	std::vector<float3> occluderPositions; //CPU copy kept only for occluders
+	std::vector<unsigned> occluderIndices;
+	std::vector<MeshPart> parts; //Only static batches have parts
+	unsigned firstPartBox = 0;
+	int materialIndex = -1;
 	int vertexCount = 0, indexCount = 0, textureCount = 0;
 	std::string name = "";
 	AABB* meshAABB;
@@ -29,12 +49,29 @@ public:
 	inline const int GetVertexCount() const { return vertexCount; }
 	inline const std::string* GetName() const { return &name; }
 	inline const AABB* GetAABB() const { return meshAABB; }
+	inline int GetMaterialIndex() const { return materialIndex; }
+	inline bool HasUV() const { return textureCount > 0; }
+	inline unsigned GetVAO() const { return arena->GetVAO(); }
+	inline const GeometryRange& GetRange() const { return range; }
+	inline const std::vector<float4x4>* GetInstances() const { return &instances; }
+	inline int GetInstanceCount() const { return (int)instances.size(); }
+	inline unsigned GetFirstInstance() const { return firstInstance; }
+	inline bool IsOccluder() const { return occluder; }
+	inline const std::vector<float3>& GetOccluderPositions() const { return occluderPositions; }
+	inline const std::vector<unsigned>& GetOccluderIndices() const { return occluderIndices; }
+	inline bool IsBatch() const { return !parts.empty(); }
+	inline const std::vector<MeshPart>& GetParts() const { return parts; }
+	//Culler index of part p of instance i is firstPartBox + i * parts.size() + p
+	inline unsigned GetFirstPartBox() const { return firstPartBox; }
+	inline void SetFirstPartBox(unsigned box) { firstPartBox = box; }
 
-	void Load(const tinygltf::Model& srcModel, const tinygltf::Mesh& srcMesh, const tinygltf::Primitive& primitive);
-	void LoadVBO(const tinygltf::Model& srcModel, const tinygltf::Mesh& srcMesh, const tinygltf::Primitive& primitive);
-	void LoadEBO(const tinygltf::Model& srcModel, const tinygltf::Mesh& srcMesh, const tinygltf::Primitive& primitive);
-	void CreateVAO();
-	void Draw(const std::vector<unsigned>& textures, unsigned program_id);
+	void Load(const tinygltf::Model& srcModel, const tinygltf::Mesh& srcMesh, const tinygltf::Primitive& primitive, GeometryArena* arena, bool occluder);
+	//Vertices are already in world space, the batch is drawn with identity instances
+	void LoadBatch(const std::string& name, int materialIndex, bool hasUV, const std::vector<ArenaVertex>& vertices, const std::vector<unsigned>& indices,
+		const std::vector<MeshPart>& parts, GeometryArena* arena, const std::vector<float3>& occluderPositions, const std::vector<unsigned>& occluderIndices);
+	void LoadVBO(const tinygltf::Model& srcModel, const tinygltf::Mesh& srcMesh, const tinygltf::Primitive& primitive, std::vector<ArenaVertex>& vertices);
+	void LoadEBO(const tinygltf::Model& srcModel, const tinygltf::Mesh& srcMesh, const tinygltf::Primitive& primitive, std::vector<unsigned>& indices);
+	void SetInstances(const std::vector<float4x4>& transforms, unsigned firstInstance);
 	void DestroyBuffers();
 
 };
@@ -1,13 +1,31 @@
 #include "Globals.h"
 #include "Application.h"
 #include "ModuleTexture.h"
+#include "GLState.h"
 #include "Model.h"
+#ifndef ENGINE_NO_DIRECTXTEX
 #include "DirectXTex/DirectXTex.h"
-#include <.\GL\glew.h>
+#endif
+#include <GL/glew.h>
 #include "Geometry/AABB.h"
+#include "Geometry/OBB.h"
+#include "Math/Quat.h"
+#include "Math/TransformOps.h"
 #include "Mesh.h"
+#include "RenderQueue.h"
+#include "ShaderPermutations.h"
+#include "FrustumCuller.h"
+#include "OcclusionCuller.h"
+#include "StaticBatcher.h"
+#include "Geometry/Frustum.h"
+#include <algorithm>
 
-Model::Model() {
+#define OCCLUDER_AUTO_COUNT 4
+
+Model::Model(GeometryArena* arena) {
+	this->arena = arena;
+	culler = new FrustumCuller();
+	occlusionCuller = new OcclusionCuller();
 	srcModel = new tinygltf::Model;
 	modelAABB = new AABB;
 	modelAABB->SetNegativeInfinity();
@@ -17,6 +35,8 @@ Model::~Model() {
 
 	delete srcModel;
 	delete modelAABB;
+	delete culler;
+	delete occlusionCuller;
 
 	for (int i = 0; i < scrImages.size(); i++) {
 		delete scrImages[i];
@@ -28,13 +48,54 @@ Model::~Model() {
 	}
 
 	for (int i = 0; i < textures.size(); i++) {
-		glDeleteTextures(1, &textures[i]);
+		GLState::DeleteTextures(1, &textures[i]);
+	}
+
+	for (int i = 0; i < materials.size(); i++) {
+		materials[i].DestroyUniformBuffer();
+	}
+	defaultMaterial.DestroyUniformBuffer();
+	glDeleteBuffers(1, &instanceBuffer);
+}
+
+//Occluders are hand marked with "occluder" in the mesh name or as a boolean in the mesh extras.
+//Models without any get their largest primitives, measured from the POSITION accessor bounds.
+static std::vector<bool> SelectOccluders(const tinygltf::Model& srcModel) {
+	std::vector<bool> occluders;
+	std::vector<std::pair<float, int>> volumes;
+	bool anyMarked = false;
+
+	for (const auto& srcMesh : srcModel.meshes) {
+		std::string name = srcMesh.name;
+		std::transform(name.begin(), name.end(), name.begin(), ::tolower);
+		bool marked = name.find("occluder") != std::string::npos
+			|| (srcMesh.extras.Has("occluder") && srcMesh.extras.Get("occluder").IsBool() && srcMesh.extras.Get("occluder").Get<bool>());
+		anyMarked = anyMarked || marked;
+
+		for (const auto& primitive : srcMesh.primitives) {
+			float volume = 0.0f;
+			const auto& itPos = primitive.attributes.find("POSITION");
+			if (itPos != primitive.attributes.end()) {
+				const tinygltf::Accessor& posAcc = srcModel.accessors[itPos->second];
+				if (posAcc.minValues.size() == 3 && posAcc.maxValues.size() == 3) {
+					volume = (float)((posAcc.maxValues[0] - posAcc.minValues[0]) * (posAcc.maxValues[1] - posAcc.minValues[1]) * (posAcc.maxValues[2] - posAcc.minValues[2]));
+				}
+			}
+			volumes.push_back(std::make_pair(volume, (int)occluders.size()));
+			occluders.push_back(marked);
+		}
 	}
 
-	
+	if (!anyMarked) {
+		std::sort(volumes.begin(), volumes.end(), [](const std::pair<float, int>& a, const std::pair<float, int>& b) { return a.first > b.first; });
+		for (int i = 0; i < volumes.size() && i < OCCLUDER_AUTO_COUNT; i++) {
+			occluders[volumes[i].second] = true;
+		}
+	}
+	return occluders;
 }
 
-void Model::Load(const char* assetFileName) {
+void Model::Load(const char* assetFileName, bool staticBatching) {
 	tinygltf::TinyGLTF gltfContext;
 	std::string error, warning;
 
@@ -56,54 +117,543 @@ void Model::Load(const char* assetFileName) {
 				filePath.erase(pos + 1, filePath.size() - 1);
 			}
 		}
+		//Nodes are walked first, whether a primitive is batched depends on how many of them use it
+		std::vector<int> firstPrimitive;
+		int primitiveCount = 0;
+		for (const auto& srcMesh : srcModel->meshes) {
+			firstPrimitive.push_back(primitiveCount);
+			primitiveCount += srcMesh.primitives.size();
+		}
+		sceneInstances.resize(primitiveCount);
+		if (srcModel->nodes.empty()) {
+			for (int i = 0; i < primitiveCount; i++) {
+				sceneInstances[i].push_back(float4x4::identity);
+			}
+		}
+		else {
+			int sceneIndex = srcModel->defaultScene >= 0 ? srcModel->defaultScene : 0;
+			if (sceneIndex < srcModel->scenes.size()) {
+				for (int node : srcModel->scenes[sceneIndex].nodes) {
+					LoadNode(node, float4x4::identity, firstPrimitive);
+				}
+			}
+			else {
+				for (int node = 0; node < srcModel->nodes.size(); node++) {
+					LoadNode(node, float4x4::identity, firstPrimitive);
+				}
+			}
+		}
+
+		//Every other primitive is uploaded once, nodes that reuse a glTF mesh become instances of it
+		std::vector<bool> occluders = SelectOccluders(*srcModel);
+		std::vector<std::vector<float4x4>> primitiveInstances;
+		primitiveInstances.swap(sceneInstances);
+		StaticBatcher batcher;
+		int primitiveIndex = 0;
 		for (const auto& srcMesh : srcModel->meshes) {
 			for (const auto& primitive : srcMesh.primitives) {
-				Mesh* mesh = new Mesh;
-				mesh->Load(*srcModel, srcMesh, primitive);
-				modelAABB->Enclose(*mesh->GetAABB());
-				const auto& itPos = primitive.attributes.find("POSITION");
-				meshes.push_back(mesh);
+				const std::vector<float4x4>& transforms = primitiveInstances[primitiveIndex];
+				if (staticBatching && !transforms.empty() && transforms.size() <= STATIC_BATCH_MAX_INSTANCES) {
+					batcher.Add(*srcModel, srcMesh, primitive, transforms, occluders[primitiveIndex]);
+				}
+				else {
+					Mesh* mesh = new Mesh;
+					mesh->Load(*srcModel, srcMesh, primitive, arena, occluders[primitiveIndex]);
+					meshes.push_back(mesh);
+					sceneInstances.push_back(transforms);
+				}
+				primitiveIndex++;
 			}
 		}
+		if (batcher.GetSourceCount() > 0) {
+			size_t firstBatch = meshes.size();
+			batcher.Build(arena, meshes);
+			sceneInstances.resize(meshes.size(), std::vector<float4x4>(1, float4x4::identity));
+			batchStats.primitives = batcher.GetSourceCount();
+			batchStats.parts = batcher.GetPartCount();
+			batchStats.batches = meshes.size() - firstBatch;
+			batchStats.sourceBytes = batcher.GetSourceBytes();
+			batchStats.batchedBytes = batcher.GetBatchedBytes();
+		}
+
+		for (int i = 0; i < meshes.size(); i++) {
+			for (const float4x4& transform : sceneInstances[i]) {
+				modelAABB->Enclose(meshes[i]->GetAABB()->Transform(transform).MinimalEnclosingAABB());
+			}
+		}
+		ApplyInstances();
 		LoadMaterials();
 	}
 }
 
+void Model::LoadNode(int nodeIndex, const float4x4& parentTransform, const std::vector<int>& firstPrimitive) {
+	const tinygltf::Node& node = srcModel->nodes[nodeIndex];
+
+	float4x4 local = float4x4::identity;
+	if (node.matrix.size() == 16) { //glTF matrices are column major
+		for (int column = 0; column < 4; column++) {
+			for (int row = 0; row < 4; row++) {
+				local.At(row, column) = (float)node.matrix[column * 4 + row];
+			}
+		}
+	}
+	else {
+		float3 translation = float3::zero;
+		Quat rotation = Quat::identity;
+		float3 scale = float3::one;
+		if (node.translation.size() == 3) {
+			translation = float3((float)node.translation[0], (float)node.translation[1], (float)node.translation[2]);
+		}
+		if (node.rotation.size() == 4) {
+			rotation = Quat((float)node.rotation[0], (float)node.rotation[1], (float)node.rotation[2], (float)node.rotation[3]);
+		}
+		if (node.scale.size() == 3) {
+			scale = float3((float)node.scale[0], (float)node.scale[1], (float)node.scale[2]);
+		}
+		local = float4x4::FromTRS(translation, rotation, scale);
+	}
+	float4x4 world = parentTransform * local;
+
+	if (node.mesh >= 0 && node.mesh < firstPrimitive.size()) {
+		int primitiveCount = srcModel->meshes[node.mesh].primitives.size();
+		for (int i = 0; i < primitiveCount; i++) {
+			sceneInstances[firstPrimitive[node.mesh] + i].push_back(world);
+		}
+	}
+
+	for (int child : node.children) {
+		LoadNode(child, world, firstPrimitive);
+	}
+}
+
+//Stress mode lays copies of the whole scene on an XZ grid, each mesh still takes a single draw
+void Model::SetStressCopies(int copies) {
+	stressCopies = copies > 1 ? copies : 1;
+	ApplyInstances();
+}
+
+void Model::ApplyInstances() {
+	int side = (int)ceilf(sqrtf((float)stressCopies));
+	float3 size = meshes.empty() ? float3::one : modelAABB->Size();
+	float spacingX = size.x * 1.25f;
+	float spacingZ = size.z * 1.25f;
+
+	std::vector<float4x4> columnMajor;
+	culler->Clear();
+	occlusionCuller->ClearOccluders();
+	for (int i = 0; i < meshes.size(); i++) {
+		std::vector<float4x4> transforms;
+		transforms.reserve(sceneInstances[i].size() * stressCopies);
+		for (int copy = 0; copy < stressCopies; copy++) {
+			float4x4 offset = float4x4::Translate(float3((copy % side) * spacingX, 0.0f, (copy / side) * spacingZ));
+			for (const float4x4& transform : sceneInstances[i]) {
+				transforms.push_back(offset * transform);
+			}
+		}
+		meshes[i]->SetInstances(transforms, columnMajor.size());
+		for (const float4x4& transform : transforms) {
+			columnMajor.push_back(transform.Transposed());
+			culler->AddBox(meshes[i]->GetAABB()->Transform(transform).MinimalEnclosingAABB());
+			if (meshes[i]->IsOccluder()) {
+				occlusionCuller->AddOccluder(meshes[i]->GetOccluderPositions(), meshes[i]->GetOccluderIndices(), transform);
+			}
+		}
+	}
+
+	//Part boxes go after every instance box, instance indices stay valid culler indices
+	for (Mesh* mesh : meshes) {
+		if (!mesh->IsBatch()) {
+			continue;
+		}
+		mesh->SetFirstPartBox(culler->GetBoxCount());
+		for (const float4x4& transform : *mesh->GetInstances()) {
+			for (const MeshPart& part : mesh->GetParts()) {
+				culler->AddBox(part.bounds.Transform(transform).MinimalEnclosingAABB());
+			}
+		}
+	}
+
+	if (instanceBuffer == 0) {
+		glGenBuffers(1, &instanceBuffer);
+	}
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, instanceBuffer);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(float4x4) * columnMajor.size(), columnMajor.data(), GL_STATIC_DRAW);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+void Model::Cull(const Frustum& frustum, bool frustumCulling, bool occlusionCulling) {
+	if (frustumCulling) {
+		culler->Cull(frustum);
+	}
+	else {
+		culler->SetAllVisible();
+	}
+
+	occludedCount = 0;
+	if (occlusionCulling) {
+		occlusionCuller->Render(frustum.ViewProjMatrix());
+		for (unsigned i = 0; i < culler->GetBoxCount(); i++) {
+			if (culler->IsVisible(i) && !occlusionCuller->IsVisible(culler->GetBox(i))) {
+				culler->Hide(i);
+				occludedCount++;
+			}
+		}
+	}
+}
+
+void Model::BindInstances() const {
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, INSTANCE_SSBO_BINDING, instanceBuffer);
+}
+
+#ifndef ENGINE_NO_DIRECTXTEX
+//Packing works on the top mip of every map in RGBA8
+static bool ToRGBA8(const DirectX::ScratchImage& src, DirectX::ScratchImage& dst) {
+	const DirectX::Image* image = src.GetImage(0, 0, 0);
+	if (image == nullptr) {
+		return false;
+	}
+	if (DirectX::IsCompressed(image->format)) {
+		return SUCCEEDED(DirectX::Decompress(*image, DXGI_FORMAT_R8G8B8A8_UNORM, dst));
+	}
+	if (image->format == DXGI_FORMAT_R8G8B8A8_UNORM) {
+		return SUCCEEDED(dst.InitializeFromImage(*image));
+	}
+	return SUCCEEDED(DirectX::Convert(*image, DXGI_FORMAT_R8G8B8A8_UNORM, DirectX::TEX_FILTER_DEFAULT, DirectX::TEX_THRESHOLD_DEFAULT, dst));
+}
+
+//Packed maps are rebuilt from their top level, so their chain is regenerated whatever the sources had
+static void GenerateMips(DirectX::ScratchImage& image) {
+	DirectX::ScratchImage mipped;
+	if (SUCCEEDED(DirectX::GenerateMipMaps(*image.GetImage(0, 0, 0), DirectX::TEX_FILTER_DEFAULT, 0, mipped))) {
+		image = std::move(mipped);
+	}
+}
+
+//glTF already stores roughness in G and metallic in B, occlusion goes into the unused R channel.
+//Missing maps are filled with 1 so the material factors apply unchanged.
+static DirectX::ScratchImage* PackOcclusionRoughnessMetallic(const DirectX::ScratchImage* occlusion, const DirectX::ScratchImage* roughnessMetallic) {
+	DirectX::ScratchImage* orm = new DirectX::ScratchImage();
+	DirectX::ScratchImage occlusionRGBA;
+	bool hasRoughnessMetallic = roughnessMetallic != nullptr && ToRGBA8(*roughnessMetallic, *orm);
+	bool hasOcclusion = occlusion != nullptr && ToRGBA8(*occlusion, occlusionRGBA);
+
+	if (!hasRoughnessMetallic && !hasOcclusion) {
+		delete orm;
+		return nullptr;
+	}
+	if (!hasRoughnessMetallic) {
+		*orm = std::move(occlusionRGBA);
+	}
+
+	const DirectX::Image* dst = orm->GetImage(0, 0, 0);
+	const DirectX::Image* ao = nullptr;
+	DirectX::ScratchImage resized;
+	if (hasRoughnessMetallic && hasOcclusion) {
+		ao = occlusionRGBA.GetImage(0, 0, 0);
+		if (ao->width != dst->width || ao->height != dst->height) {
+			DirectX::Resize(*ao, dst->width, dst->height, DirectX::TEX_FILTER_DEFAULT, resized);
+			ao = resized.GetImage(0, 0, 0);
+		}
+	}
+
+	for (size_t y = 0; y < dst->height; ++y) {
+		uint8_t* pixel = dst->pixels + y * dst->rowPitch;
+		const uint8_t* aoPixel = ao != nullptr ? ao->pixels + y * ao->rowPitch : nullptr;
+		for (size_t x = 0; x < dst->width; ++x, pixel += 4) {
+			if (!hasRoughnessMetallic) {
+				pixel[1] = 255;
+				pixel[2] = 255;
+			}
+			else {
+				pixel[0] = aoPixel != nullptr ? aoPixel[x * 4] : 255;
+			}
+			pixel[3] = 255;
+		}
+	}
+
+	GenerateMips(*orm);
+	return orm;
+}
+
+//Normals only need XY, BC5 keeps them at 8 bits per channel in half the size of RGBA8
+static DirectX::ScratchImage* CompressNormalMap(DirectX::ScratchImage* normal) {
+	DirectX::ScratchImage rgba;
+	DirectX::ScratchImage* bc5 = new DirectX::ScratchImage();
+	if (!ToRGBA8(*normal, rgba)) {
+		delete bc5;
+		return normal;
+	}
+	GenerateMips(rgba);
+	if (FAILED(DirectX::Compress(rgba.GetImages(), rgba.GetImageCount(), rgba.GetMetadata(), DXGI_FORMAT_BC5_UNORM, DirectX::TEX_COMPRESS_PARALLEL, DirectX::TEX_THRESHOLD_DEFAULT, *bc5))) {
+		delete bc5;
+		return normal;
+	}
+	delete normal;
+	return bc5;
+}
+#else
+//stb_image already hands out RGBA8, occlusion is sampled nearest when its size differs
+static TextureImage* PackOcclusionRoughnessMetallic(const TextureImage* occlusion, const TextureImage* roughnessMetallic) {
+	if (roughnessMetallic == nullptr && occlusion == nullptr) {
+		return nullptr;
+	}
+	TextureImage* orm = new TextureImage(roughnessMetallic != nullptr ? *roughnessMetallic : *occlusion);
+	for (unsigned y = 0; y < orm->height; ++y) {
+		unsigned char* pixel = orm->pixels.data() + y * orm->width * 4;
+		for (unsigned x = 0; x < orm->width; ++x, pixel += 4) {
+			if (roughnessMetallic == nullptr) {
+				pixel[1] = 255;
+				pixel[2] = 255;
+			}
+			else if (occlusion != nullptr) {
+				unsigned aoX = x * occlusion->width / orm->width;
+				unsigned aoY = y * occlusion->height / orm->height;
+				pixel[0] = occlusion->pixels[(aoY * occlusion->width + aoX) * 4];
+			}
+			else {
+				pixel[0] = 255;
+			}
+			pixel[3] = 255;
+		}
+	}
+	return orm;
+}
+
+//No BC5 encoder without DirectXTex, normal maps stay RGBA8
+static TextureImage* CompressNormalMap(TextureImage* normal) {
+	return normal;
+}
+#endif
+
+//There is no Basis Universal transcoder linked, so KHR_texture_basisu images are only used when they hold
+//plain block data. ETC1S/UASTC payloads fall back to the texture's regular source.
+int Model::GetImageSource(int textureIndex) const {
+	if (textureIndex < 0) {
+		return -1;
+	}
+	const tinygltf::Texture& texture = srcModel->textures[textureIndex];
+	const auto& itBasisu = texture.extensions.find("KHR_texture_basisu");
+	if (itBasisu != texture.extensions.end() && itBasisu->second.Has("source")) {
+		int basisSource = itBasisu->second.Get("source").Get<int>();
+		std::string path = filePath + srcModel->images[basisSource].uri;
+		std::wstring widestr = std::wstring(path.begin(), path.end());
+		if (!App->GetTextureModule()->NeedsTranscoder(widestr.c_str())) {
+			return basisSource;
+		}
+		if (texture.source < 0) {
+			LOG("%s needs a Basis Universal transcoder and the texture has no fallback source", path.c_str());
+		}
+	}
+	return texture.source;
+}
+
+TextureImage* Model::LoadTextureImage(int textureIndex) {
+	int source = GetImageSource(textureIndex);
+	if (source < 0) {
+		return nullptr;
+	}
+	const tinygltf::Image& image = srcModel->images[source];
+
+	std::string path = filePath + image.uri;
+	std::wstring widestr = std::wstring(path.begin(), path.end());
+
+	TextureImage* scrImage = new TextureImage();
+	if (!App->GetTextureModule()->LoadTextureFile(*scrImage, widestr.c_str())) {
+		delete scrImage;
+		return nullptr;
+	}
+	return scrImage;
+}
+
+unsigned Model::UploadTexture(TextureImage* scrImage, const std::string& name) {
+	unsigned textureId = App->GetTextureModule()->LoadTextureGPU(scrImage);
+	scrImages.push_back(scrImage);
+	scrImageNames.push_back(name);
+	textures.push_back(textureId);
+	return textureId;
+}
+
 void Model::LoadMaterials() {
+	ModuleTexture* textureModule = App->GetTextureModule();
+
+	//Used by primitives without a material
+	defaultMaterial.baseColor = textureModule->GetWhiteTexture();
+	defaultMaterial.occlusionRoughnessMetallic = textureModule->GetWhiteTexture();
+	defaultMaterial.normal = textureModule->GetFlatNormalTexture();
+	defaultMaterial.CreateUniformBuffer();
+
 	for (const auto& srcMaterial : srcModel->materials) {
-		unsigned int textureId = 0;
-		if (srcMaterial.pbrMetallicRoughness.baseColorTexture.index >= 0) {
-			const tinygltf::Texture& texture = srcModel->textures[srcMaterial.pbrMetallicRoughness.baseColorTexture.index];
-			const tinygltf::Image& image = srcModel->images[texture.source];
-			
+		Material material;
+		material.baseColor = textureModule->GetWhiteTexture();
+		material.occlusionRoughnessMetallic = textureModule->GetWhiteTexture();
+		material.normal = textureModule->GetFlatNormalTexture();
+
+		TextureImage* baseColor = LoadTextureImage(srcMaterial.pbrMetallicRoughness.baseColorTexture.index);
+		if (baseColor != nullptr) {
+			material.baseColor = UploadTexture(baseColor, srcMaterial.name + " (base color)");
+			material.shaderFeatures |= SHADER_FEATURE_HAS_BASE_COLOR_MAP;
+		}
 
-			std::string path = filePath + image.uri;
-			std::wstring widestr = std::wstring(path.begin(), path.end());
+		int occlusionIndex = srcMaterial.occlusionTexture.index;
+		int roughnessMetallicIndex = srcMaterial.pbrMetallicRoughness.metallicRoughnessTexture.index;
+		TextureImage* orm = nullptr;
+		if (occlusionIndex >= 0 && GetImageSource(occlusionIndex) == GetImageSource(roughnessMetallicIndex)) {
+			//Exporter already packed occlusion with roughness/metallic (Chess, Corset)
+			orm = LoadTextureImage(occlusionIndex);
+		}
+		else {
+			TextureImage* occlusion = LoadTextureImage(occlusionIndex);
+			TextureImage* roughnessMetallic = LoadTextureImage(roughnessMetallicIndex);
+			orm = PackOcclusionRoughnessMetallic(occlusion, roughnessMetallic);
+			delete occlusion;
+			delete roughnessMetallic;
+		}
+		if (orm != nullptr) {
+			material.occlusionRoughnessMetallic = UploadTexture(orm, srcMaterial.name + " (ORM)");
+			material.shaderFeatures |= SHADER_FEATURE_HAS_OCCLUSION_MAP;
+		}
 
-			DirectX::ScratchImage* scrImage = new DirectX::ScratchImage();
-			App->GetTextureModule()->LoadTextureFile(*scrImage, widestr.c_str());
-			textureId = App->GetTextureModule()->LoadTextureGPU(scrImage);
-			scrImages.push_back(scrImage);
-			//textureId = App->GetTextureModule()->Load(filePath+image.uri);
+		TextureImage* normal = LoadTextureImage(srcMaterial.normalTexture.index);
+		if (normal != nullptr) {
+			material.normal = UploadTexture(CompressNormalMap(normal), srcMaterial.name + " (normal)");
+			material.shaderFeatures |= SHADER_FEATURE_HAS_NORMAL_MAP;
 		}
-		textures.push_back(textureId);
+
+		material.CreateUniformBuffer();
+		materials.push_back(material);
 	}
 }
 
 
-void Model::DrawModel(unsigned program_id) {
+//Only the instances left visible by the last Cull are pushed
+void Model::Enqueue(RenderQueue& queue, ShaderPermutations& programs, const float3& cameraPosition) const {
+	std::vector<unsigned> visible;
+	batchStats.visibleParts = 0;
+	batchStats.draws = 0;
 	for (unsigned int i = 0; i < meshes.size(); i++) {
-		meshes.at(i)->Draw(textures, program_id);
+		const Material& material = GetMaterial(*meshes[i]);
+		if (meshes[i]->IsBatch()) {
+			EnqueueBatch(queue, programs, *meshes[i], material, cameraPosition);
+			continue;
+		}
+
+		visible.clear();
+		unsigned firstInstance = meshes[i]->GetFirstInstance();
+		for (unsigned instance = firstInstance; instance < firstInstance + meshes[i]->GetInstanceCount(); instance++) {
+			if (culler->IsVisible(instance)) {
+				visible.push_back(instance);
+			}
+		}
+		if (visible.empty()) {
+			continue;
+		}
+
+		const float4x4& transform = meshes[i]->GetInstances()->at(visible.front() - firstInstance);
+		float depth = transform.TransformPos(meshes[i]->GetAABB()->CenterPoint()).Distance(cameraPosition);
+		AABB bounds = culler->GetBox(visible.front());
+		for (unsigned instance : visible) {
+			bounds.Enclose(culler->GetBox(instance));
+		}
+		unsigned program = programs.Select(ShaderPermutations::GetFeatures(*meshes[i], material));
+		queue.Push(program, material, *meshes[i], meshes[i]->GetRange(), depth, visible.data(), visible.size(), bounds.minPoint, bounds.maxPoint);
+	}
+}
+
+//Visible parts that follow each other in the index buffer are drawn as one range. Copies of the
+//batch with the same visible ranges share their packets, as instances of them.
+void Model::EnqueueBatch(RenderQueue& queue, ShaderPermutations& programs, const Mesh& mesh, const Material& material, const float3& cameraPosition) const {
+	struct Group
+	{
+		std::vector<std::pair<unsigned, unsigned>> runs; //First and last part
+		std::vector<unsigned> instances;
+	};
+	std::vector<Group> groups;
+	std::vector<std::pair<unsigned, unsigned>> runs;
+	const std::vector<MeshPart>& parts = mesh.GetParts();
+
+	unsigned firstInstance = mesh.GetFirstInstance();
+	for (unsigned instance = firstInstance; instance < firstInstance + mesh.GetInstanceCount(); instance++) {
+		if (!culler->IsVisible(instance)) {
+			continue;
+		}
+		runs.clear();
+		unsigned firstBox = mesh.GetFirstPartBox() + (instance - firstInstance) * parts.size();
+		for (unsigned p = 0; p < parts.size(); p++) {
+			if (!culler->IsVisible(firstBox + p)) {
+				continue;
+			}
+			batchStats.visibleParts++;
+			if (!runs.empty() && runs.back().second + 1 == p) {
+				runs.back().second = p;
+			}
+			else {
+				runs.push_back(std::make_pair(p, p));
+			}
+		}
+		if (runs.empty()) {
+			continue;
+		}
+
+		auto it = std::find_if(groups.begin(), groups.end(), [&runs](const Group& group) { return group.runs == runs; });
+		if (it == groups.end()) {
+			groups.push_back(Group());
+			groups.back().runs = runs;
+			it = groups.end() - 1;
+		}
+		it->instances.push_back(instance);
+	}
+
+	unsigned program = programs.Select(ShaderPermutations::GetFeatures(mesh, material));
+	for (const Group& group : groups) {
+		for (const std::pair<unsigned, unsigned>& run : group.runs) {
+			GeometryRange range = mesh.GetRange();
+			range.firstIndex += parts[run.first].firstIndex;
+			range.indexCount = parts[run.second].firstIndex + parts[run.second].indexCount - parts[run.first].firstIndex;
+			//Parts are also consecutive in the vertex buffer, the software rasterizer only transforms these
+			range.firstVertex = parts[run.first].firstVertex;
+			range.vertexCount = parts[run.second].firstVertex + parts[run.second].vertexCount - parts[run.first].firstVertex;
+
+			AABB bounds;
+			bounds.SetNegativeInfinity();
+			for (unsigned instance : group.instances) {
+				unsigned firstBox = mesh.GetFirstPartBox() + (instance - firstInstance) * parts.size();
+				for (unsigned p = run.first; p <= run.second; p++) {
+					bounds.Enclose(culler->GetBox(firstBox + p));
+				}
+			}
+			float depth = bounds.CenterPoint().Distance(cameraPosition);
+			queue.Push(program, material, mesh, range, depth, group.instances.data(), group.instances.size(), bounds.minPoint, bounds.maxPoint);
+			batchStats.draws++;
+		}
 	}
 }
 
+const Material& Model::GetMaterial(const Mesh& mesh) const {
+	int materialIndex = mesh.GetMaterialIndex();
+	return (materialIndex >= 0 && materialIndex < materials.size()) ? materials[materialIndex] : defaultMaterial;
+}
+
+unsigned Model::GetUsedPermutations() const {
+	unsigned permutations = 0;
+	for (const Mesh* mesh : meshes) {
+		permutations |= 1u << ShaderPermutations::GetFeatures(*mesh, GetMaterial(*mesh));
+	}
+	return permutations;
+}
 
 void Model::Clear() {
 
 	for (int i = 0; i < textures.size(); i++) {
-		glDeleteTextures(1, &textures[i]);
+		GLState::DeleteTextures(1, &textures[i]);
 	}
 	textures.clear();
+	for (int i = 0; i < materials.size(); i++) {
+		materials[i].DestroyUniformBuffer();
+	}
+	materials.clear();
+	defaultMaterial.DestroyUniformBuffer();
+	glDeleteBuffers(1, &instanceBuffer);
+	instanceBuffer = 0;
 	delete srcModel;
 	srcModel = new tinygltf::Model();
 
@@ -111,12 +661,17 @@ void Model::Clear() {
 		delete scrImages[i];
 	}
 	scrImages.clear();
+	scrImageNames.clear();
 
 	for (int i = 0; i < meshes.size(); i++) {
 		meshes[i]->DestroyBuffers();
 		delete meshes[i];
 	}
 	meshes.clear();
+	sceneInstances.clear();
+	batchStats = StaticBatchStats();
+	culler->Clear();
+	occlusionCuller->ClearOccluders();
 		
 	filePath = "";
 
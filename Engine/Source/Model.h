@@ -1,11 +1,12 @@
 #pragma once
 #include <vector>
+#include <string>
 #include <Math/float3.h>
+#include <Math/float4x4.h>
+#include "Material.h"
+#include "TextureImage.h"
 
-namespace DirectX
-{
-	class ScratchImage;
-}
+#define INSTANCE_SSBO_BINDING 2
 
 namespace tinygltf
 {
@@ -13,27 +14,79 @@ namespace tinygltf
 }
 
 class Mesh;
+class GeometryArena;
+class FrustumCuller;
+class OcclusionCuller;
+namespace math
+{
+	class Frustum;
+}
+class RenderQueue;
+class ShaderPermutations;
+
+//Static batching at load time, and what the last Enqueue drew of it
+struct StaticBatchStats
+{
+	unsigned primitives = 0; //Source primitives merged into batches
+	unsigned parts = 0; //Their node instances, each one a part with its own culling box
+	unsigned batches = 0;
+	size_t sourceBytes = 0; //Arena space the merged primitives take uploaded once and instanced
+	size_t batchedBytes = 0; //And pre-transformed into the batches
+	unsigned visibleParts = 0;
+	unsigned draws = 0; //Packets the visible parts were merged into
+};
 
 class Model
 {
 public:
-	void Load(const char* assetFileName);
+	void Load(const char* assetFileName, bool staticBatching = false);
 	void LoadMaterials();
-	void DrawModel(unsigned program_id);
+	void Enqueue(RenderQueue& queue, ShaderPermutations& programs, const float3& cameraPosition) const;
 	void Clear();
+	void SetStressCopies(int copies);
+	void BindInstances() const;
+	void Cull(const math::Frustum& frustum, bool frustumCulling, bool occlusionCulling);
 
 	inline const tinygltf::Model* GetSrcModel() const { return srcModel; }
 	inline const std::vector<Mesh*>* GetMeshes() const { return &meshes; }
-	inline const std::vector<DirectX::ScratchImage*> GetScrImages() const { return scrImages; }
+	inline const std::vector<TextureImage*> GetScrImages() const { return scrImages; }
+	inline const std::vector<std::string>* GetScrImageNames() const { return &scrImageNames; }
+	inline const std::vector<Material>* GetMaterials() const { return &materials; }
 	inline const AABB* GetAABB() const { return modelAABB; }
-	Model();
+	inline int GetStressCopies() const { return stressCopies; }
+	inline const FrustumCuller* GetCuller() const { return culler; }
+	inline const OcclusionCuller* GetOcclusionCuller() const { return occlusionCuller; }
+	inline unsigned GetOccludedCount() const { return occludedCount; }
+	inline const StaticBatchStats& GetBatchStats() const { return batchStats; }
+	//One bit per shader permutation some mesh draws with
+	unsigned GetUsedPermutations() const;
+	Model(GeometryArena* arena);
 	~Model();
 
 private:
+	int GetImageSource(int textureIndex) const;
+	TextureImage* LoadTextureImage(int textureIndex);
+	unsigned UploadTexture(TextureImage* scrImage, const std::string& name);
+	void LoadNode(int nodeIndex, const float4x4& parentTransform, const std::vector<int>& firstPrimitive);
+	void ApplyInstances();
+	void EnqueueBatch(RenderQueue& queue, ShaderPermutations& programs, const Mesh& mesh, const Material& material, const float3& cameraPosition) const;
+	const Material& GetMaterial(const Mesh& mesh) const;
+
 	tinygltf::Model* srcModel = nullptr;
-	std::vector<DirectX::ScratchImage*> scrImages;
+	std::vector<TextureImage*> scrImages;
+	std::vector<std::string> scrImageNames;
 	std::vector<unsigned> textures;
+	std::vector<Material> materials;
+	Material defaultMaterial;
 	std::vector<Mesh*> meshes;
+	std::vector<std::vector<float4x4>> sceneInstances; //World transforms of every node using each mesh
+	mutable StaticBatchStats batchStats; //The draw counts are refreshed by Enqueue
+	int stressCopies = 1;
+	unsigned instanceBuffer = 0; //SSBO with the column major transforms of every mesh instance
+	GeometryArena* arena = nullptr;
+	FrustumCuller* culler = nullptr; //One world space box per instance, in instance buffer order
+	OcclusionCuller* occlusionCuller = nullptr;
+	unsigned occludedCount = 0;
 	std::string filePath = "";
 	AABB* modelAABB;
 };
@@ -54,12 +54,12 @@ bool ModuleCamera::Init()
 }
 
 
-const float4x4& ModuleCamera::GetProjectionMatrix() {
+float4x4 ModuleCamera::GetProjectionMatrix() {
 	float4x4 proj_matrix = frustum->ProjectionMatrix();
 	return proj_matrix;
 }
 
-const float4x4& ModuleCamera::GetViewMatrix() {
+float4x4 ModuleCamera::GetViewMatrix() {
 	float4x4 view_matrix = frustum->ViewMatrix();
 	return view_matrix;
 }
@@ -1,10 +1,15 @@
 #include "Globals.h"
+#include "Application.h"
 #include "ModuleDebugDraw.h"
+#include "ModuleOpenGL.h"
+#include "StreamingBuffer.h"
+#include "GLState.h"
 
 #define DEBUG_DRAW_IMPLEMENTATION
-#include "DebugDraw.h"     // Debug Draw API. Notice that we need the DEBUG_DRAW_IMPLEMENTATION macro here!
+#include "debugdraw.h"     // Debug Draw API. Notice that we need the DEBUG_DRAW_IMPLEMENTATION macro here!
 
 #include "GL/glew.h"
+#include <vector>
 
 class DDRenderInterfaceCoreGL final
     : public dd::RenderInterface
@@ -20,42 +25,45 @@ public:
         assert(points != nullptr);
         assert(count > 0 && count <= DEBUG_DRAW_VERTEX_BUFFER_SIZE);
 
-        glBindVertexArray(linePointVAO);
-        glUseProgram(linePointProgram);
+        if (capturing)
+        {
+            capture(points, count, GL_POINTS, depthEnabled);
+            return;
+        }
+
+        GLState::BindVertexArray(linePointVAO);
+        GLState::UseProgram(linePointProgram);
 
         glUniformMatrix4fv(linePointProgram_MvpMatrixLocation,
                            1, GL_TRUE, reinterpret_cast<float*>(&mvpMatrix));
 
-        bool already = glIsEnabled(GL_DEPTH_TEST);
+        bool already = GLState::IsEnabled(GL_DEPTH_TEST);
 
         if (depthEnabled)
         {
-            glEnable(GL_DEPTH_TEST);
+            GLState::Enable(GL_DEPTH_TEST);
         }
         else
         {
-            glDisable(GL_DEPTH_TEST);
+            GLState::Disable(GL_DEPTH_TEST);
         }
 
-        // NOTE: Could also use glBufferData to take advantage of the buffer orphaning trick...
-        glBindBuffer(GL_ARRAY_BUFFER, linePointVBO);
-        glBufferSubData(GL_ARRAY_BUFFER, 0, count * sizeof(dd::DrawVertex), points);
+        bindVertexes(points, count, linePointVBO);
 
         // Issue the draw call:
         glDrawArrays(GL_POINTS, 0, count);
 
-        glUseProgram(0);
-        glBindVertexArray(0);
+        // Program and VAO stay bound, the next batch most likely needs them again
         glBindBuffer(GL_ARRAY_BUFFER, 0);
         checkGLError(__FILE__, __LINE__);
 
         if (already)
         {
-            glEnable(GL_DEPTH_TEST);
+            GLState::Enable(GL_DEPTH_TEST);
         }
         else
         {
-            glDisable(GL_DEPTH_TEST);
+            GLState::Disable(GL_DEPTH_TEST);
         }
 
     }
@@ -65,42 +73,45 @@ public:
         assert(lines != nullptr);
         assert(count > 0 && count <= DEBUG_DRAW_VERTEX_BUFFER_SIZE);
 
-        glBindVertexArray(linePointVAO);
-        glUseProgram(linePointProgram);
+        if (capturing)
+        {
+            capture(lines, count, GL_LINES, depthEnabled);
+            return;
+        }
+
+        GLState::BindVertexArray(linePointVAO);
+        GLState::UseProgram(linePointProgram);
 
         glUniformMatrix4fv(linePointProgram_MvpMatrixLocation,
                            1, GL_TRUE, reinterpret_cast<const float*>(&mvpMatrix));
 
-        bool already = glIsEnabled(GL_DEPTH_TEST);
+        bool already = GLState::IsEnabled(GL_DEPTH_TEST);
 
         if (depthEnabled)
         {
-            glEnable(GL_DEPTH_TEST);
+            GLState::Enable(GL_DEPTH_TEST);
         }
         else
         {
-            glDisable(GL_DEPTH_TEST);
+            GLState::Disable(GL_DEPTH_TEST);
         }
 
-        // NOTE: Could also use glBufferData to take advantage of the buffer orphaning trick...
-        glBindBuffer(GL_ARRAY_BUFFER, linePointVBO);
-        glBufferSubData(GL_ARRAY_BUFFER, 0, count * sizeof(dd::DrawVertex), lines);
+        bindVertexes(lines, count, linePointVBO);
 
         // Issue the draw call:
         glDrawArrays(GL_LINES, 0, count);
 
-        glUseProgram(0);
-        glBindVertexArray(0);
+        // Program and VAO stay bound, the next batch most likely needs them again
         glBindBuffer(GL_ARRAY_BUFFER, 0);
         checkGLError(__FILE__, __LINE__);
 
         if (already)
         {
-            glEnable(GL_DEPTH_TEST);
+            GLState::Enable(GL_DEPTH_TEST);
         }
         else
         {
-            glDisable(GL_DEPTH_TEST);
+            GLState::Disable(GL_DEPTH_TEST);
         }
 
     }
@@ -110,8 +121,8 @@ public:
         assert(glyphs != nullptr);
         assert(count > 0 && count <= DEBUG_DRAW_VERTEX_BUFFER_SIZE);
 
-        glBindVertexArray(textVAO);
-        glUseProgram(textProgram);
+        GLState::BindVertexArray(textVAO);
+        GLState::UseProgram(textProgram);
 
         // These doesn't have to be reset every draw call, I'm just being lazy ;)
         glUniform1i(textProgram_GlyphTextureLocation, 0);
@@ -121,40 +132,37 @@ public:
 
         if (glyphTex != nullptr)
         {
-            glActiveTexture(GL_TEXTURE0);
-            glBindTexture(GL_TEXTURE_2D, handleToGL(glyphTex));
+            GLState::BindTexture(0, handleToGL(glyphTex));
         }
 
-        bool already_blend = glIsEnabled(GL_BLEND);
+        bool already_blend = GLState::IsEnabled(GL_BLEND);
 
         if(!already_blend)
         {
-            glEnable(GL_BLEND);
+            GLState::Enable(GL_BLEND);
         }
 
         glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-        bool already = glIsEnabled(GL_DEPTH_TEST);
-        glDisable(GL_DEPTH_TEST);
+        bool already = GLState::IsEnabled(GL_DEPTH_TEST);
+        GLState::Disable(GL_DEPTH_TEST);
 
-        glBindBuffer(GL_ARRAY_BUFFER, textVBO);
-        glBufferSubData(GL_ARRAY_BUFFER, 0, count * sizeof(dd::DrawVertex), glyphs);
+        bindVertexes(glyphs, count, textVBO);
 
         glDrawArrays(GL_TRIANGLES, 0, count); // Issue the draw call
 
         if(!already_blend)
         {
-            glDisable(GL_BLEND);
+            GLState::Disable(GL_BLEND);
         }
 
-        glUseProgram(0);
-        glBindVertexArray(0);
+        // Program and VAO stay bound, the next batch most likely needs them again
         glBindBuffer(GL_ARRAY_BUFFER, 0);
-        glBindTexture(GL_TEXTURE_2D,  0);
+        GLState::BindTexture(0, 0);
         checkGLError(__FILE__, __LINE__);
 
         if (already)
         {
-            glEnable(GL_DEPTH_TEST);
+            GLState::Enable(GL_DEPTH_TEST);
         }
     }
 
@@ -165,7 +173,7 @@ public:
 
         GLuint textureId = 0;
         glGenTextures(1, &textureId);
-        glBindTexture(GL_TEXTURE_2D, textureId);
+        GLState::BindTexture(0, textureId);
 
         glPixelStorei(GL_PACK_ALIGNMENT,   1);
         glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
@@ -177,7 +185,7 @@ public:
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
 
-        glBindTexture(GL_TEXTURE_2D, 0);
+        GLState::BindTexture(0, 0);
         checkGLError(__FILE__, __LINE__);
 
         return GLToHandle(textureId);
@@ -191,8 +199,8 @@ public:
         }
 
         const GLuint textureId = handleToGL(glyphTex);
-        glBindTexture(GL_TEXTURE_2D, 0);
-        glDeleteTextures(1, &textureId);
+        GLState::BindTexture(0, 0);
+        GLState::DeleteTextures(1, &textureId);
     }
 
     // These two can also be implemented to perform GL render
@@ -217,6 +225,9 @@ public:
         , linePointVBO(0)
         , textVAO(0)
         , textVBO(0)
+        , retainedVBO(0)
+        , capturing(false)
+        , stream(App->GetOpenGL()->GetStreamingBuffer())
     {
         //std::printf("\n");
         //std::printf("GL_VENDOR    : %s\n",   glGetString(GL_VENDOR));
@@ -226,12 +237,12 @@ public:
         //std::printf("DDRenderInterfaceCoreGL initializing ...\n");
 
         // Default OpenGL states:
-        glEnable(GL_CULL_FACE);
-        glEnable(GL_DEPTH_TEST);
-        glDisable(GL_BLEND);
+        GLState::Enable(GL_CULL_FACE);
+        GLState::Enable(GL_DEPTH_TEST);
+        GLState::Disable(GL_BLEND);
 
         // This has to be enabled since the point drawing shader will use gl_PointSize.
-        glEnable(GL_PROGRAM_POINT_SIZE);
+        GLState::Enable(GL_PROGRAM_POINT_SIZE);
 
         setupShaderPrograms();
         setupVertexBuffers();
@@ -241,14 +252,66 @@ public:
 
     ~DDRenderInterfaceCoreGL()
     {
-        glDeleteProgram(linePointProgram);
-        glDeleteProgram(textProgram);
+        GLState::DeleteProgram(linePointProgram);
+        GLState::DeleteProgram(textProgram);
 
-        glDeleteVertexArrays(1, &linePointVAO);
+        GLState::DeleteVertexArrays(1, &linePointVAO);
         glDeleteBuffers(1, &linePointVBO);
 
-        glDeleteVertexArrays(1, &textVAO);
+        GLState::DeleteVertexArrays(1, &textVAO);
         glDeleteBuffers(1, &textVBO);
+
+        glDeleteBuffers(1, &retainedVBO);
+    }
+
+    // Shapes emitted by the callback are kept instead of drawn, returns the first and count of their ranges.
+    // Only points and lines are captured, text depends on the screen size and always goes through flush.
+    void captureRetained(const std::function<void()>& shapes, unsigned& firstRange, unsigned& rangeCount)
+    {
+        firstRange = static_cast<unsigned>(retainedRanges.size());
+        capturing = true;
+        shapes();
+        dd::flush(0, dd::FlushPoints | dd::FlushLines);
+        capturing = false;
+        rangeCount = static_cast<unsigned>(retainedRanges.size()) - firstRange;
+
+        // The whole buffer is uploaded again, shapes are only added at startup
+        if (retainedVBO == 0)
+        {
+            glGenBuffers(1, &retainedVBO);
+        }
+        glBindBuffer(GL_ARRAY_BUFFER, retainedVBO);
+        glBufferData(GL_ARRAY_BUFFER, retainedVertices.size() * sizeof(dd::DrawVertex), retainedVertices.data(), GL_STATIC_DRAW);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        checkGLError(__FILE__, __LINE__);
+    }
+
+    // Same state as drawLineList, with binding 0 on the static buffer: nothing is copied per frame
+    void drawRetained(unsigned firstRange, unsigned rangeCount)
+    {
+        if (rangeCount == 0)
+        {
+            return;
+        }
+
+        GLState::BindVertexArray(linePointVAO);
+        GLState::UseProgram(linePointProgram);
+
+        glUniformMatrix4fv(linePointProgram_MvpMatrixLocation,
+                           1, GL_TRUE, reinterpret_cast<const float*>(&mvpMatrix));
+
+        bool already = GLState::IsEnabled(GL_DEPTH_TEST);
+        glBindVertexBuffer(0, retainedVBO, 0, sizeof(dd::DrawVertex));
+
+        for (unsigned i = firstRange; i < firstRange + rangeCount; ++i)
+        {
+            const RetainedRange & range = retainedRanges[i];
+            GLState::SetEnabled(GL_DEPTH_TEST, range.depthEnabled);
+            glDrawArrays(range.mode, range.first, range.count);
+        }
+        checkGLError(__FILE__, __LINE__);
+
+        GLState::SetEnabled(GL_DEPTH_TEST, already);
     }
 
     void setupShaderPrograms()
@@ -332,40 +395,42 @@ public:
             glGenBuffers(1, &linePointVBO);
             checkGLError(__FILE__, __LINE__);
 
-            glBindVertexArray(linePointVAO);
+            GLState::BindVertexArray(linePointVAO);
             glBindBuffer(GL_ARRAY_BUFFER, linePointVBO);
 
             // RenderInterface will never be called with a batch larger than
             // DEBUG_DRAW_VERTEX_BUFFER_SIZE vertexes, so we can allocate the same amount here.
+            // Batches normally come from the streaming ring, this buffer only takes the overflow.
             glBufferData(GL_ARRAY_BUFFER, DEBUG_DRAW_VERTEX_BUFFER_SIZE * sizeof(dd::DrawVertex), nullptr, GL_STREAM_DRAW);
             checkGLError(__FILE__, __LINE__);
 
-            // Set the vertex format expected by 3D points and lines:
+            // Set the vertex format expected by 3D points and lines. The format is
+            // separate from the buffer so every batch can rebind binding 0 at its own offset:
             std::size_t offset = 0;
 
             glEnableVertexAttribArray(0); // in_Position (vec3)
-            glVertexAttribPointer(
+            glVertexAttribFormat(
                 /* index     = */ 0,
                 /* size      = */ 3,
                 /* type      = */ GL_FLOAT,
                 /* normalize = */ GL_FALSE,
-                /* stride    = */ sizeof(dd::DrawVertex),
-                /* offset    = */ reinterpret_cast<void *>(offset));
+                /* offset    = */ static_cast<GLuint>(offset));
+            glVertexAttribBinding(0, 0);
             offset += sizeof(float) * 3;
 
             glEnableVertexAttribArray(1); // in_ColorPointSize (vec4)
-            glVertexAttribPointer(
+            glVertexAttribFormat(
                 /* index     = */ 1,
                 /* size      = */ 4,
                 /* type      = */ GL_FLOAT,
                 /* normalize = */ GL_FALSE,
-                /* stride    = */ sizeof(dd::DrawVertex),
-                /* offset    = */ reinterpret_cast<void *>(offset));
+                /* offset    = */ static_cast<GLuint>(offset));
+            glVertexAttribBinding(1, 0);
 
             checkGLError(__FILE__, __LINE__);
 
             // VAOs can be a pain in the neck if left enabled...
-            glBindVertexArray(0);
+            GLState::BindVertexArray(0);
             glBindBuffer(GL_ARRAY_BUFFER, 0);
         }
 
@@ -377,7 +442,7 @@ public:
             glGenBuffers(1, &textVBO);
             checkGLError(__FILE__, __LINE__);
 
-            glBindVertexArray(textVAO);
+            GLState::BindVertexArray(textVAO);
             glBindBuffer(GL_ARRAY_BUFFER, textVBO);
 
             // NOTE: A more optimized implementation might consider combining
@@ -389,42 +454,86 @@ public:
             std::size_t offset = 0;
 
             glEnableVertexAttribArray(0); // in_Position (vec2)
-            glVertexAttribPointer(
+            glVertexAttribFormat(
                 /* index     = */ 0,
                 /* size      = */ 2,
                 /* type      = */ GL_FLOAT,
                 /* normalize = */ GL_FALSE,
-                /* stride    = */ sizeof(dd::DrawVertex),
-                /* offset    = */ reinterpret_cast<void *>(offset));
+                /* offset    = */ static_cast<GLuint>(offset));
+            glVertexAttribBinding(0, 0);
             offset += sizeof(float) * 2;
 
             glEnableVertexAttribArray(1); // in_TexCoords (vec2)
-            glVertexAttribPointer(
+            glVertexAttribFormat(
                 /* index     = */ 1,
                 /* size      = */ 2,
                 /* type      = */ GL_FLOAT,
                 /* normalize = */ GL_FALSE,
-                /* stride    = */ sizeof(dd::DrawVertex),
-                /* offset    = */ reinterpret_cast<void *>(offset));
+                /* offset    = */ static_cast<GLuint>(offset));
+            glVertexAttribBinding(1, 0);
             offset += sizeof(float) * 2;
 
             glEnableVertexAttribArray(2); // in_Color (vec4)
-            glVertexAttribPointer(
+            glVertexAttribFormat(
                 /* index     = */ 2,
                 /* size      = */ 4,
                 /* type      = */ GL_FLOAT,
                 /* normalize = */ GL_FALSE,
-                /* stride    = */ sizeof(dd::DrawVertex),
-                /* offset    = */ reinterpret_cast<void *>(offset));
+                /* offset    = */ static_cast<GLuint>(offset));
+            glVertexAttribBinding(2, 0);
 
             checkGLError(__FILE__, __LINE__);
 
             // Ditto.
-            glBindVertexArray(0);
+            GLState::BindVertexArray(0);
             glBindBuffer(GL_ARRAY_BUFFER, 0);
         }
     }
 
+    // Batches that follow each other with the same primitive and depth test become one range,
+    // so a shape like the grid is a single draw however dd splits it
+    void capture(const dd::DrawVertex * vertexes, int count, GLenum mode, bool depthEnabled)
+    {
+        const GLint first = static_cast<GLint>(retainedVertices.size());
+        retainedVertices.insert(retainedVertices.end(), vertexes, vertexes + count);
+
+        if (!retainedRanges.empty())
+        {
+            RetainedRange & last = retainedRanges.back();
+            if (last.mode == mode && last.depthEnabled == depthEnabled && last.first + last.count == first)
+            {
+                last.count += count;
+                return;
+            }
+        }
+        RetainedRange range = { mode, depthEnabled, first, count };
+        retainedRanges.push_back(range);
+    }
+
+    // Copies a batch into the streaming ring and points binding 0 of the bound VAO at it.
+    // Nothing is overwritten while the GPU may still read it, so there is no implicit sync.
+    // A frame that outgrows the ring falls back to the VAO's own buffer.
+    void bindVertexes(const dd::DrawVertex * vertexes, int count, GLuint fallbackVBO)
+    {
+        const std::size_t size = count * sizeof(dd::DrawVertex);
+        std::size_t offset = StreamingBuffer::INVALID_OFFSET;
+        if (stream != nullptr)
+        {
+            offset = stream->Write(vertexes, size, sizeof(float));
+        }
+
+        if (offset != StreamingBuffer::INVALID_OFFSET)
+        {
+            glBindVertexBuffer(0, stream->GetBuffer(), offset, sizeof(dd::DrawVertex));
+        }
+        else
+        {
+            glBindBuffer(GL_ARRAY_BUFFER, fallbackVBO);
+            glBufferSubData(GL_ARRAY_BUFFER, 0, size, vertexes);
+            glBindVertexBuffer(0, fallbackVBO, 0, sizeof(dd::DrawVertex));
+        }
+    }
+
     static GLuint handleToGL(dd::GlyphTextureHandle handle)
     {
         const std::size_t temp = reinterpret_cast<std::size_t>(handle);
@@ -500,6 +609,21 @@ private:
     GLuint textVAO;
     GLuint textVBO;
 
+    struct RetainedRange
+    {
+        GLenum  mode;
+        bool    depthEnabled;
+        GLint   first;
+        GLsizei count;
+    };
+
+    GLuint retainedVBO;
+    std::vector<dd::DrawVertex> retainedVertices;
+    std::vector<RetainedRange> retainedRanges;
+    bool capturing;
+
+    StreamingBuffer * stream;
+
     static const char * linePointVertShaderSrc;
     static const char * linePointFragShaderSrc;
 
@@ -592,6 +716,11 @@ bool ModuleDebugDraw::Init()
 {
     implementation = new DDRenderInterfaceCoreGL;
     dd::initialize(implementation);
+
+    grid = CreateRetained([]() {
+        dd::axisTriad(float4x4::identity, 0.1f, 1.0f);
+        dd::xzSquareGrid(-10, 10, 0.0f, 1.0f, dd::colors::Gray);
+    });
     return true;
 }
 
@@ -599,6 +728,8 @@ bool ModuleDebugDraw::Init()
 bool ModuleDebugDraw::CleanUp()
 {
     dd::shutdown();
+    retained.clear();
+    grid = -1;
 
     delete implementation;
     implementation = 0;
@@ -617,7 +748,23 @@ void ModuleDebugDraw::Draw(const float4x4& view, const float4x4& proj, unsigned
     implementation->height    = height;
     implementation->mvpMatrix = proj * view;
 
+    for (const RetainedShape& shape : retained)
+    {
+        if (shape.visible)
+        {
+            implementation->drawRetained(shape.firstRange, shape.rangeCount);
+        }
+    }
     dd::flush();
 }
 
+// The dd queue is empty here: it is only filled and flushed inside Draw, on the render thread
+int ModuleDebugDraw::CreateRetained(const std::function<void()>& shapes)
+{
+    RetainedShape shape;
+    implementation->captureRetained(shapes, shape.firstRange, shape.rangeCount);
+    retained.push_back(shape);
+    return static_cast<int>(retained.size()) - 1;
+}
+
 
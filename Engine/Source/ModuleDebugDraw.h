@@ -4,6 +4,8 @@
 #include "Module.h"
 
 #include "Math/float4x4.h"
+#include <vector>
+#include <functional>
 
 class DDRenderInterfaceCoreGL;
 class Camera;
@@ -21,8 +23,26 @@ public:
 	bool            CleanUp();
 
     void            Draw(const float4x4& view, const float4x4& proj, unsigned width, unsigned height);
+
+    // Retained shapes: whatever the callback emits through dd is built once into a static buffer
+    // and drawn by every Draw, before the transient shapes. Context current, like any GL call.
+    int             CreateRetained(const std::function<void()>& shapes);
+    //Render thread, like Draw
+    inline void     SetRetainedVisible(int shape, bool visible) { retained[shape].visible = visible; }
+    inline int      GetGrid() const { return grid; }
+
 private:
 
+    struct RetainedShape
+    {
+        unsigned firstRange = 0;
+        unsigned rangeCount = 0;
+        bool visible = true;
+    };
+
+    std::vector<RetainedShape> retained;
+    int grid = -1; //Axis triad and XZ grid at the origin
+
     static DDRenderInterfaceCoreGL* implementation;
 };
 
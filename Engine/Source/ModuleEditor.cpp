@@ -1,5 +1,5 @@
-#include ".\backends\imgui_impl_sdl2.h"
-#include ".\backends\imgui_impl_opengl3.h"
+#include "backends/imgui_impl_sdl2.h"
+#include "backends/imgui_impl_opengl3.h"
 #include "ModuleEditor.h"
 #include "Globals.h"
 #include "Application.h"
@@ -7,13 +7,31 @@
 #include "ModuleOpenGL.h"
 #include "ModuleCamera.h"
 #include "ModuleRenderExercise.h"
+#ifndef ENGINE_NO_DIRECTXTEX
 #include "DirectXTex/DirectXTex.h"
+#endif
 #include "SDL.h"
 #include "Model.h"
-#include <.\GL\glew.h>
+#include <GL/glew.h>
 #include "imgui.h"
 #include "MathGeoLib.h"
 #include "Mesh.h"
+#include "ShaderProgram.h"
+#include "ProgramCache.h"
+#include "ShaderWatcher.h"
+#include "ShaderPermutations.h"
+#include "RenderQueue.h"
+#include "FrustumCuller.h"
+#include "OcclusionCuller.h"
+#include "OcclusionQueries.h"
+#include "StreamingBuffer.h"
+#include "RenderThread.h"
+#include "GLState.h"
+#include "LightClusters.h"
+#include "DynamicResolution.h"
+#include "FrameLimiter.h"
+#include "SoftwareRasterizer.h"
+#include "FrameProfiler.h"
 
 
 
@@ -23,12 +41,72 @@
 #define TINYGLTF_IMPLEMENTATION
 #include "tiny_gltf.h"
 
+//Deep copy, the lists ImGui hands out are overwritten by the next frame
+static void CopyDrawData(const ImDrawData* source, ImDrawData& copy) {
+	for (ImDrawList* list : copy.CmdLists) {
+		IM_DELETE(list);
+	}
+	copy.Clear();
+	copy.Valid = source->Valid;
+	copy.CmdListsCount = source->CmdListsCount;
+	copy.TotalIdxCount = source->TotalIdxCount;
+	copy.TotalVtxCount = source->TotalVtxCount;
+	copy.DisplayPos = source->DisplayPos;
+	copy.DisplaySize = source->DisplaySize;
+	copy.FramebufferScale = source->FramebufferScale;
+	copy.OwnerViewport = source->OwnerViewport;
+	for (const ImDrawList* list : source->CmdLists) {
+		copy.CmdLists.push_back(list->CloneOutput());
+	}
+}
+
+//One row per nesting level. Zones are placed by their start in the frame, frameMs spans the full width.
+static void DrawTimeline(const char* id, const std::vector<ProfilerZone>& zones, float frameMs) {
+	int rows = 1;
+	for (const ProfilerZone& zone : zones) {
+		rows = Max(rows, zone.depth + 1);
+	}
+	const float rowHeight = ImGui::GetTextLineHeightWithSpacing();
+	const float width = Max(ImGui::GetContentRegionAvail().x, 100.0f);
+	const ImVec2 origin = ImGui::GetCursorScreenPos();
+	ImGui::InvisibleButton(id, ImVec2(width, rowHeight * rows));
+	const bool hovered = ImGui::IsItemHovered();
+	const ImVec2 mouse = ImGui::GetIO().MousePos;
+
+	ImDrawList* drawList = ImGui::GetWindowDrawList();
+	drawList->AddRectFilled(origin, ImVec2(origin.x + width, origin.y + rowHeight * rows), IM_COL32(30, 30, 30, 255));
+	for (const ProfilerZone& zone : zones) {
+		ImVec2 min(origin.x + zone.startMs / frameMs * width, origin.y + zone.depth * rowHeight);
+		ImVec2 max(Max(min.x + 1.0f, origin.x + (zone.startMs + zone.ms) / frameMs * width), min.y + rowHeight - 1.0f);
+		//Coloured from the name, so a pass keeps its colour from frame to frame
+		unsigned hash = 2166136261u;
+		for (const char* c = zone.name; *c != '\0'; ++c) {
+			hash = (hash ^ (unsigned char)*c) * 16777619u;
+		}
+		drawList->AddRectFilled(min, max, IM_COL32(96 + (hash & 0x7F), 96 + ((hash >> 8) & 0x7F), 96 + ((hash >> 16) & 0x7F), 255));
+		drawList->PushClipRect(min, max, true);
+		drawList->AddText(ImVec2(min.x + 2.0f, min.y), IM_COL32_BLACK, zone.name);
+		drawList->PopClipRect();
+		if (hovered && mouse.x >= min.x && mouse.x < max.x && mouse.y >= min.y && mouse.y < max.y) {
+			ImGui::SetTooltip("%s\n%.3f ms, from %.3f ms", zone.name, zone.ms, zone.startMs);
+		}
+	}
+}
+
 ModuleEditor::ModuleEditor() {
 	logs = new ImGuiTextBuffer;
+	drawFrames[0] = new ImDrawData();
+	drawFrames[1] = new ImDrawData();
 
 }
 ModuleEditor::~ModuleEditor() {
 	delete logs;
+	for (ImDrawData* drawData : drawFrames) {
+		for (ImDrawList* list : drawData->CmdLists) {
+			IM_DELETE(list);
+		}
+		delete drawData;
+	}
 }
 
 bool ModuleEditor::Init()
@@ -45,6 +123,8 @@ bool ModuleEditor::Init()
 
 	ImGui_ImplSDL2_InitForOpenGL(App->GetWindow()->window, App->GetOpenGL()->context);
 	ImGui_ImplOpenGL3_Init("#version 460");
+	//Normally created by the first NewFrame, which now runs on the render thread after ImGui::NewFrame needs the font atlas
+	ImGui_ImplOpenGL3_CreateDeviceObjects();
 
 
 	width = App->GetWindow()->GetScreenSize().x;
@@ -59,7 +139,16 @@ bool ModuleEditor::Init()
 }
 
 update_status ModuleEditor::Update() {
-	ImGui_ImplOpenGL3_NewFrame();
+	FrameProfiler* profiler = App->GetOpenGL()->GetProfiler();
+	profiler->BeginCpu("ImGui");
+	{
+		std::lock_guard<std::mutex> lock(logMutex);
+		if (!pendingLogs.empty()) {
+			logs->append(pendingLogs.c_str(), pendingLogs.c_str() + pendingLogs.size());
+			pendingLogs.clear();
+		}
+	}
+
 	ImGui_ImplSDL2_NewFrame(App->GetWindow()->window);
 	ImGui::NewFrame();
 
@@ -146,6 +235,48 @@ update_status ModuleEditor::Update() {
 
 					sprintf_s(title, 25, "Milliseconds %.1f", App->GetMilliseconds()->at(App->GetMilliseconds()->size() - 1));
 					ImGui::PlotHistogram("##Milliseconds", &(App->GetMilliseconds()->at(0)), App->GetMilliseconds()->size(), 0, title, 0.0f, 40.0f, ImVec2(310.0f, 100.0f));
+
+					sprintf_s(title, 25, "Work ms %.1f", App->GetWorkMilliseconds()->at(App->GetWorkMilliseconds()->size() - 1));
+					ImGui::PlotHistogram("##WorkMilliseconds", &(App->GetWorkMilliseconds()->at(0)), App->GetWorkMilliseconds()->size(), 0, title, 0.0f, 40.0f, ImVec2(310.0f, 100.0f));
+
+					//Pacing stats over the history, empty slots are skipped until it fills
+					const std::vector<float>& intervals = *App->GetMilliseconds();
+					const std::vector<float>& work = *App->GetWorkMilliseconds();
+					float intervalSum = 0.0f, workSum = 0.0f;
+					int samples = 0;
+					for (int i = 0; i < intervals.size(); i++) {
+						if (intervals[i] > 0.0f) {
+							intervalSum += intervals[i];
+							workSum += work[i];
+							samples++;
+						}
+					}
+					if (samples > 0) {
+						float mean = intervalSum / samples;
+						float variance = 0.0f;
+						float worst = 0.0f;
+						for (int i = 0; i < intervals.size(); i++) {
+							if (intervals[i] > 0.0f) {
+								variance += (intervals[i] - mean) * (intervals[i] - mean);
+								worst = Max(worst, intervals[i]);
+							}
+						}
+						ImGui::Text("Interval: %.2f ms mean, %.2f ms jitter, %.2f ms worst", mean, sqrtf(variance / samples), worst);
+						ImGui::Text("CPU busy: %.1f%%", 100.0f * workSum / intervalSum);
+					}
+
+					ImGui::Separator();
+					ModuleOpenGL* render = App->GetOpenGL();
+					int vsync = render->GetSwapInterval() == -1 ? 2 : render->GetSwapInterval();
+					if (ImGui::Combo("Vsync", &vsync, "Off\0On\0Adaptive\0")) {
+						render->SetSwapInterval(vsync == 2 ? -1 : vsync);
+					}
+					FrameLimiter* limiter = App->GetFrameLimiter();
+					ImGui::SliderInt("Max FPS", &limiter->maxFps, 0, 240, limiter->maxFps == 0 ? "Unlimited" : "%d");
+					ImGui::Checkbox("Low latency", &limiter->lowLatency);
+					if (ImGui::IsItemHovered()) {
+						ImGui::SetTooltip("Waits before polling input instead of after presenting,\nneeds a frame rate cap");
+					}
 				}
 
 				if (ImGui::CollapsingHeader("Window"))
@@ -192,6 +323,144 @@ update_status ModuleEditor::Update() {
 						App->GetCamera()->SetMouseSensitivity(panSensitivity);
 					}
 				}
+				if (ImGui::CollapsingHeader("Profiler")) {
+					FrameProfiler* profiler = App->GetOpenGL()->GetProfiler();
+					ImGui::Checkbox("GPU timer queries", &profiler->enabled);
+					std::vector<ProfilerZone> gpuZones;
+					float gpuFrameMs = 0.0f;
+					profiler->GetGpuZones(gpuZones, gpuFrameMs);
+					//Both timelines share a scale, at least a 60 Hz frame
+					const float timelineMs = Max(Max(profiler->GetCpuFrameMs(), gpuFrameMs), 1000.0f / 60.0f);
+					ImGui::Text("CPU, main thread: %.3f ms", profiler->GetCpuFrameMs());
+					DrawTimeline("##CpuTimeline", profiler->GetCpuZones(), timelineMs);
+					ImGui::Text("GPU: %.3f ms, read back %u frames late, %u frames dropped", gpuFrameMs, profiler->GetGpuLatency(), profiler->GetDroppedFrames());
+					DrawTimeline("##GpuTimeline", gpuZones, timelineMs);
+					if (ImGui::TreeNode("Zones")) {
+						for (const ProfilerZone& zone : profiler->GetCpuZones()) {
+							ImGui::Text("CPU %*s%s: %.3f ms", zone.depth * 2, "", zone.name, zone.ms);
+						}
+						for (const ProfilerZone& zone : gpuZones) {
+							ImGui::Text("GPU %*s%s: %.3f ms", zone.depth * 2, "", zone.name, zone.ms);
+						}
+						ImGui::TreePop();
+					}
+				}
+				if (ImGui::CollapsingHeader("Renderer")) {
+					const ShaderProgram* program = App->GetModuleRenderExercise()->GetProgram();
+					if (program != nullptr) {
+						ImGui::Text("Active uniforms: %i", program->GetUniformCount());
+						ImGui::SameLine();
+						ImGui::Text("Uniform blocks: %i", program->GetUniformBlockCount());
+					}
+					ImGui::Text("GL uniform lookups last frame: %u", ShaderProgram::GetLookupCount());
+					ImGui::Text("Program cache: %u hits, %u misses, %u rejected, %.2f ms loading programs", ProgramCache::GetHitCount(),
+						ProgramCache::GetMissCount(), ProgramCache::GetRejectedCount(), ShaderProgram::GetLoadMs());
+					const ShaderWatcher* watcher = App->GetModuleRenderExercise()->GetShaderWatcher();
+					ImGui::Text("Hot reload (%s): %u reloaded, %u failed, %u compiling", watcher->IsParallel() ? "parallel compile" : "serial compile",
+						watcher->GetReloadCount(), watcher->GetFailedCount(), watcher->GetPendingCount());
+					const ShaderPermutations* permutations = App->GetModuleRenderExercise()->GetPermutations();
+					ImGui::Text("Shader permutations: %u built, %u reachable, %u possible", permutations->GetBuiltCount(),
+						ShaderPermutations::GetReachableCount(), SHADER_PERMUTATION_COUNT);
+					for (unsigned features = 0; features < SHADER_PERMUTATION_COUNT; ++features) {
+						if (permutations->GetProgram(features) != nullptr) {
+							ImGui::BulletText("%s: %u draws", ShaderPermutations::GetName(features).c_str(), permutations->GetDrawCount(features));
+						}
+					}
+					const RenderQueue* queue = App->GetModuleRenderExercise()->GetRenderQueue();
+					ImGui::Text("Draw packets: %u", (unsigned)queue->GetPacketCount());
+					ImGui::Text("State changes, unconditional binds: %u", queue->GetUnconditionalStateChanges());
+					ImGui::Text("State changes, file order: %u", queue->GetUnsortedStateChanges());
+					ImGui::Text("State changes, sorted: %u", queue->GetStateChanges());
+					ImGui::Text("GL state calls last frame: %u issued, %u filtered as redundant", GLState::GetIssuedCount(), GLState::GetFilteredCount());
+					ImGui::Text("Instances: %u in %u draws, %u multi-draw calls", queue->GetInstanceCount(), (unsigned)queue->GetPacketCount(), queue->GetMultiDrawCount());
+					const RenderThread* renderThread = App->GetOpenGL()->GetRenderThread();
+					ImGui::Checkbox("Render thread", &App->GetOpenGL()->threadedRendering);
+					ImGui::Text("%u commands, replay %.2f ms, main thread waited %.2f ms", (unsigned)renderThread->GetCommandCount(),
+						renderThread->GetReplayMs(), renderThread->GetWaitMs());
+					const StreamingBuffer* stream = App->GetOpenGL()->GetStreamingBuffer();
+					ImGui::Text("Streaming ring: %u / %u KB this frame, %u stalls, %u overflows", (unsigned)(stream->GetFrameUsed() / 1024),
+						(unsigned)(stream->GetFrameSize() / 1024), stream->GetStallCount(), stream->GetOverflowCount());
+					const FrustumCuller* culler = App->GetModuleRenderExercise()->GetModel()->GetCuller();
+					ImGui::Checkbox("Frustum culling", &App->GetModuleRenderExercise()->frustumCulling);
+					ImGui::Text("Instances visible: %u, culled: %u", culler->GetVisibleCount(), culler->GetCulledCount());
+					static double scalarMs = 0.0, simdMs = 0.0;
+					if (ImGui::Button("Benchmark culling (100k boxes)")) {
+						FrustumCuller::Benchmark(100000, scalarMs, simdMs);
+					}
+					ImGui::SameLine();
+					ImGui::Text("Scalar: %.3f ms SIMD: %.3f ms", scalarMs, simdMs);
+					const Model* model = App->GetModuleRenderExercise()->GetModel();
+					const OcclusionCuller* occlusion = model->GetOcclusionCuller();
+					ImGui::Checkbox("Software occlusion culling", &App->GetModuleRenderExercise()->occlusionCulling);
+					ImGui::Text("Occluded: %u, occluder triangles: %u (%u on screen), raster %.3f ms", model->GetOccludedCount(),
+						occlusion->GetOccluderTriangleCount(), occlusion->GetRasterizedTriangleCount(), occlusion->GetRenderMs());
+					static double occlusionRenderMs = 0.0, occlusionTestMs = 0.0;
+					static unsigned benchmarkOccluded = 0;
+					if (ImGui::Button("Benchmark occlusion (1k occluders, 100k boxes)")) {
+						OcclusionCuller::Benchmark(1000, 100000, occlusionRenderMs, occlusionTestMs, benchmarkOccluded);
+					}
+					ImGui::Text("Raster: %.3f ms Test: %.3f ms Occluded: %u", occlusionRenderMs, occlusionTestMs, benchmarkOccluded);
+					const OcclusionQueries* queries = App->GetModuleRenderExercise()->GetOcclusionQueries();
+					ImGui::Checkbox("Hardware occlusion queries", &App->GetModuleRenderExercise()->hardwareOcclusion);
+					ImGui::Text("Draws skipped: %u of %u queried", queries->GetSkippedDraws(), queries->GetQueriedDraws());
+					ImGui::Separator();
+					ModuleRenderExercise* renderExercise = App->GetModuleRenderExercise();
+					ImGui::Checkbox("Depth pre-pass", &renderExercise->depthPrepass);
+					ImGui::Checkbox("Show grid", &renderExercise->showGrid);
+					ImGui::Text("Pre-pass: %.3f ms Main pass: %.3f ms", renderExercise->GetDepthPrepassMs(), renderExercise->GetMainPassMs());
+					ImGui::Text("Fragment shader invocations: %llu", renderExercise->GetFragmentInvocations());
+					DynamicResolution* resolution = renderExercise->GetDynamicResolution();
+					ImGui::Checkbox("Dynamic resolution", &resolution->enabled);
+					ImGui::SliderFloat("Target frame ms", &resolution->targetMs, 4.0f, 50.0f);
+					ImGui::SliderFloat("Min scale", &resolution->minScale, 0.25f, 1.0f);
+					ImGui::SliderFloat("Max scale", &resolution->maxScale, resolution->minScale, 2.0f);
+					ImGui::Text("Scale %.2f, rendering %.0fx%.0f, measured %.2f ms", resolution->GetScale(),
+						renderExercise->GetRenderSize().x, renderExercise->GetRenderSize().y, resolution->GetMeasuredMs());
+					int stressCopies = App->GetModuleRenderExercise()->GetModel()->GetStressCopies();
+					if (ImGui::SliderInt("Stress copies", &stressCopies, 1, 4096)) {
+						App->GetModuleRenderExercise()->SetStressCopies(stressCopies);
+					}
+					ImGui::Checkbox("Static batching (applies to the next loaded model)", &renderExercise->staticBatching);
+					const StaticBatchStats& batchStats = renderExercise->GetModel()->GetBatchStats();
+					if (batchStats.batches > 0) {
+						ImGui::Text("%u primitives, %u parts merged into %u batches", batchStats.primitives, batchStats.parts, batchStats.batches);
+						ImGui::Text("Geometry: %.1f KB batched, %.1f KB instanced (%+.1f KB)", batchStats.batchedBytes / 1024.0f, batchStats.sourceBytes / 1024.0f,
+							((float)batchStats.batchedBytes - (float)batchStats.sourceBytes) / 1024.0f);
+						ImGui::Text("Visible parts: %u drawn in %u draws", batchStats.visibleParts, batchStats.draws);
+					}
+					ImGui::Separator();
+					ModuleRenderExercise* renderer = App->GetModuleRenderExercise();
+					ImGui::ColorEdit3("Light Color", renderer->lightColor.ptr());
+					ImGui::InputFloat3("Light Direction", renderer->lightDirection.ptr());
+					ImGui::ColorEdit3("Ambient Color", renderer->ambientColor.ptr());
+					ImGui::Separator();
+					int lightCount = renderer->GetLightCount();
+					if (ImGui::SliderInt("Clustered lights", &lightCount, 0, 4096)) {
+						renderer->SetLightCount(lightCount);
+					}
+					ImGui::Checkbox("Animate lights", &renderer->animateLights);
+					ImGui::Text("Binning %.3f ms, %u light references, up to %u per cluster (%ix%ix%i clusters)", renderer->GetLightBinMs(),
+						renderer->GetLightIndexCount(), renderer->GetMaxLightsPerCluster(), CLUSTER_X, CLUSTER_Y, CLUSTER_Z);
+					static double binMs[4] = {};
+					static const unsigned benchmarkCounts[4] = { 256, 1024, 4096, 16384 };
+					if (ImGui::Button("Benchmark light binning")) {
+						for (int i = 0; i < 4; ++i) {
+							binMs[i] = LightClusters::Benchmark(benchmarkCounts[i]);
+						}
+					}
+					for (int i = 0; i < 4; ++i) {
+						ImGui::Text("%u lights: %.3f ms", benchmarkCounts[i], binMs[i]);
+					}
+					ImGui::Separator();
+					ImGui::Combo("Backend", &renderer->renderBackend, "OpenGL\0Software\0Side by side (GL | software)\0");
+					if (renderer->renderBackend != RENDER_BACKEND_GL) {
+						const SoftwareRasterizer* software = renderer->GetSoftwareRasterizer();
+						ImGui::Text("Software: %u threads, %u triangles, %u tile references", software->GetThreadCount(),
+							software->GetTriangleCount(), software->GetBinnedCount());
+						ImGui::Text("Setup %.3f ms, raster %.3f ms, total %.3f ms (GL main pass %.3f ms)", software->GetSetupMs(),
+							software->GetRasterMs(), software->GetTotalMs(), renderer->GetMainPassMs());
+					}
+				}
 
 
 				ImGui::TreePop();
@@ -218,16 +487,24 @@ update_status ModuleEditor::Update() {
 			if (ImGui::TreeNode("Textures"))
 			{
 
-				const tinygltf::Model* model = App->GetModuleRenderExercise()->GetModel()->GetSrcModel();
-				std::vector<tinygltf::Image> images = model->images;
-				std::vector<DirectX::ScratchImage*> scrImages = App->GetModuleRenderExercise()->GetModel()->GetScrImages();
+				const std::vector<std::string>* names = App->GetModuleRenderExercise()->GetModel()->GetScrImageNames();
+				std::vector<TextureImage*> scrImages = App->GetModuleRenderExercise()->GetModel()->GetScrImages();
 
-				for (int i = 0; i < images.size(); i++) {
+				ImGui::Text("Materials: %i", App->GetModuleRenderExercise()->GetModel()->GetMaterials()->size());
+				for (int i = 0; i < scrImages.size(); i++) {
 					ImGui::Separator();
-					ImGui::Text("File name: %s", images[i].name.c_str());
+					ImGui::Text("Texture: %s", names->at(i).c_str());
+#ifndef ENGINE_NO_DIRECTXTEX
 					ImGui::Text("Width: %i", scrImages[i]->GetMetadata().width);
 					ImGui::SameLine();
 					ImGui::Text("Height: %i", scrImages[i]->GetMetadata().height);
+					ImGui::Text("Compressed: %s", DirectX::IsCompressed(scrImages[i]->GetMetadata().format) ? "Yes" : "No");
+#else
+					ImGui::Text("Width: %u", scrImages[i]->width);
+					ImGui::SameLine();
+					ImGui::Text("Height: %u", scrImages[i]->height);
+					ImGui::Text("Compressed: No");
+#endif
 				}
 
 
@@ -243,25 +520,28 @@ update_status ModuleEditor::Update() {
 			SDL_version version;
 			SDL_VERSION(&version);
 
-			GLfloat total_vram, available_vram, usage;
-			glGetFloatv(GL_GPU_MEMORY_INFO_TOTAL_AVAILABLE_MEMORY_NVX, &total_vram);
-			glGetFloatv(GL_GPU_MEMORY_INFO_CURRENT_AVAILABLE_VIDMEM_NVX, &available_vram);
+			const ModuleOpenGL* gl = App->GetOpenGL();
+			GLfloat total_vram = gl->GetTotalVideoMemory(), available_vram = gl->GetAvailableVideoMemory(), usage;
 
 
 			usage = (total_vram - available_vram) / total_vram;
 
 			ImGui::Text("SDL Version: %u.%u.%u", version.major, version.minor, version.patch);
-			ImGui::Text("OpenGL Supported Version: %s", glGetString(GL_VERSION));
+			ImGui::Text("OpenGL Supported Version: %s", gl->GetVersion().c_str());
 			ImGui::Text("Glew Version: %s", glewGetString(GLEW_VERSION));
-			ImGui::Text("GLSL Version: %s", glGetString(GL_SHADING_LANGUAGE_VERSION));
+			ImGui::Text("GLSL Version: %s", gl->GetShadingLanguageVersion().c_str());
+#ifndef ENGINE_NO_DIRECTXTEX
 			ImGui::Text("DirectXTex Version: %u", DIRECTX_TEX_VERSION);
+#else
+			ImGui::Text("stb_image Version: 2.28");
+#endif
 			ImGui::Text("ImGui Version: %s", ImGui::GetVersion());
 			ImGui::Separator();
 			ImGui::Text("CPUs: %i (Cache: %.1fkb)", SDL_GetCPUCount(), SDL_GetCPUCacheLineSize());
 			ImGui::Text("System RAM: %.1fGB ", SDL_GetSystemRAM());
 			ImGui::Separator();
-			ImGui::Text("GPU Vendor: %s", glGetString(GL_VENDOR));
-			ImGui::Text("GPU Brand: %s", glGetString(GL_RENDERER));
+			ImGui::Text("GPU Vendor: %s", gl->GetVendor().c_str());
+			ImGui::Text("GPU Brand: %s", gl->GetRenderer().c_str());
 			ImGui::Text("VRAM Budget: %.1fMB", (total_vram / 1024.0f));
 			ImGui::Text("VRAM Usage: %.2f%%", usage * 100.0f);
 			ImGui::Text("VRAM Available: %.2fMB", available_vram / 1024);
@@ -299,9 +579,18 @@ update_status ModuleEditor::Update() {
 
 
 	ImGui::Render();
-	ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
-
-	if (io->ConfigFlags & ImGuiConfigFlags_ViewportsEnable)
+	ImDrawData* drawData = drawFrames[drawFrame];
+	drawFrame = 1 - drawFrame;
+	CopyDrawData(ImGui::GetDrawData(), *drawData);
+	App->GetOpenGL()->GetRenderThread()->Record([drawData, profiler]() {
+		profiler->BeginGpu("ImGui");
+		ImGui_ImplOpenGL3_NewFrame();
+		ImGui_ImplOpenGL3_RenderDrawData(drawData);
+		profiler->EndGpu();
+	});
+
+	//Platform windows create and switch contexts, only possible while this thread owns GL
+	if ((io->ConfigFlags & ImGuiConfigFlags_ViewportsEnable) && !App->GetOpenGL()->GetRenderThread()->IsRunning())
 	{
 		SDL_Window* backup_current_window = SDL_GL_GetCurrentWindow();
 		SDL_GLContext backup_current_context = SDL_GL_GetCurrentContext();
@@ -310,6 +599,7 @@ update_status ModuleEditor::Update() {
 		SDL_GL_MakeCurrent(backup_current_window, backup_current_context);
 	}
 
+	profiler->EndCpu();
 
 	return UPDATE_CONTINUE;
 
@@ -317,7 +607,8 @@ update_status ModuleEditor::Update() {
 
 
 void ModuleEditor::AddLog(char str[]) {
-	logs->appendf(str);
+	std::lock_guard<std::mutex> lock(logMutex);
+	pendingLogs += str;
 }
 
 bool ModuleEditor::CleanUp() {
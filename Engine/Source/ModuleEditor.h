@@ -2,8 +2,11 @@
 #include "Module.h"
 #include "Globals.h"
 #include "Math/float2.h"
+#include <string>
+#include <mutex>
 
 struct ImGuiIO;
+struct ImDrawData;
 class ImGuiTextBuffer;
 
 class ModuleEditor : public Module
@@ -35,6 +38,12 @@ class ModuleEditor : public Module
 		ImGuiIO *io = nullptr;
 		void* context = nullptr;
 		ImGuiTextBuffer* logs = nullptr;
+		//Lines logged from the render thread wait here until the next frame is built
+		std::string pendingLogs;
+		std::mutex logMutex;
+		//ImGui reuses its draw lists every NewFrame, the render thread draws from a copy
+		ImDrawData* drawFrames[2] = { nullptr, nullptr };
+		int drawFrame = 0;
 	
 
 };
@@ -0,0 +1,276 @@
+#include "Globals.h"
+#include "Application.h"
+#include "ModuleHeadless.h"
+#include "ModuleOpenGL.h"
+#include "ModuleCamera.h"
+#include "ModuleRenderExercise.h"
+#include "RenderThread.h"
+#include "FrameLimiter.h"
+#include "GLState.h"
+#include "Model.h"
+#include "FrustumCuller.h"
+#include "OcclusionCuller.h"
+#include "LightClusters.h"
+#include "SDL.h"
+#include <GL/glew.h>
+#include <Geometry/AABB.h>
+#include <Geometry/Sphere.h>
+#include "Math/MathFunc.h"
+#include <algorithm>
+#include <fstream>
+#include <cmath>
+
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include "stb_image_write.h"
+
+//Distance of the orbit from the model, in bounding sphere radii
+#define HEADLESS_ORBIT_DISTANCE 3.0f
+//The camera bobs up and down this much while orbiting, also in radii
+#define HEADLESS_ORBIT_HEIGHT 0.75f
+//Same sizes as the editor's benchmark buttons, so the numbers compare
+#define HEADLESS_BENCHMARK_BOXES 100000
+#define HEADLESS_BENCHMARK_OCCLUDERS 1000
+static const unsigned benchmarkLightCounts[] = { 256, 1024, 4096, 16384 };
+
+ModuleHeadless::ModuleHeadless(const HeadlessSettings& settings) : settings(settings) {
+
+}
+
+ModuleHeadless::~ModuleHeadless() {
+
+}
+
+bool ModuleHeadless::Init() {
+	LOG("Headless run: %s, %d frames at %ux%u", settings.modelPath.c_str(), settings.frames, settings.width, settings.height);
+
+	//Measure what the machine can do, not the display
+	App->GetOpenGL()->SetSwapInterval(0);
+	App->GetFrameLimiter()->maxFps = 0;
+
+	CreateFramebuffer();
+	App->GetOpenGL()->SetOutputFramebuffer(framebuffer);
+	App->GetCamera()->SetAspectRatio((float)settings.width / (float)settings.height);
+
+	App->GetModuleRenderExercise()->ClearModel();
+	App->GetModuleRenderExercise()->LoadModel(&settings.modelPath[0]);
+
+	frameTimes.reserve(settings.frames);
+	replayTimes.reserve(settings.frames);
+
+	if (settings.benchmark) {
+		RunBenchmarks();
+	}
+	return true;
+}
+
+//CPU only, run before the render thread starts so nothing else competes for the cores
+void ModuleHeadless::RunBenchmarks() {
+	FrustumCuller::Benchmark(HEADLESS_BENCHMARK_BOXES, cullScalarMs, cullSimdMs);
+	LOG("Headless: frustum culling %d boxes, scalar %.3f ms, SIMD %.3f ms", HEADLESS_BENCHMARK_BOXES, cullScalarMs, cullSimdMs);
+
+	OcclusionCuller::Benchmark(HEADLESS_BENCHMARK_OCCLUDERS, HEADLESS_BENCHMARK_BOXES, occlusionRenderMs, occlusionTestMs, occludedBoxes);
+	LOG("Headless: occlusion %d occluders, raster %.3f ms, test %.3f ms, %u occluded", HEADLESS_BENCHMARK_OCCLUDERS, occlusionRenderMs, occlusionTestMs, occludedBoxes);
+
+	lightBinMs.clear();
+	for (unsigned lightCount : benchmarkLightCounts) {
+		lightBinMs.push_back(LightClusters::Benchmark(lightCount));
+		LOG("Headless: binning %u lights, %.3f ms", lightCount, lightBinMs.back());
+	}
+}
+
+//One full orbit over the measured frames, so every run sees the same views
+update_status ModuleHeadless::PreUpdate() {
+	const Model* model = App->GetModuleRenderExercise()->GetModel();
+	Sphere sphere = model->GetAABB()->MinimalEnclosingSphere();
+	float3 center = sphere.Centroid();
+	float radius = sphere.r > 0.0f ? sphere.r : 1.0f;
+
+	float t = (float)std::max(frame - settings.warmupFrames, 0) / (float)settings.frames;
+	float angle = t * 2.0f * math::pi;
+	float3 position = center + float3(cosf(angle) * HEADLESS_ORBIT_DISTANCE, sinf(angle * 2.0f) * HEADLESS_ORBIT_HEIGHT, sinf(angle) * HEADLESS_ORBIT_DISTANCE) * radius;
+
+	ModuleCamera* camera = App->GetCamera();
+	camera->SetPosition(position.x, position.y, position.z);
+	camera->LookAt(center);
+	camera->SetPlaneDistances(radius * 0.01f, radius * 20.0f);
+
+	return UPDATE_CONTINUE;
+}
+
+//Runs after ModuleOpenGL has submitted the frame, the interval between two of these is one frame
+update_status ModuleHeadless::PostUpdate() {
+	Uint64 now = SDL_GetPerformanceCounter();
+	if (lastFrameCounter != 0 && frame > settings.warmupFrames) {
+		frameTimes.push_back((now - lastFrameCounter) / (float)SDL_GetPerformanceFrequency() * 1000.0f);
+		replayTimes.push_back(App->GetOpenGL()->GetRenderThread()->GetReplayMs());
+	}
+	lastFrameCounter = now;
+	frame++;
+
+	if (frame <= settings.warmupFrames + settings.frames) {
+		return UPDATE_CONTINUE;
+	}
+
+	bool written = WriteStats();
+	written = WriteImage() && written;
+	return written ? UPDATE_STOP : UPDATE_ERROR;
+}
+
+bool ModuleHeadless::CleanUp() {
+	App->GetOpenGL()->SetOutputFramebuffer(0);
+	App->GetOpenGL()->GetRenderThread()->Invoke([this]() {
+		glDeleteFramebuffers(1, &framebuffer);
+		GLState::DeleteTextures(1, &colorTexture);
+		glDeleteRenderbuffers(1, &depthBuffer);
+	});
+	framebuffer = colorTexture = depthBuffer = 0;
+	return true;
+}
+
+//Init runs before the render thread starts, the context is still current here
+void ModuleHeadless::CreateFramebuffer() {
+	glGenTextures(1, &colorTexture);
+	GLState::BindTexture(0, colorTexture);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, settings.width, settings.height, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	GLState::BindTexture(0, 0);
+
+	glGenRenderbuffers(1, &depthBuffer);
+	glBindRenderbuffer(GL_RENDERBUFFER, depthBuffer);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, settings.width, settings.height);
+	glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+	glGenFramebuffers(1, &framebuffer);
+	glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, colorTexture, 0);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, depthBuffer);
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+		LOG("Headless: framebuffer %ux%u is incomplete", settings.width, settings.height);
+	}
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	glViewport(0, 0, settings.width, settings.height);
+}
+
+//Invoke waits until the last submitted frame has been replayed, so the framebuffer holds it
+bool ModuleHeadless::WriteImage() {
+	std::vector<unsigned char> pixels(settings.width * settings.height * 4);
+	App->GetOpenGL()->GetRenderThread()->Invoke([this, &pixels]() {
+		glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
+		glPixelStorei(GL_PACK_ALIGNMENT, 1);
+		glReadPixels(0, 0, settings.width, settings.height, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+		glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+	});
+
+	//GL rows start at the bottom
+	stbi_flip_vertically_on_write(1);
+	if (stbi_write_png(settings.imagePath.c_str(), settings.width, settings.height, 4, pixels.data(), settings.width * 4) == 0) {
+		LOG("Headless: could not write %s", settings.imagePath.c_str());
+		return false;
+	}
+	LOG("Headless: wrote %s", settings.imagePath.c_str());
+	return true;
+}
+
+static float Percentile(const std::vector<float>& sorted, float percentile) {
+	size_t index = (size_t)(percentile * (sorted.size() - 1) + 0.5f);
+	return sorted[index];
+}
+
+bool ModuleHeadless::WriteStats() {
+	if (frameTimes.empty()) {
+		LOG("Headless: no frames measured");
+		return false;
+	}
+
+	std::vector<float> sorted = frameTimes;
+	std::sort(sorted.begin(), sorted.end());
+	float sum = 0.0f, replaySum = 0.0f;
+	for (int i = 0; i < frameTimes.size(); i++) {
+		sum += frameTimes[i];
+		replaySum += replayTimes[i];
+	}
+	float mean = sum / frameTimes.size();
+	float variance = 0.0f;
+	for (int i = 0; i < frameTimes.size(); i++) {
+		variance += (frameTimes[i] - mean) * (frameTimes[i] - mean);
+	}
+	float stddev = sqrtf(variance / frameTimes.size());
+
+	std::ofstream file(settings.statsPath);
+	if (!file) {
+		LOG("Headless: could not write %s", settings.statsPath.c_str());
+		return false;
+	}
+	//One "key value" pair per line, easy to diff and to parse from a CI script
+	file << "model " << settings.modelPath << "\n";
+	file << "renderer " << App->GetOpenGL()->GetRenderer() << "\n";
+	file << "version " << App->GetOpenGL()->GetVersion() << "\n";
+	file << "resolution " << settings.width << "x" << settings.height << "\n";
+	file << "frames " << frameTimes.size() << "\n";
+	file << "warmup_frames " << settings.warmupFrames << "\n";
+	file << "mean_ms " << mean << "\n";
+	file << "stddev_ms " << stddev << "\n";
+	file << "min_ms " << sorted.front() << "\n";
+	file << "p50_ms " << Percentile(sorted, 0.5f) << "\n";
+	file << "p95_ms " << Percentile(sorted, 0.95f) << "\n";
+	file << "p99_ms " << Percentile(sorted, 0.99f) << "\n";
+	file << "max_ms " << sorted.back() << "\n";
+	file << "fps " << 1000.0f / mean << "\n";
+	file << "replay_mean_ms " << replaySum / frameTimes.size() << "\n";
+	if (settings.benchmark) {
+		file << "cull_scalar_ms " << cullScalarMs << "\n";
+		file << "cull_simd_ms " << cullSimdMs << "\n";
+		file << "occlusion_raster_ms " << occlusionRenderMs << "\n";
+		file << "occlusion_test_ms " << occlusionTestMs << "\n";
+		file << "occlusion_occluded " << occludedBoxes << "\n";
+		for (int i = 0; i < lightBinMs.size(); i++) {
+			file << "light_bin_" << benchmarkLightCounts[i] << "_ms " << lightBinMs[i] << "\n";
+		}
+	}
+
+	LOG("Headless: %d frames, mean %.2f ms, p95 %.2f ms, p99 %.2f ms, max %.2f ms", (int)frameTimes.size(), mean, Percentile(sorted, 0.95f), Percentile(sorted, 0.99f), sorted.back());
+	return true;
+}
+
+bool ModuleHeadless::ParseCommandLine(int argc, char** argv, HeadlessSettings& settings) {
+	for (int i = 1; i < argc; i++) {
+		std::string argument = argv[i];
+		bool hasValue = i + 1 < argc;
+		if (argument == "--headless" && hasValue) {
+			settings.enabled = true;
+			settings.modelPath = argv[++i];
+		}
+		else if (argument == "--frames" && hasValue) {
+			settings.frames = atoi(argv[++i]);
+		}
+		else if (argument == "--warmup" && hasValue) {
+			settings.warmupFrames = atoi(argv[++i]);
+		}
+		else if (argument == "--size" && hasValue) {
+			char* end = nullptr;
+			settings.width = strtoul(argv[++i], &end, 10);
+			settings.height = *end == 'x' ? strtoul(end + 1, nullptr, 10) : 0;
+		}
+		else if (argument == "--image" && hasValue) {
+			settings.imagePath = argv[++i];
+		}
+		else if (argument == "--stats" && hasValue) {
+			settings.statsPath = argv[++i];
+		}
+		else if (argument == "--benchmark") {
+			settings.benchmark = true;
+		}
+		else {
+			LOG("Unknown or incomplete argument %s", argument.c_str());
+			LOG("Usage: --headless <model.gltf> [--frames N] [--warmup N] [--size WxH] [--image out.png] [--stats out.txt] [--benchmark]");
+			return false;
+		}
+	}
+
+	if (settings.frames <= 0 || settings.warmupFrames < 0 || settings.width == 0 || settings.height == 0) {
+		LOG("Invalid headless settings: frames and size must be positive");
+		return false;
+	}
+	return true;
+}
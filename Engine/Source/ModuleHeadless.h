@@ -0,0 +1,60 @@
+#pragma once
+#include "Module.h"
+#include <string>
+#include <vector>
+
+//Options of an automated run, filled from the command line:
+//Engine --headless <model.gltf> [--frames N] [--warmup N] [--size WxH] [--image out.png] [--stats out.txt] [--benchmark]
+struct HeadlessSettings {
+	bool enabled = false;
+	std::string modelPath;
+	int frames = 300;
+	int warmupFrames = 10; //Not measured, shaders and textures are still settling
+	unsigned width = 1280;
+	unsigned height = 720;
+	std::string imagePath = "headless.png";
+	std::string statsPath = "headless_stats.txt";
+	bool benchmark = false; //Also times the culling and light binning benchmarks, written with the stats
+};
+
+//Renders a model along a fixed camera orbit into an offscreen framebuffer, then writes the
+//frame time statistics and the last frame. Needs no visible window, so it runs on CI machines:
+//a hidden window on Windows, a surfaceless EGL context (llvmpipe without a GPU) elsewhere.
+class ModuleHeadless :
+	public Module
+{
+public:
+	ModuleHeadless(const HeadlessSettings& settings);
+	~ModuleHeadless();
+
+	bool Init();
+	update_status PreUpdate();
+	update_status PostUpdate();
+	bool CleanUp();
+
+	inline const HeadlessSettings& GetSettings() const { return settings; }
+
+	//Returns false if the arguments are malformed, settings.enabled stays false without --headless
+	static bool ParseCommandLine(int argc, char** argv, HeadlessSettings& settings);
+
+private:
+	void CreateFramebuffer();
+	void RunBenchmarks();
+	bool WriteImage();
+	bool WriteStats();
+
+	HeadlessSettings settings;
+	unsigned framebuffer = 0;
+	unsigned colorTexture = 0;
+	unsigned depthBuffer = 0;
+
+	int frame = 0;
+	unsigned long long lastFrameCounter = 0;
+	std::vector<float> frameTimes;
+	std::vector<float> replayTimes;
+
+	double cullScalarMs = 0.0, cullSimdMs = 0.0;
+	double occlusionRenderMs = 0.0, occlusionTestMs = 0.0;
+	unsigned occludedBoxes = 0;
+	std::vector<double> lightBinMs;
+};
@@ -24,7 +24,7 @@ ModuleInput::ModuleInput()
 // Destructor
 ModuleInput::~ModuleInput()
 {
-	delete keyboard;
+	delete[] keyboard;
 }
 
 // Called before render is available
@@ -126,7 +126,9 @@ update_status ModuleInput::PreUpdate()
 			App->GetCamera()->FocusGeometry(*model);
 			break;
 		}
-		ImGui_ImplSDL2_ProcessEvent(&event);
+		if (App->GetEditor() != nullptr) {
+			ImGui_ImplSDL2_ProcessEvent(&event);
+		}
 	}
 
 	
@@ -196,7 +198,7 @@ bool ModuleInput::CleanUp()
 
 const KeyState ModuleInput::GetKey(int id) const
 {
-	if (!App->GetEditor()->GetIO()->WantCaptureKeyboard)
+	if (App->GetEditor() == nullptr || !App->GetEditor()->GetIO()->WantCaptureKeyboard)
 	return keyboard[id];
 	else
 	return KEY_IDLE;
@@ -204,7 +206,7 @@ const KeyState ModuleInput::GetKey(int id) const
 
 const KeyState ModuleInput::GetMouseButtonDown(int id) const
 {
-	if (!App->GetEditor()->GetIO()->WantCaptureMouse)
+	if (App->GetEditor() == nullptr || !App->GetEditor()->GetIO()->WantCaptureMouse)
 		return mouse_buttons[id - 1];
 	else
 		return KEY_IDLE;
@@ -212,9 +214,9 @@ const KeyState ModuleInput::GetMouseButtonDown(int id) const
 
 const float2& ModuleInput::GetMouseWheel() const
 {
-	if (!App->GetEditor()->GetIO()->WantCaptureMouse)
+	if (App->GetEditor() == nullptr || !App->GetEditor()->GetIO()->WantCaptureMouse)
 		return mouse_wheel;
 	else
-		return float2(0.0f, 0.0f);
+		return float2::zero;
 }
 
@@ -2,8 +2,9 @@
 #include "Module.h"
 #include "Globals.h"
 #include <Math/float2.h>
+#include <stdint.h>
 
-typedef unsigned __int8 Uint8;
+typedef uint8_t Uint8;
 
 #define NUM_MOUSE_BUTTONS 5
 
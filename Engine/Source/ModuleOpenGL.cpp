@@ -3,10 +3,17 @@
 #include "ModuleOpenGL.h"
 #include "ModuleWindow.h"
 #include "ModuleCamera.h"
+#include "StreamingBuffer.h"
+#include "RenderThread.h"
+#include "FrameProfiler.h"
+#include "GLState.h"
+#ifndef _WIN32
+#include "SurfacelessContext.h"
+#endif
 #include "SDL.h"
-#include <.\GL\glew.h>
+#include <GL/glew.h>
 
-static void __stdcall OurOpenGLErrorFunction(GLenum source, GLenum type, GLuint id, GLenum severity, GLsizei length, const GLchar* message, const void* userParam)
+static void GLAPIENTRY OurOpenGLErrorFunction(GLenum source, GLenum type, GLuint id, GLenum severity, GLsizei length, const GLchar* message, const void* userParam)
 {
 	const char* tmp_source = "", * tmp_type = "", * tmp_severity = "";
 	switch (source) {
@@ -39,12 +46,17 @@ static void __stdcall OurOpenGLErrorFunction(GLenum source, GLenum type, GLuint
 
 ModuleOpenGL::ModuleOpenGL()
 {
-
+	streamingBuffer = new StreamingBuffer();
+	renderThread = new RenderThread();
+	profiler = new FrameProfiler();
 }
 
 // Destructor
 ModuleOpenGL::~ModuleOpenGL()
 {
+	delete renderThread;
+	delete streamingBuffer;
+	delete profiler;
 }
 
 
@@ -64,9 +76,23 @@ bool ModuleOpenGL::Init()
 	SDL_GL_SetAttribute(SDL_GL_CONTEXT_FLAGS, SDL_GL_CONTEXT_DEBUG_FLAG); //Debug
 
 	LOG("Creating Renderer context");
-	context = SDL_GL_CreateContext(App->GetWindow()->window);
+	SDL_Window* window = App->GetWindow()->window;
+#ifndef _WIN32
+	context = window != nullptr ? SDL_GL_CreateContext(window) : SurfacelessContext::Create();
+#else
+	context = SDL_GL_CreateContext(window);
+#endif
+	if (context == nullptr) {
+		LOG("Could not create the OpenGL 4.6 context: %s", SDL_GetError());
+		return false;
+	}
 	
 	GLenum err = glewInit();
+	//GLEW also looks for GLX, which a surfaceless context has none of. The GL entry points are loaded by then.
+	if (err != GLEW_OK && !(window == nullptr && err == GLEW_ERROR_NO_GLX_DISPLAY)) {
+		LOG("Could not initialize GLEW: %s", glewGetErrorString(err));
+		return false;
+	}
 	LOG("Using Glew %s", glewGetString(GLEW_VERSION));
 	// Should be 2.0
 
@@ -75,9 +101,14 @@ bool ModuleOpenGL::Init()
 	LOG("Renderer: %s", glGetString(GL_RENDERER));
 	LOG("OpenGL version supported %s", glGetString(GL_VERSION));
 	LOG("GLSL: %s\n", glGetString(GL_SHADING_LANGUAGE_VERSION));
-
-	glEnable(GL_DEPTH_TEST); // Enable depth test
-	glEnable(GL_CULL_FACE); // Enable cull backward faces
+	vendor = (const char*)glGetString(GL_VENDOR);
+	renderer = (const char*)glGetString(GL_RENDERER);
+	version = (const char*)glGetString(GL_VERSION);
+	shadingLanguageVersion = (const char*)glGetString(GL_SHADING_LANGUAGE_VERSION);
+
+	GLState::Invalidate();
+	GLState::Enable(GL_DEPTH_TEST); // Enable depth test
+	GLState::Enable(GL_CULL_FACE); // Enable cull backward faces
 	glFrontFace(GL_CCW); // Front faces will be counter clockwise
 
 	
@@ -90,16 +121,28 @@ bool ModuleOpenGL::Init()
 	float2 windowsSize = App->GetWindow()->GetScreenSize();
 	glViewport(0, 0, windowsSize.x, windowsSize.y);
 
+	streamingBuffer->Init(STREAMING_FRAME_SIZE);
+	SetSwapInterval(VSYNC ? 1 : 0);
+
 	return true;
 }
 
 update_status ModuleOpenGL::PreUpdate()
 {
-	
-	glClearColor(0.4f, 0.3f, 0.1f, 1.0f);
-	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
-
+	StreamingBuffer* stream = streamingBuffer;
+	unsigned output = outputFramebuffer;
+	FrameProfiler* frameProfiler = profiler;
+	const bool profile = profiler->enabled;
+	profiler->BeginCpuFrame();
+	renderThread->Record([stream, output, frameProfiler, profile]() {
+		frameProfiler->BeginGpuFrame(profile);
+		//Objects deleted between frames may have left stale names in the shadow state
+		GLState::NewFrame();
+		stream->BeginFrame();
+		glBindFramebuffer(GL_FRAMEBUFFER, output);
+		glClearColor(0.4f, 0.3f, 0.1f, 1.0f);
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+	});
 
 	return UPDATE_CONTINUE;
 }
@@ -113,8 +156,28 @@ update_status ModuleOpenGL::Update()
 
 update_status ModuleOpenGL::PostUpdate()
 {
-
-	SDL_GL_SwapWindow(App->GetWindow()->window);
+	renderThread->Record([this]() {
+		glGetFloatv(GL_GPU_MEMORY_INFO_TOTAL_AVAILABLE_MEMORY_NVX, &totalVideoMemory);
+		glGetFloatv(GL_GPU_MEMORY_INFO_CURRENT_AVAILABLE_VIDMEM_NVX, &availableVideoMemory);
+		//Everything written to the ring this frame has been submitted
+		streamingBuffer->EndFrame();
+		profiler->EndGpuFrame();
+	});
+	//Hands the frame over, the render thread presents it while the next one is simulated
+	profiler->BeginCpu("Submit");
+	renderThread->Submit();
+	profiler->EndCpu();
+	profiler->EndCpuFrame();
+
+	//Switching between modes only happens between frames, when the context is free to move
+	if (threadedRendering != renderThread->IsRunning()) {
+		if (threadedRendering) {
+			renderThread->Start(App->GetWindow()->window, context);
+		}
+		else {
+			renderThread->Stop();
+		}
+	}
 	return UPDATE_CONTINUE;
 }
 
@@ -123,17 +186,50 @@ bool ModuleOpenGL::CleanUp()
 {
 	LOG("Destroying renderer");
 
+	renderThread->Stop();
+	streamingBuffer->Destroy();
+	profiler->Destroy();
+
 	//Destroy window
+#ifndef _WIN32
+	if (App->GetWindow()->window == nullptr) {
+		SurfacelessContext::Destroy(context);
+		return true;
+	}
+#endif
 	SDL_GL_DeleteContext(context);
 	return true;
 }
 
+//The swap interval belongs to the context, so it is set from whichever thread owns it
+void ModuleOpenGL::SetSwapInterval(int interval)
+{
+	//Nothing is presented without a window
+	if (App->GetWindow()->window == nullptr) {
+		return;
+	}
+	renderThread->Record([this, interval]() {
+		if (SDL_GL_SetSwapInterval(interval) == 0) {
+			swapInterval = interval;
+		}
+		else if (interval == -1 && SDL_GL_SetSwapInterval(1) == 0) {
+			LOG("Adaptive vsync not supported, using vsync");
+			swapInterval = 1;
+		}
+		else {
+			LOG("Could not set swap interval %d: %s", interval, SDL_GetError());
+		}
+	});
+}
+
 void ModuleOpenGL::WindowResized(unsigned width, unsigned height)
 {
 	
 	App->GetWindow()->SetScreenSize(float2(width, height));
 
-	glViewport(0, 0, width, height);
+	renderThread->Record([width, height]() {
+		glViewport(0, 0, width, height);
+	});
 	App->GetCamera()->SetAspectRatio((float)width/(float)height);
 }
 
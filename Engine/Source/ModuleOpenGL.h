@@ -1,11 +1,18 @@
 #pragma once
 #include "Module.h"
 #include "Globals.h"
+#include <string>
 
 
 struct SDL_Texture;
 struct SDL_Renderer;
 struct SDL_Rect;
+class StreamingBuffer;
+class RenderThread;
+class FrameProfiler;
+
+//Per frame budget of the streaming ring, debug draw batches, indirect commands and per draw data
+#define STREAMING_FRAME_SIZE (8 * 1024 * 1024)
 
 class ModuleOpenGL : public Module
 {
@@ -19,10 +26,39 @@ public:
 	update_status PostUpdate();
 	bool CleanUp();
 	void WindowResized(unsigned width, unsigned height);
+	//0 off, 1 vsync, -1 adaptive vsync (tears only when a frame is late), falls back to 1 if unsupported
+	void SetSwapInterval(int interval);
+	inline int GetSwapInterval() const { return swapInterval; }
+	//Where a frame ends up, the window's framebuffer unless a headless run renders offscreen
+	inline void SetOutputFramebuffer(unsigned framebuffer) { outputFramebuffer = framebuffer; }
+	inline unsigned GetOutputFramebuffer() const { return outputFramebuffer; }
+
+	inline StreamingBuffer* GetStreamingBuffer() const { return streamingBuffer; }
+	inline RenderThread* GetRenderThread() const { return renderThread; }
+	inline FrameProfiler* GetProfiler() const { return profiler; }
+	//Read once at Init, the main thread has no context while the render thread runs
+	inline const std::string& GetVendor() const { return vendor; }
+	inline const std::string& GetRenderer() const { return renderer; }
+	inline const std::string& GetVersion() const { return version; }
+	inline const std::string& GetShadingLanguageVersion() const { return shadingLanguageVersion; }
+	inline float GetTotalVideoMemory() const { return totalVideoMemory; }
+	inline float GetAvailableVideoMemory() const { return availableVideoMemory; }
 	
 	
 	
 public:
 	
 	void* context = nullptr;
+	//false is the single threaded fallback, GL commands are then replayed on the main thread
+	bool threadedRendering = true;
+
+private:
+	StreamingBuffer* streamingBuffer = nullptr;
+	RenderThread* renderThread = nullptr;
+	FrameProfiler* profiler = nullptr;
+	std::string vendor, renderer, version, shadingLanguageVersion;
+	float totalVideoMemory = 0.0f;
+	float availableVideoMemory = 0.0f;
+	int swapInterval = 0; //What the driver accepted
+	unsigned outputFramebuffer = 0;
 };
@@ -1,6 +1,7 @@
 #include "ModuleProgram.h"
 #include "Globals.h"
-#include <.\GL\glew.h>
+#include <GL/glew.h>
+#include <stdlib.h>
 
 
 char* ModuleProgram::LoadShaderSource(const char* shader_file_name)
@@ -50,6 +51,8 @@ unsigned ModuleProgram::CreateProgram(unsigned vtx_shader, unsigned frg_shader)
 	unsigned program_id = glCreateProgram();
 	glAttachShader(program_id, vtx_shader);
 	glAttachShader(program_id, frg_shader);
+	//Lets ProgramCache read the linked binary back
+	glProgramParameteri(program_id, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
 	glLinkProgram(program_id);
 	int res;
 	glGetProgramiv(program_id, GL_LINK_STATUS, &res);
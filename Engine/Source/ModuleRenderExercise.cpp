@@ -1,68 +1,290 @@
 #include "Application.h"
-#include <.\GL\glew.h>
+#include <GL/glew.h>
 #include "ModuleWindow.h"
 #include "SDL.h"
 #include "ModuleRenderExercise.h"
 #include "ModuleDebugDraw.h"
 #include "ModuleCamera.h"
-#include "ModuleProgram.h"
-#include "DebugDraw.h"
+#include "ShaderProgram.h"
+#include "debugdraw.h"
 #include "Model.h"
+#include "RenderQueue.h"
+#include "GeometryArena.h"
+#include "OcclusionQueries.h"
+#include "ModuleOpenGL.h"
+#include "StreamingBuffer.h"
+#include "RenderThread.h"
+#include "GLState.h"
+#include "LightClusters.h"
+#include "DynamicResolution.h"
+#include "SoftwareRasterizer.h"
+#include "ShaderWatcher.h"
+#include "ShaderPermutations.h"
+#include "FrameProfiler.h"
+#include "Geometry/AABB.h"
+#include "Geometry/Frustum.h"
+#include "Math/MathFunc.h"
+#include <random>
 #include "Math/float2.h"
 #include "Math/float3.h"
 #include "Math/float4x4.h"
+#include "Math/float4.h"
 
+#define FRAME_UBO_BINDING 0
+
+//Slots of passQueries, each frame alternates between two sets so results are read a frame late
+#define PASS_QUERY_DEPTH_TIME 0
+#define PASS_QUERY_MAIN_TIME 1
+#define PASS_QUERY_FRAGMENTS 2
+
+//std140 layout of the Frame block shared by VertexShader.glsl and FragmentShader.glsl
+struct FrameBlock
+{
+	float4x4 view;
+	float4x4 proj;
+	float4 cameraPosition;
+	float4 lightColor;
+	float4 lightDirection;
+	float4 ambientColor;
+	float4 cameraFront;
+	float4 clusterDepth;
+	float4 viewport;
+	unsigned clusterGrid[4];
+};
 
 ModuleRenderExercise::ModuleRenderExercise() {
-	model = new Model();
+	geometryArena = new GeometryArena();
+	model = new Model(geometryArena);
+	programs = new ShaderPermutations("./Shaders/VertexShader.glsl", "./Shaders/FragmentShader.glsl");
+	depthProgram = new ShaderProgram();
+	renderQueues[0] = new RenderQueue();
+	renderQueues[1] = new RenderQueue();
+	renderQueue = renderQueues[0];
+	occlusionQueries = new OcclusionQueries();
+	lightClusters[0] = new LightClusters();
+	lightClusters[1] = new LightClusters();
+	dynamicResolution = new DynamicResolution();
+	softwareRasterizer = new SoftwareRasterizer();
+	shaderWatcher = new ShaderWatcher();
 }
 
 ModuleRenderExercise::~ModuleRenderExercise() {
 	delete model;
+	delete programs;
+	delete depthProgram;
+	delete renderQueues[0];
+	delete renderQueues[1];
+	delete geometryArena;
+	delete occlusionQueries;
+	delete lightClusters[0];
+	delete lightClusters[1];
+	delete dynamicResolution;
+	delete softwareRasterizer;
+	delete shaderWatcher;
 }
 bool ModuleRenderExercise::Init() {
 
 	
 
-	ModuleProgram program;
-	const char* vertex_shader_file = "./Shaders/VertexShader.glsl";
-	const char* fragment_shader_file = "./Shaders/FragmentShader.glsl";
-	char* vertex_shader_source = program.LoadShaderSource(vertex_shader_file);
-	char* fragment_shader_source = program.LoadShaderSource(fragment_shader_file);
+	programs->Init();
+	depthProgram->Load("./Shaders/DepthVertex.glsl", "./Shaders/DepthFragment.glsl");
+	glGenQueries(6, &passQueries[0][0]);
 
-	LOG("\n\nVERTEX\n");
-	LOG(vertex_shader_source);
-	LOG("\n\nFRAGMENT\n");
-	LOG(fragment_shader_source);
+	glGenBuffers(1, &frameUniformBuffer);
+	glBindBuffer(GL_UNIFORM_BUFFER, frameUniformBuffer);
+	glBufferData(GL_UNIFORM_BUFFER, sizeof(FrameBlock), nullptr, GL_DYNAMIC_DRAW);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
 
-	unsigned vertex_shader_id = program.CompileShader(GL_VERTEX_SHADER, vertex_shader_source);
-	unsigned fragment_shader_id = program.CompileShader(GL_FRAGMENT_SHADER, fragment_shader_source);
-	program_id = program.CreateProgram(vertex_shader_id, fragment_shader_id);
-
-	
+	//Sized for a few typical models, the arena doubles if a scene needs more
+	geometryArena->Init(1 << 18, 1 << 20);
+	bool occlusionProgram = occlusionQueries->Init();
+	shaderWatcher->Init();
+	shaderWatcher->Watch(depthProgram);
+	if (occlusionProgram) {
+		shaderWatcher->Watch(occlusionQueries->GetProgram());
+	}
+	renderQueues[0]->SetStreamingBuffer(App->GetOpenGL()->GetStreamingBuffer());
+	renderQueues[1]->SetStreamingBuffer(App->GetOpenGL()->GetStreamingBuffer());
 
 	//model->Load("./Models/TriangleWithoutIndices/TriangleWithoutIndices.gltf");
 	//model->Load("./Models/Triangle/Triangle.gltf");
 	//model->Load("./Models/BoxInterleaved/BoxInterleaved.gltf");
 	//model->Load("./Models/Box/Box.gltf");
 	//model->Load("./Models/BoxTextured/BoxTextured.gltf");
-	model->Load("./Models/BakerHouse/BakerHouse.gltf");
+	model->Load("./Models/BakerHouse/BakerHouse.gltf", staticBatching);
 	//model->Load("./Models/Duck/Duck.gltf");
+	RequirePrograms();
 	
 	camera = App->GetCamera();
 
 	return true;
 }
 
+//Culling and queue building run here, on the main thread. Everything that talks to GL is
+//recorded and replayed by the render thread, with the values of this frame captured by copy.
 update_status ModuleRenderExercise::Update() {
 
+	RenderThread* renderThread = App->GetOpenGL()->GetRenderThread();
+	FrameProfiler* profiler = App->GetOpenGL()->GetProfiler();
+	profiler->BeginCpu("Scene");
+	//First, a finished reload is swapped in before this frame reads any program ID
+	shaderWatcher->Update(renderThread);
+	//Same for a new stress layout, before anything is culled against the instance buffer
+	if (pendingStressCopies > 0) {
+		int copies = pendingStressCopies;
+		renderThread->Invoke([this, copies]() {
+			model->SetStressCopies(copies);
+		});
+		pendingStressCopies = 0;
+	}
+	renderThread->Record([]() { ShaderProgram::NewFrame(); });
+
+	//The scene goes to the scaled target, ImGui is drawn afterwards at the window's resolution
+	//Work time rather than the frame interval, a frame rate cap would otherwise read as a slow GPU
+	dynamicResolution->Update(*App->GetWorkMilliseconds());
+	const float2 windowSize = App->GetWindow()->GetScreenSize();
+	const float scale = dynamicResolution->GetScale();
+	renderSize = float2(std::max(floorf(windowSize.x * scale), 1.0f), std::max(floorf(windowSize.y * scale), 1.0f));
+	const bool scaled = dynamicResolution->enabled;
+	const unsigned windowWidth = (unsigned)windowSize.x, windowHeight = (unsigned)windowSize.y;
+	const unsigned renderWidth = (unsigned)renderSize.x, renderHeight = (unsigned)renderSize.y;
+	if (scaled) {
+		const float maxScale = dynamicResolution->maxScale;
+		renderThread->Record([this, windowWidth, windowHeight, renderWidth, renderHeight, maxScale]() {
+			dynamicResolution->Begin(windowWidth, windowHeight, renderWidth, renderHeight, maxScale);
+		});
+	}
+
 	RenderWorld();
 	
-	model->DrawModel(program_id);
-	
+	renderQueue = renderQueues[queueIndex];
+	LightClusters* clusters = lightClusters[queueIndex];
+	queueIndex = 1 - queueIndex;
+
+	if (animateLights) {
+		AnimateLights();
+	}
+	clusters->Bin(lights, *camera->GetFrustum());
+	lightBinMs = clusters->GetBinMs();
+	lightIndexCount = clusters->GetIndexCount();
+	maxLightsPerCluster = clusters->GetMaxLightsPerCluster();
+
+	model->Cull(*camera->GetFrustum(), frustumCulling, occlusionCulling);
+	renderQueue->Clear();
+	programs->ResetDrawCounts();
+	model->Enqueue(*renderQueue, *programs, *camera->GetPosition());
+	renderQueue->Sort();
+
+	RenderQueue* queue = renderQueue;
+	const bool prepass = depthPrepass;
+	const bool hardware = hardwareOcclusion;
+	const float3 cameraPosition = *camera->GetPosition();
+	const int backend = renderBackend;
+	if (backend != RENDER_BACKEND_SOFTWARE) {
+		renderThread->Record([this, queue, clusters, prepass, hardware, cameraPosition]() {
+			clusters->Upload(App->GetOpenGL()->GetStreamingBuffer());
+			SubmitPasses(*queue, prepass, hardware, cameraPosition);
+		});
+	}
+	if (backend != RENDER_BACKEND_GL) {
+		profiler->BeginCpu("Software raster");
+		RenderSoftware(*queue, *clusters, renderWidth, renderHeight);
+		profiler->EndCpu();
+		const int buffer = softwareRasterizer->GetPresentBuffer();
+		const bool split = backend == RENDER_BACKEND_SPLIT;
+		renderThread->Record([this, buffer, split, profiler]() {
+			profiler->BeginGpu("Software present");
+			softwareRasterizer->Present(buffer, split);
+			profiler->EndGpu();
+		});
+	}
+	if (scaled) {
+		const unsigned output = App->GetOpenGL()->GetOutputFramebuffer();
+		renderThread->Record([this, windowWidth, windowHeight, renderWidth, renderHeight, output, profiler]() {
+			profiler->BeginGpu("Upscale");
+			dynamicResolution->End(windowWidth, windowHeight, renderWidth, renderHeight, output);
+			profiler->EndGpu();
+		});
+	}
+
+	profiler->EndCpu();
 	return UPDATE_CONTINUE;
 }
 
+//Same queue, lights and camera as the GL passes, drawn on the CPU
+void ModuleRenderExercise::RenderSoftware(const RenderQueue& queue, const LightClusters& clusters, unsigned width, unsigned height) {
+	if (!softwareRasterizer->IsPrepared()) {
+		std::vector<unsigned> textures;
+		for (const Material& material : *model->GetMaterials()) {
+			textures.push_back(material.baseColor);
+			textures.push_back(material.occlusionRoughnessMetallic);
+			textures.push_back(material.normal);
+		}
+		App->GetOpenGL()->GetRenderThread()->Invoke([this, &textures]() {
+			softwareRasterizer->Prepare(*geometryArena, textures);
+		});
+	}
+
+	const Frustum* frustum = camera->GetFrustum();
+	SoftwareFrame frame;
+	frame.viewProj = camera->GetProjectionMatrix() * camera->GetViewMatrix();
+	frame.cameraPosition = frustum->pos;
+	frame.cameraFront = frustum->front;
+	frame.lightColor = lightColor;
+	frame.lightDirection = lightDirection;
+	frame.ambientColor = ambientColor;
+	frame.clusterDepth = LightClusters::GetDepthParams(frustum->nearPlaneDistance, frustum->farPlaneDistance);
+	frame.width = width;
+	frame.height = height;
+	softwareRasterizer->Render(queue, frame, clusters);
+}
+
+void ModuleRenderExercise::SubmitPasses(RenderQueue& queue, bool prepass, bool hardware, const float3& cameraPosition) {
+	FrameProfiler* profiler = App->GetOpenGL()->GetProfiler();
+	model->BindInstances();
+	ReadPassQueries();
+
+	if (prepass) {
+		profiler->BeginGpu("Depth prepass");
+		glBeginQuery(GL_TIME_ELAPSED, passQueries[passQuerySet][PASS_QUERY_DEPTH_TIME]);
+		GLState::ColorMask(false);
+		queue.SubmitDepth(depthProgram->GetID(), geometryArena->GetPositionVAO());
+		GLState::ColorMask(true);
+		glEndQuery(GL_TIME_ELAPSED);
+		profiler->EndGpu();
+		//Only the nearest fragment of every pixel is left to shade
+		GLState::DepthFunc(GL_EQUAL);
+		GLState::DepthMask(false);
+	}
+
+	profiler->BeginGpu("Scene");
+	glBeginQuery(GL_TIME_ELAPSED, passQueries[passQuerySet][PASS_QUERY_MAIN_TIME]);
+	glBeginQuery(GL_FRAGMENT_SHADER_INVOCATIONS, passQueries[passQuerySet][PASS_QUERY_FRAGMENTS]);
+	if (hardware) {
+		occlusionQueries->CollectResults();
+		queue.Submit(occlusionQueries);
+	}
+	else {
+		occlusionQueries->Reset(); //Results from before the mode was turned off would be stale
+		queue.Submit();
+	}
+	glEndQuery(GL_FRAGMENT_SHADER_INVOCATIONS);
+	glEndQuery(GL_TIME_ELAPSED);
+	profiler->EndGpu();
+	passQueriesIssued[passQuerySet] = true;
+	passQueryDepth[passQuerySet] = prepass;
+
+	if (prepass) {
+		GLState::DepthFunc(GL_LESS);
+		GLState::DepthMask(true);
+	}
+	if (hardware) {
+		profiler->BeginGpu("Occlusion queries");
+		occlusionQueries->IssueQueries(queue.GetPackets(), cameraPosition);
+		profiler->EndGpu();
+	}
+}
+
 /*unsigned ModuleRenderExercise::CreateTriangleVBO()
 {
 	float vtx_data[] =
@@ -98,7 +320,7 @@ update_status ModuleRenderExercise::Update() {
 void ModuleRenderExercise::RenderWorld()
 {
 	
-	float2 screenSize = App->GetWindow()->GetScreenSize();
+	float2 screenSize = renderSize;
 	float4x4 model_matrix, view_matrix, proj_matrix;
 	float3 translation(0.0f, 0.0f, 0.0f);
 	model_matrix = float4x4::FromTRS(translation, float4x4::RotateZ(0), float3(1.0f, 1.0f, 1.0f));
@@ -108,29 +330,174 @@ void ModuleRenderExercise::RenderWorld()
 	view_matrix = camera->GetViewMatrix();
 	proj_matrix = camera->GetProjectionMatrix();
 	
-	dd::axisTriad(float4x4::identity, 0.1f, 1.0f);
-	dd::xzSquareGrid(-10, 10, 0.0f, 1.0f, dd::colors::Gray);
-	App->GetDebugDraw()->Draw(view_matrix, proj_matrix,screenSize.x, screenSize.y);
-
-	glUseProgram(program_id);
-	glUniformMatrix4fv(0, 1, GL_TRUE, &model_matrix[0][0]);
-	glUniformMatrix4fv(1, 1, GL_TRUE, &view_matrix[0][0]);
-	glUniformMatrix4fv(2, 1, GL_TRUE, &proj_matrix[0][0]);
+	//Matrices are declared row_major in the block, so MathGeoLib's layout is copied as is
+	FrameBlock frame;
+	frame.view = view_matrix;
+	frame.proj = proj_matrix;
+	frame.cameraPosition = float4(*camera->GetPosition(), 1.0f);
+	frame.lightColor = float4(lightColor, 0.0f);
+	frame.lightDirection = float4(lightDirection, 0.0f);
+	frame.ambientColor = float4(ambientColor, 0.0f);
+	const Frustum* frustum = camera->GetFrustum();
+	frame.cameraFront = float4(frustum->front, 0.0f);
+	frame.clusterDepth = LightClusters::GetDepthParams(frustum->nearPlaneDistance, frustum->farPlaneDistance);
+	frame.viewport = float4(screenSize.x, screenSize.y, 0.0f, 0.0f);
+	frame.clusterGrid[0] = CLUSTER_X;
+	frame.clusterGrid[1] = CLUSTER_Y;
+	frame.clusterGrid[2] = CLUSTER_Z;
+	frame.clusterGrid[3] = lights.size();
+
+	const bool showGrid = this->showGrid;
+	App->GetOpenGL()->GetRenderThread()->Record([this, frame, model_matrix, screenSize, showGrid]() {
+		//The grid is retained in ModuleDebugDraw, transient dd shapes are queued and flushed here, so dd's queue only ever lives on the render thread
+		FrameProfiler* profiler = App->GetOpenGL()->GetProfiler();
+		profiler->BeginGpu("Debug draw");
+		App->GetDebugDraw()->SetRetainedVisible(App->GetDebugDraw()->GetGrid(), showGrid);
+		App->GetDebugDraw()->Draw(frame.view, frame.proj, screenSize.x, screenSize.y);
+		profiler->EndGpu();
+
+		//Streamed like the rest of the per frame data, frameUniformBuffer is only the fallback
+		StreamingBuffer* stream = App->GetOpenGL()->GetStreamingBuffer();
+		GLint uniformAlignment = 4;
+		glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &uniformAlignment);
+		size_t offset = stream->Write(&frame, sizeof(FrameBlock), uniformAlignment);
+		if (offset != StreamingBuffer::INVALID_OFFSET) {
+			glBindBufferRange(GL_UNIFORM_BUFFER, FRAME_UBO_BINDING, stream->GetBuffer(), offset, sizeof(FrameBlock));
+		}
+		else {
+			glBindBuffer(GL_UNIFORM_BUFFER, frameUniformBuffer);
+			glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(FrameBlock), &frame);
+			glBindBuffer(GL_UNIFORM_BUFFER, 0);
+			glBindBufferBase(GL_UNIFORM_BUFFER, FRAME_UBO_BINDING, frameUniformBuffer);
+		}
+
+		for (unsigned features = 0; features < SHADER_PERMUTATION_COUNT; ++features) {
+			if (const ShaderProgram* variant = programs->GetProgram(features)) {
+				glProgramUniformMatrix4fv(variant->GetID(), 0, 1, GL_TRUE, model_matrix.ptr());
+			}
+		}
+		glProgramUniformMatrix4fv(depthProgram->GetID(), 0, 1, GL_TRUE, model_matrix.ptr());
+	});
 	
 }
 
 bool ModuleRenderExercise::CleanUp()
 {
-	glDeleteProgram(program_id);
+	programs->Destroy();
+	depthProgram->Destroy();
+	glDeleteQueries(6, &passQueries[0][0]);
+	glDeleteBuffers(1, &frameUniformBuffer);
+	renderQueues[0]->Destroy();
+	renderQueues[1]->Destroy();
+	lightClusters[0]->Destroy();
+	lightClusters[1]->Destroy();
+	dynamicResolution->Destroy();
+	softwareRasterizer->Destroy();
+	geometryArena->Destroy();
+	occlusionQueries->Destroy();
 	return true;
 }
 
+//The set about to be reused was issued two frames ago, results that are still not ready are skipped
+void ModuleRenderExercise::ReadPassQueries() {
+	passQuerySet = 1 - passQuerySet;
+	if (!passQueriesIssued[passQuerySet]) {
+		return;
+	}
+
+	//Queries of different objects may become available in any order, every one read is checked
+	for (int query = passQueryDepth[passQuerySet] ? PASS_QUERY_DEPTH_TIME : PASS_QUERY_MAIN_TIME; query <= PASS_QUERY_FRAGMENTS; ++query) {
+		GLuint available = GL_FALSE;
+		glGetQueryObjectuiv(passQueries[passQuerySet][query], GL_QUERY_RESULT_AVAILABLE, &available);
+		if (available == GL_FALSE) {
+			return;
+		}
+	}
+
+	GLuint64 result = 0;
+	glGetQueryObjectui64v(passQueries[passQuerySet][PASS_QUERY_MAIN_TIME], GL_QUERY_RESULT, &result);
+	mainPassMs = result / 1000000.0f;
+	glGetQueryObjectui64v(passQueries[passQuerySet][PASS_QUERY_FRAGMENTS], GL_QUERY_RESULT, &result);
+	fragmentInvocations = result;
+	depthPrepassMs = 0.0f;
+	if (passQueryDepth[passQuerySet]) {
+		glGetQueryObjectui64v(passQueries[passQuerySet][PASS_QUERY_DEPTH_TIME], GL_QUERY_RESULT, &result);
+		depthPrepassMs = result / 1000000.0f;
+	}
+}
+
 void ModuleRenderExercise::LoadModel(char* file) {
-	model->Load(file);
+	App->GetOpenGL()->GetRenderThread()->Invoke([this, file]() {
+		model->Load(file, staticBatching);
+		RequirePrograms();
+	});
+	softwareRasterizer->Invalidate();
+}
+
+//The frame recorded so far already indexes the current instance buffer, so the new layout waits for the next one
+void ModuleRenderExercise::SetStressCopies(int copies) {
+	pendingStressCopies = copies;
 }
 
+//Context current: compiles the permutations the model draws with and watches them for reloads.
+//The main thread is either the one calling or blocked in Invoke, so the watch list is not contended.
+void ModuleRenderExercise::RequirePrograms() {
+	programs->Require(model->GetUsedPermutations());
+	for (unsigned features = 0; features < SHADER_PERMUTATION_COUNT; ++features) {
+		if (programs->GetProgram(features) != nullptr) {
+			shaderWatcher->Watch(programs->GetProgram(features));
+		}
+	}
+}
+
+const ShaderProgram* ModuleRenderExercise::GetProgram() const {
+	return programs->GetFallback();
+}
+
+//Model data is shared with the render thread, it is only changed while that thread is idle
 void ModuleRenderExercise::ClearModel() {
-	model->Clear();
+	App->GetOpenGL()->GetRenderThread()->Invoke([this]() {
+		occlusionQueries->Reset();
+		model->Clear();
+	});
+	softwareRasterizer->Invalidate();
 }
 
 
+
+//Lights are scattered over the model's bounds, one in four is a spot pointing down.
+//Each one circles around where it was placed so the bins change every frame.
+void ModuleRenderExercise::SetLightCount(unsigned count) {
+	std::mt19937 random(count);
+	AABB bounds = *model->GetAABB();
+	float extent = std::max(bounds.Size().MaxElement(), 1.0f);
+	bounds.minPoint -= float3(extent * 0.1f);
+	bounds.maxPoint += float3(extent * 0.1f);
+	std::uniform_real_distribution<float> x(bounds.minPoint.x, bounds.maxPoint.x);
+	std::uniform_real_distribution<float> y(bounds.minPoint.y, bounds.maxPoint.y);
+	std::uniform_real_distribution<float> z(bounds.minPoint.z, bounds.maxPoint.z);
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+
+	lights.resize(count);
+	lightOrbits.resize(count);
+	const float radius = extent * 0.15f;
+	for (unsigned i = 0; i < count; ++i) {
+		lightOrbits[i] = float4(x(random), y(random), z(random), unit(random) * 2.0f * math::pi);
+		Light& light = lights[i];
+		light.positionRadius = float4(lightOrbits[i].xyz(), radius);
+		light.colorIntensity = float4(0.2f + 0.8f * unit(random), 0.2f + 0.8f * unit(random), 0.2f + 0.8f * unit(random), radius * radius);
+		bool spot = (i % 4) == 3;
+		light.directionCosOuter = float4(0.0f, -1.0f, 0.0f, spot ? cosf(DegToRad(35.0f)) : -1.0f);
+		light.cosInner = float4(cosf(DegToRad(25.0f)), 0.0f, 0.0f, 0.0f);
+	}
+}
+
+void ModuleRenderExercise::AnimateLights() {
+	lightTime = SDL_GetTicks() * 0.001f;
+	const float orbit = lights.empty() ? 0.0f : lights[0].positionRadius.w * 0.5f;
+	for (unsigned i = 0; i < lights.size(); ++i) {
+		float angle = lightTime + lightOrbits[i].w;
+		float3 position = lightOrbits[i].xyz() + float3(cosf(angle), 0.0f, sinf(angle)) * orbit;
+		lights[i].positionRadius = float4(position, lights[i].positionRadius.w);
+	}
+}
@@ -1,9 +1,26 @@
 #pragma once
 #include "Module.h"
 #include "Globals.h"
+#include "Math/float2.h"
+#include "Math/float3.h"
+#include "LightClusters.h"
+#include <vector>
 
 
 class Model;
+class ShaderProgram;
+class RenderQueue;
+class GeometryArena;
+class OcclusionQueries;
+class DynamicResolution;
+class SoftwareRasterizer;
+class ShaderWatcher;
+class ShaderPermutations;
+
+//Who draws the scene: GL, the CPU, or GL on the left half and the CPU on the right
+#define RENDER_BACKEND_GL 0
+#define RENDER_BACKEND_SOFTWARE 1
+#define RENDER_BACKEND_SPLIT 2
 
 class ModuleRenderExercise :
     public Module
@@ -20,11 +37,76 @@ public:
 	void ClearModel();
 	inline const Model* GetModel() const { return model; } 
 	void LoadModel(char* file);
+	void SetStressCopies(int copies);
+	void SetLightCount(unsigned count);
+	inline unsigned GetLightCount() const { return lights.size(); }
+	inline DynamicResolution* GetDynamicResolution() const { return dynamicResolution; }
+	inline const SoftwareRasterizer* GetSoftwareRasterizer() const { return softwareRasterizer; }
+	inline const float2& GetRenderSize() const { return renderSize; }
+	inline float GetLightBinMs() const { return lightBinMs; }
+	inline unsigned GetLightIndexCount() const { return lightIndexCount; }
+	inline unsigned GetMaxLightsPerCluster() const { return maxLightsPerCluster; }
+	const ShaderProgram* GetProgram() const;
+	inline const ShaderPermutations* GetPermutations() const { return programs; }
+	inline const ShaderWatcher* GetShaderWatcher() const { return shaderWatcher; }
+	inline const RenderQueue* GetRenderQueue() const { return renderQueue; }
+	inline const OcclusionQueries* GetOcclusionQueries() const { return occlusionQueries; }
+	inline float GetDepthPrepassMs() const { return depthPrepassMs; }
+	inline float GetMainPassMs() const { return mainPassMs; }
+	inline unsigned long long GetFragmentInvocations() const { return fragmentInvocations; }
+
+	float3 lightColor = float3(0.992f, 0.857f, 0.510f);
+	float3 lightDirection = float3(-0.800f, 8.100f, -6.700f);
+	float3 ambientColor = float3(0.802f, 0.739f, 0.739f);
+	bool frustumCulling = true;
+	bool occlusionCulling = false;
+	bool hardwareOcclusion = false;
+	bool depthPrepass = false;
+	bool animateLights = true;
+	bool staticBatching = false; //Read when a model is loaded
+	bool showGrid = true;
+	int renderBackend = RENDER_BACKEND_GL;
 
 private:
 	
-	unsigned program_id = 0, texture_id = 0;
+	unsigned texture_id = 0;
 	void RenderWorld();
+	void ReadPassQueries();
+	void AnimateLights();
+	void SubmitPasses(RenderQueue& queue, bool prepass, bool hardware, const float3& cameraPosition);
+	void RenderSoftware(const RenderQueue& queue, const LightClusters& clusters, unsigned width, unsigned height);
+	void RequirePrograms();
+	
+	ShaderPermutations* programs = nullptr;
+	ShaderProgram* depthProgram = nullptr;
+	ShaderWatcher* shaderWatcher = nullptr;
+	unsigned frameUniformBuffer = 0;
+	RenderQueue* renderQueue = nullptr; //The queue recorded last frame
+	//One queue is filled while the render thread still submits the other
+	RenderQueue* renderQueues[2] = { nullptr, nullptr };
+	int queueIndex = 0;
+	LightClusters* lightClusters[2] = { nullptr, nullptr };
+	DynamicResolution* dynamicResolution = nullptr;
+	SoftwareRasterizer* softwareRasterizer = nullptr;
+	float2 renderSize = float2::zero; //Size the scene is rendered at this frame
+	int pendingStressCopies = 0; //Applied at the start of the next frame, 0 when nothing changed
+
+	std::vector<Light> lights;
+	std::vector<float4> lightOrbits; //Center of each light's circle, phase in w
+	float lightTime = 0.0f;
+	float lightBinMs = 0.0f;
+	unsigned lightIndexCount = 0;
+	unsigned maxLightsPerCluster = 0;
+	GeometryArena* geometryArena = nullptr;
+	OcclusionQueries* occlusionQueries = nullptr;
+
+	unsigned passQueries[2][3] = {};
+	bool passQueriesIssued[2] = { false, false };
+	bool passQueryDepth[2] = { false, false };
+	int passQuerySet = 0;
+	float depthPrepassMs = 0.0f;
+	float mainPassMs = 0.0f;
+	unsigned long long fragmentInvocations = 0;
 	
 	ModuleCamera* camera = nullptr;
 	Model* model = nullptr;
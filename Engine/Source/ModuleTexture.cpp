@@ -1,7 +1,231 @@
 #include "ModuleTexture.h"
 #include "Globals.h"
-#include <.\GL\glew.h>
+#include "GLState.h"
+#include <GL/glew.h>
+#ifndef ENGINE_NO_DIRECTXTEX
 #include "DirectXTex/DirectXTex.h"
+#include "zstd.h"
+#ifdef ENGINE_BASISU
+#include "transcoder/basisu_transcoder.h"
+#endif
+#else
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.h"
+#endif
+#include <vector>
+#include <future>
+#include <mutex>
+#include <algorithm>
+
+#ifndef ENGINE_NO_DIRECTXTEX
+//KTX2 container (https://registry.khronos.org/KTX/specs/2.0/ktxspec.v2.html)
+static const unsigned char KTX2_IDENTIFIER[12] = { 0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n' };
+
+struct KTX2Header
+{
+	unsigned char identifier[12];
+	uint32_t vkFormat, typeSize;
+	uint32_t pixelWidth, pixelHeight, pixelDepth;
+	uint32_t layerCount, faceCount, levelCount;
+	uint32_t supercompressionScheme;
+	uint32_t dfdByteOffset, dfdByteLength;
+	uint32_t kvdByteOffset, kvdByteLength;
+	uint64_t sgdByteOffset, sgdByteLength;
+};
+
+struct KTX2LevelIndex
+{
+	uint64_t byteOffset, byteLength, uncompressedByteLength;
+};
+
+#define KTX2_SUPERCOMPRESSION_NONE 0
+#define KTX2_SUPERCOMPRESSION_BASISLZ 1
+#define KTX2_SUPERCOMPRESSION_ZSTD 2
+#define KHR_DF_MODEL_ETC1S 163
+#define KHR_DF_MODEL_UASTC 166
+
+//Rows of a mip level handed to each decompression job
+#define DECOMPRESS_BAND_ROWS 256
+
+static DXGI_FORMAT VkFormatToDXGI(uint32_t vkFormat) {
+	switch (vkFormat) {
+	case 37: return DXGI_FORMAT_R8G8B8A8_UNORM;		//VK_FORMAT_R8G8B8A8_UNORM
+	case 43: return DXGI_FORMAT_R8G8B8A8_UNORM_SRGB;	//VK_FORMAT_R8G8B8A8_SRGB
+	case 44: return DXGI_FORMAT_B8G8R8A8_UNORM;		//VK_FORMAT_B8G8R8A8_UNORM
+	case 50: return DXGI_FORMAT_B8G8R8A8_UNORM_SRGB;	//VK_FORMAT_B8G8R8A8_SRGB
+	case 131:
+	case 133: return DXGI_FORMAT_BC1_UNORM;			//VK_FORMAT_BC1_RGB(A)_UNORM_BLOCK
+	case 132:
+	case 134: return DXGI_FORMAT_BC1_UNORM_SRGB;		//VK_FORMAT_BC1_RGB(A)_SRGB_BLOCK
+	case 135: return DXGI_FORMAT_BC2_UNORM;
+	case 136: return DXGI_FORMAT_BC2_UNORM_SRGB;
+	case 137: return DXGI_FORMAT_BC3_UNORM;
+	case 138: return DXGI_FORMAT_BC3_UNORM_SRGB;
+	case 139: return DXGI_FORMAT_BC4_UNORM;
+	case 140: return DXGI_FORMAT_BC4_SNORM;
+	case 141: return DXGI_FORMAT_BC5_UNORM;
+	case 142: return DXGI_FORMAT_BC5_SNORM;
+	case 145: return DXGI_FORMAT_BC7_UNORM;
+	case 146: return DXGI_FORMAT_BC7_UNORM_SRGB;
+	default: return DXGI_FORMAT_UNKNOWN;
+	}
+}
+
+static bool IsFormatSupportedGPU(DXGI_FORMAT format) {
+	switch (format) {
+	case DXGI_FORMAT_BC1_UNORM:
+	case DXGI_FORMAT_BC2_UNORM:
+	case DXGI_FORMAT_BC3_UNORM:
+		return GLEW_EXT_texture_compression_s3tc;
+	case DXGI_FORMAT_BC1_UNORM_SRGB:
+	case DXGI_FORMAT_BC2_UNORM_SRGB:
+	case DXGI_FORMAT_BC3_UNORM_SRGB:
+		return GLEW_EXT_texture_compression_s3tc && GLEW_EXT_texture_sRGB;
+	case DXGI_FORMAT_BC4_UNORM:
+	case DXGI_FORMAT_BC4_SNORM:
+	case DXGI_FORMAT_BC5_UNORM:
+	case DXGI_FORMAT_BC5_SNORM:
+		return GLEW_VERSION_3_0 || GLEW_ARB_texture_compression_rgtc;
+	case DXGI_FORMAT_BC7_UNORM:
+	case DXGI_FORMAT_BC7_UNORM_SRGB:
+		return GLEW_VERSION_4_2 || GLEW_ARB_texture_compression_bptc;
+	default:
+		return !DirectX::IsCompressed(format);
+	}
+}
+
+//Decompresses every mip of src into an RGBA8 chain. Each mip is split in bands of rows so
+//the big top level does not end up serialized on a single worker.
+static bool DecompressToRGBA8(const DirectX::ScratchImage& src, DirectX::ScratchImage& dst) {
+	const DirectX::TexMetadata& metadata = src.GetMetadata();
+	if (FAILED(dst.Initialize2D(DXGI_FORMAT_R8G8B8A8_UNORM, metadata.width, metadata.height, 1, metadata.mipLevels))) {
+		return false;
+	}
+
+	std::vector<std::future<bool>> jobs;
+	for (size_t i = 0; i < metadata.mipLevels; ++i) {
+		const DirectX::Image* srcMip = src.GetImage(i, 0, 0);
+		const DirectX::Image* dstMip = dst.GetImage(i, 0, 0);
+
+		for (size_t firstRow = 0; firstRow < srcMip->height; firstRow += DECOMPRESS_BAND_ROWS) {
+			jobs.push_back(std::async(std::launch::async, [srcMip, dstMip, firstRow]() {
+				size_t rows = std::min<size_t>(DECOMPRESS_BAND_ROWS, srcMip->height - firstRow);
+
+				//Bands start on a block boundary, so one block row of the source covers 4 pixel rows
+				DirectX::Image band = *srcMip;
+				band.height = rows;
+				band.pixels = srcMip->pixels + (firstRow / 4) * srcMip->rowPitch;
+				band.slicePitch = ((rows + 3) / 4) * srcMip->rowPitch;
+
+				DirectX::ScratchImage decompressed;
+				if (FAILED(DirectX::Decompress(band, DXGI_FORMAT_R8G8B8A8_UNORM, decompressed))) {
+					return false;
+				}
+				const DirectX::Image* result = decompressed.GetImage(0, 0, 0);
+				for (size_t row = 0; row < rows; ++row) {
+					memcpy(dstMip->pixels + (firstRow + row) * dstMip->rowPitch, result->pixels + row * result->rowPitch, dstMip->rowPitch);
+				}
+				return true;
+			}));
+		}
+	}
+
+	bool ok = true;
+	for (std::future<bool>& job : jobs) {
+		ok = job.get() && ok;
+	}
+	return ok;
+}
+
+//The color model is the first byte after dfdTotalSize (4) and the descriptor type/version/size (8)
+static bool IsBasisPayload(const KTX2Header& header, unsigned char colorModel) {
+	return header.supercompressionScheme == KTX2_SUPERCOMPRESSION_BASISLZ || colorModel == KHR_DF_MODEL_ETC1S || colorModel == KHR_DF_MODEL_UASTC;
+}
+
+//Levels stored without mips ask the loader to generate them, block formats are expanded to RGBA8 first.
+//Otherwise the levels are kept as they are if the context can sample them, and decompressed if not.
+static bool FinishKTX2Image(DirectX::ScratchImage& fileImage, bool generateMips, DirectX::ScratchImage& scrImage) {
+	const DXGI_FORMAT format = fileImage.GetMetadata().format;
+	if (generateMips) {
+		DirectX::ScratchImage rgba;
+		const DirectX::ScratchImage* base = &fileImage;
+		if (DirectX::IsCompressed(format)) {
+			if (!DecompressToRGBA8(fileImage, rgba)) {
+				return false;
+			}
+			base = &rgba;
+		}
+		return SUCCEEDED(DirectX::GenerateMipMaps(*base->GetImage(0, 0, 0), DirectX::TEX_FILTER_DEFAULT, 0, scrImage));
+	}
+
+	if (IsFormatSupportedGPU(format)) {
+		scrImage = std::move(fileImage);
+		return true;
+	}
+
+	LOG("KTX2: Block format not supported by the GL context, decompressing to RGBA8");
+	return DecompressToRGBA8(fileImage, scrImage);
+}
+
+#ifdef ENGINE_BASISU
+//ETC1S and UASTC go to the best block format the context samples: BC7, then BC3 (BC1 without alpha),
+//then plain RGBA8. Every mip is transcoded by its own job, each with its own transcoder state.
+static bool TranscodeBasis(const std::vector<unsigned char>& data, bool generateMips, DirectX::ScratchImage& scrImage) {
+	static std::once_flag initialized;
+	std::call_once(initialized, []() { basist::basisu_transcoder_init(); });
+
+	basist::ktx2_transcoder transcoder;
+	if (!transcoder.init(data.data(), (uint32_t)data.size()) || !transcoder.start_transcoding()) {
+		LOG("KTX2: Could not start transcoding the Basis Universal payload");
+		return false;
+	}
+
+	const bool srgb = transcoder.get_dfd_transfer_func() == basist::KTX2_KHR_DF_TRANSFER_SRGB;
+	basist::transcoder_texture_format target = basist::transcoder_texture_format::cTFRGBA32;
+	DXGI_FORMAT format = srgb ? DXGI_FORMAT_R8G8B8A8_UNORM_SRGB : DXGI_FORMAT_R8G8B8A8_UNORM;
+	if (IsFormatSupportedGPU(srgb ? DXGI_FORMAT_BC7_UNORM_SRGB : DXGI_FORMAT_BC7_UNORM)) {
+		target = basist::transcoder_texture_format::cTFBC7_RGBA;
+		format = srgb ? DXGI_FORMAT_BC7_UNORM_SRGB : DXGI_FORMAT_BC7_UNORM;
+	}
+	else if (transcoder.get_has_alpha() && IsFormatSupportedGPU(srgb ? DXGI_FORMAT_BC3_UNORM_SRGB : DXGI_FORMAT_BC3_UNORM)) {
+		target = basist::transcoder_texture_format::cTFBC3_RGBA;
+		format = srgb ? DXGI_FORMAT_BC3_UNORM_SRGB : DXGI_FORMAT_BC3_UNORM;
+	}
+	else if (!transcoder.get_has_alpha() && IsFormatSupportedGPU(srgb ? DXGI_FORMAT_BC1_UNORM_SRGB : DXGI_FORMAT_BC1_UNORM)) {
+		target = basist::transcoder_texture_format::cTFBC1_RGB;
+		format = srgb ? DXGI_FORMAT_BC1_UNORM_SRGB : DXGI_FORMAT_BC1_UNORM;
+	}
+
+	const uint32_t levelCount = transcoder.get_levels();
+	DirectX::ScratchImage fileImage;
+	if (FAILED(fileImage.Initialize2D(format, transcoder.get_width(), transcoder.get_height(), 1, levelCount))) {
+		return false;
+	}
+
+	//Output sizes and pitches are in blocks for block formats and in pixels for RGBA8
+	const uint32_t unitBytes = basist::basis_get_bytes_per_block_or_pixel(target);
+	const bool uncompressed = basist::basis_transcoder_format_is_uncompressed(target);
+	std::vector<std::future<bool>> jobs;
+	for (uint32_t level = 0; level < levelCount; ++level) {
+		const DirectX::Image* mip = fileImage.GetImage(level, 0, 0);
+		jobs.push_back(std::async(std::launch::async, [&transcoder, mip, level, target, unitBytes, uncompressed]() {
+			basist::ktx2_transcoder_state state;
+			return transcoder.transcode_image_level(level, 0, 0, mip->pixels, (uint32_t)(mip->slicePitch / unitBytes), target, 0,
+				(uint32_t)(mip->rowPitch / unitBytes), uncompressed ? (uint32_t)mip->height : 0, -1, -1, &state);
+		}));
+	}
+	bool ok = true;
+	for (std::future<bool>& job : jobs) {
+		ok = job.get() && ok;
+	}
+	if (!ok) {
+		LOG("KTX2: Could not transcode the %s payload", transcoder.is_uastc() ? "UASTC" : "ETC1S");
+		return false;
+	}
+	return FinishKTX2Image(fileImage, generateMips, scrImage);
+}
+#endif
+#endif
 
 ModuleTexture::ModuleTexture()
 {
@@ -12,7 +236,49 @@ ModuleTexture::~ModuleTexture()
 {
 }
 
-void  ModuleTexture::LoadTextureFile(DirectX::ScratchImage& scrImage, const wchar_t* texture_file_name) {
+bool ModuleTexture::CleanUp()
+{
+	GLState::DeleteTextures(1, &whiteTexture);
+	GLState::DeleteTextures(1, &flatNormalTexture);
+	whiteTexture = flatNormalTexture = 0;
+	return true;
+}
+
+unsigned ModuleTexture::GetWhiteTexture() {
+	if (whiteTexture == 0) {
+		whiteTexture = CreateSolidTexture(255, 255, 255, 255);
+	}
+	return whiteTexture;
+}
+
+unsigned ModuleTexture::GetFlatNormalTexture() {
+	if (flatNormalTexture == 0) {
+		flatNormalTexture = CreateSolidTexture(128, 128, 255, 255);
+	}
+	return flatNormalTexture;
+}
+
+unsigned ModuleTexture::CreateSolidTexture(unsigned char r, unsigned char g, unsigned char b, unsigned char a) {
+	unsigned char pixel[4] = { r, g, b, a };
+	unsigned texture_id;
+	glGenTextures(1, &texture_id);
+	GLState::BindTexture(0, texture_id);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixel);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+	return texture_id;
+}
+
+#ifndef ENGINE_NO_DIRECTXTEX
+bool ModuleTexture::LoadTextureFile(TextureImage& scrImage, const wchar_t* texture_file_name) {
+
+	size_t length = wcslen(texture_file_name);
+	if (length > 5 && _wcsicmp(texture_file_name + length - 5, L".ktx2") == 0) {
+		if (!LoadKTX2File(scrImage, texture_file_name)) {
+			LOG("\nLOADING TEXTURE FILE: Could not load KTX2 file.");
+			return false;
+		}
+		return true;
+	}
 
 	HRESULT hr = DirectX::LoadFromDDSFile(texture_file_name, DirectX::DDS_FLAGS_NONE, nullptr, scrImage);
 	if (FAILED(hr)) {
@@ -25,17 +291,137 @@ void  ModuleTexture::LoadTextureFile(DirectX::ScratchImage& scrImage, const wcha
 
 			if (FAILED(hr)) {
 				LOG("\nLOADING TEXTURE FILE: File extension not supported.");
+				return false;
 			}
 		}
 	}
+	return true;
+}
+
+bool ModuleTexture::LoadKTX2File(TextureImage& scrImage, const wchar_t* texture_file_name) {
+
+	std::vector<unsigned char> data;
+	FILE* file = nullptr;
+	_wfopen_s(&file, texture_file_name, L"rb");
+	if (file)
+	{
+		fseek(file, 0, SEEK_END);
+		data.resize(ftell(file));
+		fseek(file, 0, SEEK_SET);
+		fread(data.data(), 1, data.size(), file);
+		fclose(file);
+	}
+
+	KTX2Header header;
+	if (data.size() < sizeof(KTX2Header) || memcmp(data.data(), KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER)) != 0) {
+		return false;
+	}
+	memcpy(&header, data.data(), sizeof(KTX2Header));
+
+	if (header.pixelDepth > 1 || header.layerCount > 1 || header.faceCount != 1) {
+		LOG("KTX2: Only 2D textures are supported");
+		return false;
+	}
+
+	unsigned char colorModel = 0;
+	if (header.dfdByteLength >= 16 && header.dfdByteOffset + 16 <= data.size()) {
+		colorModel = data[header.dfdByteOffset + 12];
+	}
+
+	if (IsBasisPayload(header, colorModel)) {
+#ifdef ENGINE_BASISU
+		return TranscodeBasis(data, header.levelCount == 0, scrImage);
+#else
+		LOG("KTX2: Basis Universal payload (%s) found but the transcoder is not compiled in", colorModel == KHR_DF_MODEL_UASTC ? "UASTC" : "ETC1S");
+		return false;
+#endif
+	}
+	if (header.supercompressionScheme != KTX2_SUPERCOMPRESSION_NONE && header.supercompressionScheme != KTX2_SUPERCOMPRESSION_ZSTD) {
+		LOG("KTX2: Supercompression scheme %u not supported", header.supercompressionScheme);
+		return false;
+	}
+
+	DXGI_FORMAT format = VkFormatToDXGI(header.vkFormat);
+	if (format == DXGI_FORMAT_UNKNOWN) {
+		LOG("KTX2: vkFormat %u not supported", header.vkFormat);
+		return false;
+	}
+
+	size_t levelCount = header.levelCount > 0 ? header.levelCount : 1;
+	if (sizeof(KTX2Header) + levelCount * sizeof(KTX2LevelIndex) > data.size()) {
+		return false;
+	}
+	const KTX2LevelIndex* levels = reinterpret_cast<const KTX2LevelIndex*>(data.data() + sizeof(KTX2Header));
+
+	DirectX::ScratchImage fileImage;
+	if (FAILED(fileImage.Initialize2D(format, header.pixelWidth, header.pixelHeight, 1, levelCount))) {
+		return false;
+	}
+
+	//Zstandard supercompressed levels are inflated by one job per mip
+	const bool zstd = header.supercompressionScheme == KTX2_SUPERCOMPRESSION_ZSTD;
+	std::vector<std::future<bool>> jobs;
+	for (size_t i = 0; i < levelCount; ++i) {
+		const DirectX::Image* mip = fileImage.GetImage(i, 0, 0);
+		const size_t storedLength = zstd ? levels[i].byteLength : mip->slicePitch;
+		if (levels[i].byteOffset + storedLength > data.size() || levels[i].byteLength < storedLength) {
+			LOG("KTX2: Level %i is truncated", i);
+			return false;
+		}
+		const unsigned char* stored = data.data() + levels[i].byteOffset;
+		if (zstd) {
+			jobs.push_back(std::async(std::launch::async, [mip, stored, storedLength]() {
+				return ZSTD_decompress(mip->pixels, mip->slicePitch, stored, storedLength) == mip->slicePitch;
+			}));
+		}
+		else {
+			memcpy(mip->pixels, stored, mip->slicePitch);
+		}
+	}
+	bool inflated = true;
+	for (std::future<bool>& job : jobs) {
+		inflated = job.get() && inflated;
+	}
+	if (!inflated) {
+		LOG("KTX2: Could not inflate the Zstandard supercompressed levels");
+		return false;
+	}
+
+	return FinishKTX2Image(fileImage, header.levelCount == 0, scrImage);
 }
 
-unsigned ModuleTexture::LoadTextureGPU(DirectX::ScratchImage* img) {
+bool ModuleTexture::NeedsTranscoder(const wchar_t* texture_file_name) const {
+#ifdef ENGINE_BASISU
+	//Every Basis payload can be transcoded
+	return false;
+#else
+	size_t length = wcslen(texture_file_name);
+	if (length <= 5 || _wcsicmp(texture_file_name + length - 5, L".ktx2") != 0) {
+		return false;
+	}
+
+	FILE* file = nullptr;
+	_wfopen_s(&file, texture_file_name, L"rb");
+	if (!file) {
+		return false;
+	}
+	KTX2Header header;
+	unsigned char colorModel = 0;
+	bool read = fread(&header, sizeof(KTX2Header), 1, file) == 1 && memcmp(header.identifier, KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER)) == 0;
+	if (read && header.dfdByteLength >= 16 && fseek(file, header.dfdByteOffset + 12, SEEK_SET) == 0) {
+		read = fread(&colorModel, 1, 1, file) == 1;
+	}
+	fclose(file);
+	return read && IsBasisPayload(header, colorModel);
+#endif
+}
+
+unsigned ModuleTexture::LoadTextureGPU(TextureImage* img) {
 	unsigned texture_id;
 	DirectX::TexMetadata metadata = img->GetMetadata();
 	glGenTextures(1, &texture_id);
-	int internalFormat, format, type;
-	glBindTexture(GL_TEXTURE_2D, texture_id);
+	int internalFormat = 0, format = 0, type = 0;
+	GLState::BindTexture(0, texture_id);
 
 
 	switch (metadata.format) {
@@ -56,23 +442,58 @@ unsigned ModuleTexture::LoadTextureGPU(DirectX::ScratchImage* img) {
 		format = GL_BGR;
 		type = GL_UNSIGNED_BYTE;
 		break;
+	case DXGI_FORMAT_BC1_UNORM:
+		internalFormat = GL_COMPRESSED_RGBA_S3TC_DXT1_EXT;
+		break;
+	case DXGI_FORMAT_BC1_UNORM_SRGB:
+		internalFormat = GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT1_EXT;
+		break;
+	case DXGI_FORMAT_BC2_UNORM:
+		internalFormat = GL_COMPRESSED_RGBA_S3TC_DXT3_EXT;
+		break;
+	case DXGI_FORMAT_BC2_UNORM_SRGB:
+		internalFormat = GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT3_EXT;
+		break;
+	case DXGI_FORMAT_BC3_UNORM:
+		internalFormat = GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+		break;
+	case DXGI_FORMAT_BC3_UNORM_SRGB:
+		internalFormat = GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT;
+		break;
+	case DXGI_FORMAT_BC4_UNORM:
+		internalFormat = GL_COMPRESSED_RED_RGTC1;
+		break;
+	case DXGI_FORMAT_BC4_SNORM:
+		internalFormat = GL_COMPRESSED_SIGNED_RED_RGTC1;
+		break;
+	case DXGI_FORMAT_BC5_UNORM:
+		internalFormat = GL_COMPRESSED_RG_RGTC2;
+		break;
+	case DXGI_FORMAT_BC5_SNORM:
+		internalFormat = GL_COMPRESSED_SIGNED_RG_RGTC2;
+		break;
+	case DXGI_FORMAT_BC7_UNORM:
+		internalFormat = GL_COMPRESSED_RGBA_BPTC_UNORM;
+		break;
+	case DXGI_FORMAT_BC7_UNORM_SRGB:
+		internalFormat = GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM;
+		break;
 	default:
 		assert(false && "Unsupported format");
 	}
 
+	bool compressed = DirectX::IsCompressed(metadata.format);
 
-	glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, metadata.width, metadata.height, 0, format, type, img->GetPixels());
-
-	if (metadata.mipLevels > -1) {
-		for (size_t i = 0; i < metadata.mipLevels; ++i) {
-			const DirectX::Image* mip = img->GetImage(i, 0, 0);
+	for (size_t i = 0; i < metadata.mipLevels; ++i) {
+		const DirectX::Image* mip = img->GetImage(i, 0, 0);
+		if (compressed) {
+			glCompressedTexImage2D(GL_TEXTURE_2D, i, internalFormat, mip->width, mip->height, 0, mip->slicePitch, mip->pixels);
+		}
+		else {
 			glTexImage2D(GL_TEXTURE_2D, i, internalFormat, mip->width, mip->height, 0, format, type, mip->pixels);
 		}
 	}
-	else {
-		glGenerateMipmap(texture_id);
-	}
-	
+
 
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, metadata.mipLevels - 1);
@@ -82,3 +503,37 @@ unsigned ModuleTexture::LoadTextureGPU(DirectX::ScratchImage* img) {
 
 	return texture_id;
 }
+#else
+bool ModuleTexture::LoadTextureFile(TextureImage& scrImage, const wchar_t* texture_file_name) {
+
+	std::wstring widestr(texture_file_name);
+	std::string path(widestr.begin(), widestr.end());
+	int width = 0, height = 0, channels = 0;
+	unsigned char* pixels = stbi_load(path.c_str(), &width, &height, &channels, 4);
+	if (pixels == nullptr) {
+		LOG("\nLOADING TEXTURE FILE: %s", stbi_failure_reason());
+		return false;
+	}
+	scrImage.width = width;
+	scrImage.height = height;
+	scrImage.pixels.assign(pixels, pixels + width * height * 4);
+	stbi_image_free(pixels);
+	return true;
+}
+
+bool ModuleTexture::NeedsTranscoder(const wchar_t* texture_file_name) const {
+	size_t length = wcslen(texture_file_name);
+	return length > 5 && _wcsicmp(texture_file_name + length - 5, L".ktx2") == 0;
+}
+
+unsigned ModuleTexture::LoadTextureGPU(TextureImage* img) {
+	unsigned texture_id;
+	glGenTextures(1, &texture_id);
+	GLState::BindTexture(0, texture_id);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, img->width, img->height, 0, GL_RGBA, GL_UNSIGNED_BYTE, img->pixels.data());
+	//stb_image only decodes the top level
+	glGenerateMipmap(GL_TEXTURE_2D);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
+	return texture_id;
+}
+#endif
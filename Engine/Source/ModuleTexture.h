@@ -1,22 +1,34 @@
 #pragma once
 #include "Module.h"
+#include "TextureImage.h"
 #include <string>
 
-namespace DirectX
-{
-	class ScratchImage;
-}
-
 class ModuleTexture : public Module
 {
 public:
 	ModuleTexture();
 	~ModuleTexture();
 
-	void LoadTextureFile(DirectX::ScratchImage &scrImage, const wchar_t* texture_file_name);
-	unsigned LoadTextureGPU(DirectX::ScratchImage* img);
-
-
+	//False when the file could not be decoded, scrImage is left empty
+	bool LoadTextureFile(TextureImage &scrImage, const wchar_t* texture_file_name);
+	unsigned LoadTextureGPU(TextureImage* img);
+	//True for KTX2 files with a BasisLZ/ETC1S or UASTC payload when the Basis Universal transcoder
+	//is not compiled in (ENGINE_BASISU, defined when Dependencies\basis_universal is present).
+	//The stb_image build reads no KTX2 at all, so every KTX2 file needs the texture's fallback source.
+	bool NeedsTranscoder(const wchar_t* texture_file_name) const;
+	bool CleanUp();
+
+	//1x1 textures bound in place of the maps a material does not provide
+	unsigned GetWhiteTexture();
+	unsigned GetFlatNormalTexture();
+
+private:
+#ifndef ENGINE_NO_DIRECTXTEX
+	bool LoadKTX2File(TextureImage& scrImage, const wchar_t* texture_file_name);
+#endif
+	unsigned CreateSolidTexture(unsigned char r, unsigned char g, unsigned char b, unsigned char a);
+
+	unsigned whiteTexture = 0, flatNormalTexture = 0;
 
 };
 
@@ -1,6 +1,7 @@
 #include "Globals.h"
 #include "Application.h"
 #include "ModuleWindow.h"
+#include "ModuleHeadless.h"
 #include "SDL.h"
 
 
@@ -19,6 +20,10 @@ bool ModuleWindow::Init()
 	LOG("Init SDL window & surface");
 	bool ret = true;
 
+	if (App->IsHeadless()) {
+		return InitHeadless();
+	}
+
 	if(SDL_Init(SDL_INIT_VIDEO) < 0)
 	{
 		LOG("SDL_VIDEO could not initialize! SDL_Error: %s\n", SDL_GetError());
@@ -55,6 +60,36 @@ bool ModuleWindow::Init()
 	return ret;
 }
 
+//A hidden window only carries the context, frames go to ModuleHeadless' framebuffer.
+//It still needs a GL 4.6 driver, on a machine without a GPU a software ICD such as Mesa's
+//llvmpipe opengl32.dll next to the executable provides one.
+//Elsewhere there is no window at all, ModuleOpenGL creates a surfaceless EGL context instead.
+bool ModuleWindow::InitHeadless()
+{
+	const HeadlessSettings& settings = App->GetHeadless()->GetSettings();
+
+#ifndef _WIN32
+	screenSize = float2(settings.width, settings.height);
+	return true;
+#else
+	if (SDL_Init(SDL_INIT_VIDEO) < 0)
+	{
+		LOG("SDL_VIDEO could not initialize! SDL_Error: %s\n", SDL_GetError());
+		return false;
+	}
+
+	screenSize = float2(settings.width, settings.height);
+	window = SDL_CreateWindow(TITLE, SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED, settings.width, settings.height, SDL_WINDOW_HIDDEN | SDL_WINDOW_OPENGL);
+	if (window == NULL)
+	{
+		LOG("Headless window could not be created! SDL_Error: %s\n", SDL_GetError());
+		return false;
+	}
+	LOG("Headless video driver: %s", SDL_GetCurrentVideoDriver());
+	return true;
+#endif
+}
+
 update_status ModuleWindow::Update() {
 	
 
@@ -37,6 +37,8 @@ public:
 	void SetFullScreen(bool fullScreen);
 	void SetResizable(bool resizable);
 private:
+	bool InitHeadless();
+
 	float2 screenSize = float2::zero;
 
 };
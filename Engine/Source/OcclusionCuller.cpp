@@ -0,0 +1,278 @@
+#include "OcclusionCuller.h"
+#include "Globals.h"
+#include "Geometry/AABB.h"
+#include "Geometry/Frustum.h"
+#include "Math/float4.h"
+#include "Math/MathFunc.h"
+#include "SDL.h"
+#include <immintrin.h>
+#include <future>
+#include <thread>
+#include <random>
+#include <algorithm>
+#include <cfloat>
+
+#define NEAR_W 1e-4f
+
+OcclusionCuller::OcclusionCuller(int width, int height) {
+	//Tiles always cover the buffer exactly, so the SSE loop never runs past a row
+	this->width = (width + TILE_WIDTH - 1) / TILE_WIDTH * TILE_WIDTH;
+	this->height = (height + TILE_HEIGHT - 1) / TILE_HEIGHT * TILE_HEIGHT;
+
+	int levelWidth = this->width, levelHeight = this->height;
+	while (true) {
+		levels.push_back(std::vector<float>(levelWidth * levelHeight, 1.0f));
+		levelWidths.push_back(levelWidth);
+		levelHeights.push_back(levelHeight);
+		if (levelWidth == 1 && levelHeight == 1) {
+			break;
+		}
+		levelWidth = std::max(1, (levelWidth + 1) / 2);
+		levelHeight = std::max(1, (levelHeight + 1) / 2);
+	}
+}
+
+OcclusionCuller::~OcclusionCuller() {
+
+}
+
+void OcclusionCuller::ClearOccluders() {
+	occluderVertices.clear();
+	screenTriangles.clear();
+}
+
+bool OcclusionCuller::AddOccluder(const std::vector<float3>& positions, const std::vector<unsigned>& indices, const float4x4& transform) {
+	if (GetOccluderTriangleCount() + indices.size() / 3 > MAX_OCCLUDER_TRIANGLES) {
+		return false;
+	}
+	for (unsigned index : indices) {
+		occluderVertices.push_back(transform.TransformPos(positions[index]));
+	}
+	return true;
+}
+
+void OcclusionCuller::Render(const float4x4& viewProj) {
+	const Uint64 start = SDL_GetPerformanceCounter();
+	this->viewProj = viewProj;
+
+	//Triangles with a vertex in front of the near plane (z < -w) are dropped, the GPU would clip them
+	//and what shows through the gap must not be hidden. Losing an occluder is always safe.
+	screenTriangles.clear();
+	for (size_t i = 0; i + 2 < occluderVertices.size(); i += 3) {
+		ScreenTriangle triangle;
+		bool valid = true;
+		float farthest = -FLT_MAX;
+		for (int v = 0; v < 3 && valid; ++v) {
+			float4 clip = viewProj * float4(occluderVertices[i + v], 1.0f);
+			if (clip.w < NEAR_W || clip.z < -clip.w) {
+				valid = false;
+				break;
+			}
+			float invW = 1.0f / clip.w;
+			triangle.x[v] = (clip.x * invW * 0.5f + 0.5f) * width;
+			triangle.y[v] = (clip.y * invW * 0.5f + 0.5f) * height;
+			triangle.z[v] = clip.z * invW;
+			farthest = std::max(farthest, triangle.z[v]);
+		}
+		if (!valid || farthest < -1.0f) {
+			continue;
+		}
+		triangle.minX = std::max(0, (int)floorf(std::min({ triangle.x[0], triangle.x[1], triangle.x[2] })));
+		triangle.minY = std::max(0, (int)floorf(std::min({ triangle.y[0], triangle.y[1], triangle.y[2] })));
+		triangle.maxX = std::min(width - 1, (int)ceilf(std::max({ triangle.x[0], triangle.x[1], triangle.x[2] })));
+		triangle.maxY = std::min(height - 1, (int)ceilf(std::max({ triangle.y[0], triangle.y[1], triangle.y[2] })));
+		if (triangle.minX > triangle.maxX || triangle.minY > triangle.maxY) {
+			continue;
+		}
+		screenTriangles.push_back(triangle);
+	}
+
+	std::fill(levels[0].begin(), levels[0].end(), 1.0f);
+
+	//Every tile owns its pixels, jobs take whole tiles so no locking is needed
+	const int tilesX = width / TILE_WIDTH;
+	const int tilesY = height / TILE_HEIGHT;
+	const int tileCount = tilesX * tilesY;
+	const int jobCount = std::max(1, std::min(tileCount, (int)std::thread::hardware_concurrency()));
+	std::vector<std::future<void>> jobs;
+	for (int job = 0; job < jobCount; ++job) {
+		jobs.push_back(std::async(std::launch::async, [this, job, jobCount, tileCount, tilesX]() {
+			for (int tile = job; tile < tileCount; tile += jobCount) {
+				RasterizeTile(tile % tilesX, tile / tilesX);
+			}
+		}));
+	}
+	for (std::future<void>& job : jobs) {
+		job.get();
+	}
+
+	BuildHierarchy();
+	renderMs = (SDL_GetPerformanceCounter() - start) * 1000.0 / SDL_GetPerformanceFrequency();
+}
+
+//Edge functions are evaluated for 4 pixel centers at once, depth keeps the nearest value
+void OcclusionCuller::RasterizeTile(int tileX, int tileY) {
+	const int tileMinX = tileX * TILE_WIDTH, tileMaxX = tileMinX + TILE_WIDTH - 1;
+	const int tileMinY = tileY * TILE_HEIGHT, tileMaxY = tileMinY + TILE_HEIGHT - 1;
+	const __m128 pixelOffsets = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+	const __m128 zero = _mm_setzero_ps();
+	float* depth = levels[0].data();
+
+	for (const ScreenTriangle& triangle : screenTriangles) {
+		int minX = std::max(triangle.minX, tileMinX), maxX = std::min(triangle.maxX, tileMaxX);
+		int minY = std::max(triangle.minY, tileMinY), maxY = std::min(triangle.maxY, tileMaxY);
+		if (minX > maxX || minY > maxY) {
+			continue;
+		}
+
+		//Both windings are drawn, clockwise triangles are flipped so inside is always positive
+		int v1 = 1, v2 = 2;
+		float area = (triangle.x[1] - triangle.x[0]) * (triangle.y[2] - triangle.y[0]) - (triangle.y[1] - triangle.y[0]) * (triangle.x[2] - triangle.x[0]);
+		if (area == 0.0f) {
+			continue;
+		}
+		if (area < 0.0f) {
+			std::swap(v1, v2);
+			area = -area;
+		}
+		const float x[3] = { triangle.x[0], triangle.x[v1], triangle.x[v2] };
+		const float y[3] = { triangle.y[0], triangle.y[v1], triangle.y[v2] };
+		const float z[3] = { triangle.z[0], triangle.z[v1], triangle.z[v2] };
+
+		//Edge i is opposite to vertex i: E(p) = A * px + B * py + C
+		float a[3], b[3], c[3];
+		for (int e = 0; e < 3; ++e) {
+			int from = (e + 1) % 3, to = (e + 2) % 3;
+			a[e] = -(y[to] - y[from]);
+			b[e] = x[to] - x[from];
+			c[e] = (y[to] - y[from]) * x[from] - (x[to] - x[from]) * y[from];
+		}
+		const __m128 invArea = _mm_set1_ps(1.0f / area);
+		const __m128 z0 = _mm_set1_ps(z[0]), z1 = _mm_set1_ps(z[1]), z2 = _mm_set1_ps(z[2]);
+
+		const int startX = minX & ~3;
+		for (int py = minY; py <= maxY; ++py) {
+			float centerY = py + 0.5f;
+			__m128 row0 = _mm_set1_ps(b[0] * centerY + c[0]);
+			__m128 row1 = _mm_set1_ps(b[1] * centerY + c[1]);
+			__m128 row2 = _mm_set1_ps(b[2] * centerY + c[2]);
+			float* depthRow = depth + py * width;
+
+			for (int px = startX; px <= maxX; px += 4) {
+				__m128 centerX = _mm_add_ps(_mm_set1_ps((float)px), pixelOffsets);
+				__m128 w0 = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(a[0]), centerX), row0);
+				__m128 w1 = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(a[1]), centerX), row1);
+				__m128 w2 = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(a[2]), centerX), row2);
+				__m128 inside = _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(w0, zero), _mm_cmpge_ps(w1, zero)), _mm_cmpge_ps(w2, zero));
+				if (_mm_movemask_ps(inside) == 0) {
+					continue;
+				}
+				__m128 pixelDepth = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(w0, z0), _mm_mul_ps(w1, z1)), _mm_mul_ps(w2, z2)), invArea);
+				__m128 current = _mm_loadu_ps(depthRow + px);
+				__m128 nearest = _mm_min_ps(current, pixelDepth);
+				_mm_storeu_ps(depthRow + px, _mm_or_ps(_mm_and_ps(inside, nearest), _mm_andnot_ps(inside, current)));
+			}
+		}
+	}
+}
+
+void OcclusionCuller::BuildHierarchy() {
+	for (size_t level = 1; level < levels.size(); ++level) {
+		const std::vector<float>& src = levels[level - 1];
+		std::vector<float>& dst = levels[level];
+		const int srcWidth = levelWidths[level - 1], srcHeight = levelHeights[level - 1];
+		for (int y = 0; y < levelHeights[level]; ++y) {
+			int y0 = std::min(y * 2, srcHeight - 1), y1 = std::min(y * 2 + 1, srcHeight - 1);
+			for (int x = 0; x < levelWidths[level]; ++x) {
+				int x0 = std::min(x * 2, srcWidth - 1), x1 = std::min(x * 2 + 1, srcWidth - 1);
+				dst[y * levelWidths[level] + x] = std::max(std::max(src[y0 * srcWidth + x0], src[y0 * srcWidth + x1]),
+					std::max(src[y1 * srcWidth + x0], src[y1 * srcWidth + x1]));
+			}
+		}
+	}
+}
+
+//Boxes crossing the near plane or leaving the screen are left to the frustum test
+bool OcclusionCuller::IsVisible(const AABB& box) const {
+	float minX = FLT_MAX, minY = FLT_MAX, maxX = -FLT_MAX, maxY = -FLT_MAX;
+	float nearest = FLT_MAX;
+	for (int i = 0; i < 8; ++i) {
+		float4 clip = viewProj * float4(box.CornerPoint(i), 1.0f);
+		if (clip.w < NEAR_W) {
+			return true;
+		}
+		float invW = 1.0f / clip.w;
+		float x = (clip.x * invW * 0.5f + 0.5f) * width;
+		float y = (clip.y * invW * 0.5f + 0.5f) * height;
+		minX = std::min(minX, x); maxX = std::max(maxX, x);
+		minY = std::min(minY, y); maxY = std::max(maxY, y);
+		nearest = std::min(nearest, clip.z * invW);
+	}
+
+	int x0 = std::max(0, (int)floorf(minX)), x1 = std::min(width - 1, (int)floorf(maxX));
+	int y0 = std::max(0, (int)floorf(minY)), y1 = std::min(height - 1, (int)floorf(maxY));
+	if (x0 > x1 || y0 > y1) {
+		return true;
+	}
+
+	//Go up the pyramid until the box covers about 2x2 texels
+	size_t level = 0;
+	while (level + 1 < levels.size() && std::max(x1 - x0, y1 - y0) >> level > 2) {
+		++level;
+	}
+	const std::vector<float>& maxDepth = levels[level];
+	for (int y = y0 >> level; y <= y1 >> level; ++y) {
+		for (int x = x0 >> level; x <= x1 >> level; ++x) {
+			if (maxDepth[y * levelWidths[level] + x] >= nearest) {
+				return true;
+			}
+		}
+	}
+	return false;
+}
+
+void OcclusionCuller::Benchmark(unsigned occluderCount, unsigned boxCount, double& renderMs, double& testMs, unsigned& occludedCount) {
+	Frustum frustum;
+	frustum.type = FrustumType::PerspectiveFrustum;
+	frustum.pos = float3::zero;
+	frustum.front = float3::unitZ;
+	frustum.up = float3::unitY;
+	frustum.nearPlaneDistance = 0.1f;
+	frustum.farPlaneDistance = 1000.0f;
+	frustum.verticalFov = math::pi / 2.0f;
+	frustum.horizontalFov = math::pi / 2.0f;
+
+	std::mt19937 random(1234);
+	std::uniform_real_distribution<float> spread(-1.0f, 1.0f);
+	std::uniform_real_distribution<float> occluderDepth(5.0f, 20.0f);
+	std::uniform_real_distribution<float> occluderSize(1.0f, 6.0f);
+	std::uniform_real_distribution<float> boxDepth(20.0f, 200.0f);
+	std::uniform_real_distribution<float> boxSize(0.5f, 4.0f);
+
+	OcclusionCuller culler;
+	const std::vector<unsigned> quadIndices = { 0, 1, 2, 0, 2, 3 };
+	for (unsigned i = 0; i < occluderCount; ++i) {
+		float z = occluderDepth(random), size = occluderSize(random);
+		float3 center(spread(random) * z, spread(random) * z, z);
+		std::vector<float3> quad = { center + float3(-size, -size, 0.0f), center + float3(size, -size, 0.0f),
+			center + float3(size, size, 0.0f), center + float3(-size, size, 0.0f) };
+		culler.AddOccluder(quad, quadIndices, float4x4::identity);
+	}
+
+	std::vector<AABB> boxes;
+	for (unsigned i = 0; i < boxCount; ++i) {
+		float z = boxDepth(random);
+		float3 minPoint(spread(random) * z, spread(random) * z, z);
+		boxes.push_back(AABB(minPoint, minPoint + float3(boxSize(random))));
+	}
+
+	culler.Render(frustum.ViewProjMatrix());
+	renderMs = culler.GetRenderMs();
+
+	const Uint64 start = SDL_GetPerformanceCounter();
+	occludedCount = 0;
+	for (const AABB& box : boxes) {
+		occludedCount += culler.IsVisible(box) ? 0 : 1;
+	}
+	testMs = (SDL_GetPerformanceCounter() - start) * 1000.0 / SDL_GetPerformanceFrequency();
+}
@@ -0,0 +1,60 @@
+#pragma once
+#include <vector>
+#include "Math/float3.h"
+#include "Math/float4x4.h"
+
+namespace math
+{
+	class AABB;
+}
+using math::AABB;
+
+// CPU occlusion culling against a low resolution depth buffer, no GL involved.
+// Occluder triangles are rasterized in screen tiles on several threads, 4 pixels at
+// a time with SSE, keeping the nearest NDC depth per pixel. A max-depth pyramid is then
+// built so occludee boxes are tested against a handful of texels whatever their size.
+// A box is hidden when its nearest corner is farther than everything drawn under it.
+class OcclusionCuller
+{
+public:
+	OcclusionCuller(int width = 256, int height = 128);
+	~OcclusionCuller();
+
+	void ClearOccluders();
+	//Returns false once the triangle budget is spent, remaining occluders are ignored
+	bool AddOccluder(const std::vector<float3>& positions, const std::vector<unsigned>& indices, const float4x4& transform);
+	void Render(const float4x4& viewProj);
+	bool IsVisible(const AABB& box) const;
+
+	inline int GetWidth() const { return width; }
+	inline int GetHeight() const { return height; }
+	inline unsigned GetOccluderTriangleCount() const { return (unsigned)(occluderVertices.size() / 3); }
+	inline unsigned GetRasterizedTriangleCount() const { return (unsigned)(screenTriangles.size()); }
+	inline double GetRenderMs() const { return renderMs; }
+	inline const float* GetDepth() const { return levels[0].data(); }
+
+	//Random quads in front of random boxes, headless. Results in milliseconds.
+	static void Benchmark(unsigned occluderCount, unsigned boxCount, double& renderMs, double& testMs, unsigned& occludedCount);
+
+private:
+	struct ScreenTriangle
+	{
+		float x[3], y[3], z[3];
+		int minX, minY, maxX, maxY;
+	};
+
+	static const int TILE_WIDTH = 64; //Multiple of the 4 pixel SSE step
+	static const int TILE_HEIGHT = 32;
+	static const unsigned MAX_OCCLUDER_TRIANGLES = 65536;
+
+	void RasterizeTile(int tileX, int tileY);
+	void BuildHierarchy();
+
+	int width, height;
+	std::vector<float3> occluderVertices; //World space, three per triangle
+	std::vector<ScreenTriangle> screenTriangles;
+	std::vector<std::vector<float>> levels; //levels[0] is the depth buffer, then 2x2 max reductions
+	std::vector<int> levelWidths, levelHeights;
+	float4x4 viewProj = float4x4::identity;
+	double renderMs = 0.0;
+};
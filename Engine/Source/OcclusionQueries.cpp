@@ -0,0 +1,140 @@
+#include "OcclusionQueries.h"
+#include "GLState.h"
+#include "Globals.h"
+#include <GL/glew.h>
+#include "ShaderProgram.h"
+#include "RenderQueue.h"
+#include "Geometry/AABB.h"
+#include "Math/float4x4.h"
+#include "Math/Quat.h"
+
+OcclusionQueries::OcclusionQueries() {
+	program = new ShaderProgram();
+}
+
+OcclusionQueries::~OcclusionQueries() {
+	delete program;
+}
+
+bool OcclusionQueries::Init() {
+	if (!program->Load("./Shaders/OcclusionProxyVertex.glsl", "./Shaders/OcclusionProxyFragment.glsl")) {
+		LOG("Occlusion proxy program failed, hardware occlusion queries disabled");
+		return false;
+	}
+
+	//Unit cube centered at the origin, scaled to each box when drawn
+	const float vertices[] = {
+		-0.5f, -0.5f, -0.5f,  0.5f, -0.5f, -0.5f,  0.5f, 0.5f, -0.5f,  -0.5f, 0.5f, -0.5f,
+		-0.5f, -0.5f, 0.5f,  0.5f, -0.5f, 0.5f,  0.5f, 0.5f, 0.5f,  -0.5f, 0.5f, 0.5f
+	};
+	const unsigned indices[] = {
+		0, 2, 1, 0, 3, 2,  4, 5, 6, 4, 6, 7,  0, 1, 5, 0, 5, 4,
+		3, 6, 2, 3, 7, 6,  0, 4, 7, 0, 7, 3,  1, 2, 6, 1, 6, 5
+	};
+
+	glGenVertexArrays(1, &cubeVAO);
+	GLState::BindVertexArray(cubeVAO);
+	glGenBuffers(1, &cubeVBO);
+	glBindBuffer(GL_ARRAY_BUFFER, cubeVBO);
+	glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
+	glGenBuffers(1, &cubeEBO);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, cubeEBO);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
+	glEnableVertexAttribArray(0);
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, (void*)0);
+	GLState::BindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	return true;
+}
+
+void OcclusionQueries::Destroy() {
+	Reset();
+	program->Destroy();
+	GLState::DeleteVertexArrays(1, &cubeVAO);
+	glDeleteBuffers(1, &cubeVBO);
+	glDeleteBuffers(1, &cubeEBO);
+	cubeVAO = cubeVBO = cubeEBO = 0;
+}
+
+//Meshes are keyed by address, so every query goes when the model is cleared
+void OcclusionQueries::Reset() {
+	for (auto& entry : queries) {
+		glDeleteQueries(1, &entry.second.id);
+	}
+	queries.clear();
+	skippedDraws = 0;
+	queriedDraws = 0;
+}
+
+//Only results that are already available are read, the rest stay pending
+void OcclusionQueries::CollectResults() {
+	++frame;
+	skippedDraws = 0;
+	queriedDraws = 0;
+	for (auto& entry : queries) {
+		Query& query = entry.second;
+		if (!query.pending || query.issuedFrame + 1 != frame) {
+			continue;
+		}
+		GLuint available = GL_FALSE;
+		glGetQueryObjectuiv(query.id, GL_QUERY_RESULT_AVAILABLE, &available);
+		if (available == GL_FALSE) {
+			continue;
+		}
+		GLuint samplesPassed = GL_TRUE;
+		glGetQueryObjectuiv(query.id, GL_QUERY_RESULT, &samplesPassed);
+		query.pending = false;
+		++queriedDraws;
+		skippedDraws += samplesPassed == GL_FALSE ? 1 : 0;
+	}
+}
+
+//A query older than last frame says nothing about the current view, the mesh just draws
+bool OcclusionQueries::BeginConditional(const DrawPacket& packet) {
+	auto it = queries.find(std::make_pair(packet.mesh, packet.range.firstIndex));
+	if (it == queries.end() || it->second.issuedFrame + 1 != frame) {
+		return false;
+	}
+	glBeginConditionalRender(it->second.id, GL_QUERY_NO_WAIT);
+	return true;
+}
+
+void OcclusionQueries::EndConditional() {
+	glEndConditionalRender();
+}
+
+//Boxes holding the camera are never queried, their front faces would be clipped away
+void OcclusionQueries::IssueQueries(const std::vector<DrawPacket>& packets, const float3& cameraPosition) {
+	program->Use();
+	GLState::BindVertexArray(cubeVAO);
+	GLState::ColorMask(false);
+	GLState::DepthMask(false);
+	bool cullFace = GLState::IsEnabled(GL_CULL_FACE);
+	GLState::Disable(GL_CULL_FACE);
+
+	for (const DrawPacket& packet : packets) {
+		AABB bounds(packet.boundsMin, packet.boundsMax);
+		if (bounds.Contains(cameraPosition)) {
+			continue;
+		}
+
+		Query& query = queries[std::make_pair(packet.mesh, packet.range.firstIndex)];
+		if (query.id == 0) {
+			glGenQueries(1, &query.id);
+		}
+		float4x4 box = float4x4::FromTRS(bounds.CenterPoint(), Quat::identity, bounds.Size());
+		glUniformMatrix4fv(0, 1, GL_TRUE, &box[0][0]);
+
+		glBeginQuery(GL_ANY_SAMPLES_PASSED_CONSERVATIVE, query.id);
+		glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, nullptr);
+		glEndQuery(GL_ANY_SAMPLES_PASSED_CONSERVATIVE);
+		query.issuedFrame = frame;
+		query.pending = true;
+	}
+
+	GLState::SetEnabled(GL_CULL_FACE, cullFace);
+	GLState::DepthMask(true);
+	GLState::ColorMask(true);
+	GLState::BindVertexArray(0);
+}
@@ -0,0 +1,50 @@
+#pragma once
+#include <vector>
+#include <map>
+#include "Math/float3.h"
+
+class Mesh;
+class ShaderProgram;
+struct DrawPacket;
+
+// GPU occlusion culling with GL_ANY_SAMPLES_PASSED_CONSERVATIVE queries on the box of each
+// draw. A draw is rendered under glBeginConditionalRender with the query issued the frame
+// before (GL_QUERY_NO_WAIT), so the CPU never waits: a result that is not ready draws.
+// Queries are reissued every frame after the scene so they test against its depth.
+class OcclusionQueries
+{
+public:
+	OcclusionQueries();
+	~OcclusionQueries();
+
+	bool Init();
+	void Destroy();
+	void Reset();
+
+	void CollectResults();
+	bool BeginConditional(const DrawPacket& packet);
+	void EndConditional();
+	void IssueQueries(const std::vector<DrawPacket>& packets, const float3& cameraPosition);
+
+	inline ShaderProgram* GetProgram() const { return program; }
+
+	//Results read back without stalling, they lag one frame behind the draws they decided
+	inline unsigned GetSkippedDraws() const { return skippedDraws; }
+	inline unsigned GetQueriedDraws() const { return queriedDraws; }
+
+private:
+	struct Query
+	{
+		unsigned id = 0;
+		unsigned issuedFrame = 0;
+		bool pending = false;
+	};
+
+	//Keyed by mesh and first index, the visible parts of a static batch can split it into several draws
+	std::map<std::pair<const Mesh*, unsigned>, Query> queries;
+	ShaderProgram* program = nullptr;
+	unsigned cubeVAO = 0, cubeVBO = 0, cubeEBO = 0;
+	unsigned frame = 0;
+	unsigned skippedDraws = 0;
+	unsigned queriedDraws = 0;
+};
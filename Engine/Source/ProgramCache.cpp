@@ -0,0 +1,155 @@
+#include "ProgramCache.h"
+#include "Globals.h"
+#include "GLState.h"
+#include <GL/glew.h>
+#include <fstream>
+#include <cstdio>
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#endif
+
+#define PROGRAM_CACHE_MAGIC 0x4E494250u //"PBIN"
+#define PROGRAM_CACHE_VERSION 1u
+
+#define FNV_OFFSET_BASIS 14695981039346656037ull
+#define FNV_PRIME 1099511628211ull
+
+struct ProgramCacheHeader
+{
+	uint32_t magic;
+	uint32_t version;
+	uint64_t key; //Repeated in the file, a renamed or truncated entry is not trusted
+	uint32_t format;
+	uint32_t length;
+};
+
+unsigned ProgramCache::hits = 0;
+unsigned ProgramCache::misses = 0;
+unsigned ProgramCache::rejected = 0;
+
+static uint64_t Hash(uint64_t hash, const char* text) {
+	//The terminator is hashed too, so "ab" + "c" and "a" + "bc" do not collide
+	do {
+		hash ^= (unsigned char)*text;
+		hash *= FNV_PRIME;
+	} while (*text++ != '\0');
+	return hash;
+}
+
+uint64_t ProgramCache::MakeKey(const std::vector<const char*>& sources) {
+	uint64_t hash = FNV_OFFSET_BASIS;
+	for (const char* source : sources) {
+		hash = Hash(hash, source);
+	}
+	hash = Hash(hash, (const char*)glGetString(GL_VENDOR));
+	hash = Hash(hash, (const char*)glGetString(GL_RENDERER));
+	hash = Hash(hash, (const char*)glGetString(GL_VERSION));
+	return hash;
+}
+
+bool ProgramCache::IsSupported() {
+	GLint formats = 0;
+	glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+	return formats > 0;
+}
+
+std::string ProgramCache::GetPath(uint64_t key) {
+	char name[32];
+	snprintf(name, sizeof(name), "/%016llx.bin", (unsigned long long)key);
+	return std::string(PROGRAM_CACHE_DIRECTORY) + name;
+}
+
+unsigned ProgramCache::Load(uint64_t key) {
+	if (!IsSupported()) {
+		++misses;
+		return 0;
+	}
+
+	std::string path = GetPath(key);
+	std::ifstream file(path, std::ios::binary);
+	ProgramCacheHeader header = {};
+	if (!file || !file.read((char*)&header, sizeof(header)) || header.magic != PROGRAM_CACHE_MAGIC
+		|| header.version != PROGRAM_CACHE_VERSION || header.key != key) {
+		++misses;
+		return 0;
+	}
+	//The length comes from disk, it is checked against what the file really holds before allocating
+	std::streamoff dataStart = file.tellg();
+	file.seekg(0, std::ios::end);
+	std::streamoff remaining = file.tellg() - dataStart;
+	file.seekg(dataStart);
+	if (header.length == 0 || (std::streamoff)header.length > remaining) {
+		LOG("Program cache: %s is truncated, compiling from source", path.c_str());
+		file.close();
+		remove(path.c_str());
+		++misses;
+		return 0;
+	}
+	std::vector<char> binary(header.length);
+	if (!file.read(binary.data(), binary.size())) {
+		++misses;
+		return 0;
+	}
+	file.close();
+
+	unsigned program = glCreateProgram();
+	glProgramBinary(program, header.format, binary.data(), header.length);
+	int linked = GL_FALSE;
+	glGetProgramiv(program, GL_LINK_STATUS, &linked);
+	if (linked == GL_FALSE) {
+		LOG("Program cache: driver rejected %s, compiling from source", path.c_str());
+		GLState::DeleteProgram(program);
+		remove(path.c_str());
+		++rejected;
+		return 0;
+	}
+
+	++hits;
+	return program;
+}
+
+void ProgramCache::Store(unsigned program, uint64_t key) {
+	if (!IsSupported()) {
+		return;
+	}
+
+	GLint length = 0;
+	glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+	if (length <= 0) {
+		return;
+	}
+	std::vector<char> binary(length);
+	GLenum format = 0;
+	glGetProgramBinary(program, length, &length, &format, binary.data());
+
+#ifdef _WIN32
+	_mkdir(PROGRAM_CACHE_DIRECTORY);
+#else
+	mkdir(PROGRAM_CACHE_DIRECTORY, 0755);
+#endif
+	//Written under a temporary name and renamed once complete, a crash mid-write never leaves a truncated entry
+	std::string path = GetPath(key);
+	std::string temporaryPath = path + ".tmp";
+	std::ofstream file(temporaryPath, std::ios::binary);
+	if (!file) {
+		LOG("Program cache: could not write %s", temporaryPath.c_str());
+		return;
+	}
+	ProgramCacheHeader header = { PROGRAM_CACHE_MAGIC, PROGRAM_CACHE_VERSION, key, format, (uint32_t)length };
+	file.write((const char*)&header, sizeof(header));
+	file.write(binary.data(), length);
+	file.close();
+	if (file.fail()) {
+		LOG("Program cache: could not write %s", temporaryPath.c_str());
+		remove(temporaryPath.c_str());
+		return;
+	}
+	//rename does not replace an existing file on Windows
+	remove(path.c_str());
+	if (rename(temporaryPath.c_str(), path.c_str()) != 0) {
+		LOG("Program cache: could not rename %s", temporaryPath.c_str());
+		remove(temporaryPath.c_str());
+	}
+}
@@ -0,0 +1,33 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <cstdint>
+
+#define PROGRAM_CACHE_DIRECTORY "./ShaderCache"
+
+// On-disk cache of linked programs in the driver's own binary format (glGetProgramBinary).
+// Entries are named after an FNV-1a hash of every source of the program together with the
+// vendor, renderer and version strings, so editing a shader or updating the driver simply misses.
+// A binary the driver still rejects (glProgramBinary fails to link) is deleted and the caller
+// compiles from source, storing the fresh result.
+class ProgramCache
+{
+public:
+	static uint64_t MakeKey(const std::vector<const char*>& sources);
+	//Returns a linked program, or 0 if there is no usable entry for the key
+	static unsigned Load(uint64_t key);
+	//Program must have been linked with GL_PROGRAM_BINARY_RETRIEVABLE_HINT
+	static void Store(unsigned program, uint64_t key);
+
+	static inline unsigned GetHitCount() { return hits; }
+	static inline unsigned GetMissCount() { return misses; }
+	static inline unsigned GetRejectedCount() { return rejected; }
+
+private:
+	static bool IsSupported();
+	static std::string GetPath(uint64_t key);
+
+	static unsigned hits;
+	static unsigned misses;
+	static unsigned rejected;
+};
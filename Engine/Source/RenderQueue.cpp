@@ -0,0 +1,264 @@
+#include "RenderQueue.h"
+#include <GL/glew.h>
+#include <cstring>
+#include "Mesh.h"
+#include "Material.h"
+#include "OcclusionQueries.h"
+#include "StreamingBuffer.h"
+#include "GLState.h"
+
+//Key layout, most significant first. GL names are masked down to their field,
+//a collision only costs sort quality since Submit compares the real values.
+#define KEY_PROGRAM_SHIFT 56 //8 bits
+#define KEY_MATERIAL_SHIFT 44 //12 bits
+#define KEY_TEXTURE_SHIFT 32 //12 bits
+#define KEY_VAO_SHIFT 16 //16 bits
+#define KEY_DEPTH_SHIFT 0 //16 bits
+
+#define RADIX_BITS 8
+#define RADIX_BUCKETS (1 << RADIX_BITS)
+
+RenderQueue::RenderQueue() {
+
+}
+
+RenderQueue::~RenderQueue() {
+
+}
+
+void RenderQueue::Clear() {
+	packets.clear();
+	visibleInstances.clear();
+	commandsUploaded = false;
+}
+
+uint64_t RenderQueue::MakeKey(unsigned program, const Material& material, const Mesh& mesh, float depth) {
+	//The bit pattern of a positive float grows with its value, its top 16 bits
+	//are a cheap front to back depth without knowing the far plane
+	if (depth < 0.0f) {
+		depth = 0.0f;
+	}
+	uint32_t depthBits;
+	memcpy(&depthBits, &depth, sizeof(depthBits));
+
+	uint64_t key = 0;
+	key |= (uint64_t)(program & 0xFF) << KEY_PROGRAM_SHIFT;
+	key |= (uint64_t)(material.uniformBuffer & 0xFFF) << KEY_MATERIAL_SHIFT;
+	key |= (uint64_t)(material.baseColor & 0xFFF) << KEY_TEXTURE_SHIFT;
+	key |= (uint64_t)(mesh.GetVAO() & 0xFFFF) << KEY_VAO_SHIFT;
+	key |= (uint64_t)(depthBits >> 16) << KEY_DEPTH_SHIFT;
+	return key;
+}
+
+void RenderQueue::Push(unsigned program, const Material& material, const Mesh& mesh, const GeometryRange& range, float depth, const unsigned* visibleInstances, unsigned visibleCount, const float3& boundsMin, const float3& boundsMax) {
+	DrawPacket packet;
+	packet.key = MakeKey(program, material, mesh, depth);
+	packet.program = program;
+	packet.material = &material;
+	packet.mesh = &mesh;
+	packet.range = range;
+	packet.firstVisible = this->visibleInstances.size();
+	packet.visibleCount = visibleCount;
+	packet.boundsMin = boundsMin;
+	packet.boundsMax = boundsMax;
+	this->visibleInstances.insert(this->visibleInstances.end(), visibleInstances, visibleInstances + visibleCount);
+	packets.push_back(packet);
+}
+
+//LSD radix sort, 8 bits per pass. Passes where every key shares the digit are skipped,
+//which is most of them when a scene only uses a handful of programs and materials.
+void RenderQueue::Sort() {
+	unsortedStateChanges = CountStateChanges();
+	commandsUploaded = false;
+
+	if (packets.size() < 2) {
+		return;
+	}
+
+	scratch.resize(packets.size());
+	for (unsigned shift = 0; shift < 64; shift += RADIX_BITS) {
+		size_t counts[RADIX_BUCKETS] = {};
+		for (const DrawPacket& packet : packets) {
+			++counts[(packet.key >> shift) & (RADIX_BUCKETS - 1)];
+		}
+		if (counts[(packets[0].key >> shift) & (RADIX_BUCKETS - 1)] == packets.size()) {
+			continue;
+		}
+
+		size_t offset = 0;
+		for (unsigned i = 0; i < RADIX_BUCKETS; ++i) {
+			size_t count = counts[i];
+			counts[i] = offset;
+			offset += count;
+		}
+		for (const DrawPacket& packet : packets) {
+			scratch[counts[(packet.key >> shift) & (RADIX_BUCKETS - 1)]++] = packet;
+		}
+		packets.swap(scratch);
+	}
+}
+
+//Same filtering as Submit without touching GL, used to report the unsorted cost
+unsigned RenderQueue::CountStateChanges() const {
+	unsigned changes = 0;
+	unsigned program = 0, uniformBuffer = 0, vao = 0;
+	unsigned textures[3] = { 0, 0, 0 };
+	bool first = true;
+
+	for (const DrawPacket& packet : packets) {
+		const Material& material = *packet.material;
+		const unsigned materialTextures[3] = { material.baseColor, material.occlusionRoughnessMetallic, material.normal };
+
+		if (first || packet.program != program) {
+			program = packet.program;
+			++changes;
+		}
+		if (first || material.uniformBuffer != uniformBuffer) {
+			uniformBuffer = material.uniformBuffer;
+			++changes;
+		}
+		for (int unit = 0; unit < 3; ++unit) {
+			if (first || materialTextures[unit] != textures[unit]) {
+				textures[unit] = materialTextures[unit];
+				++changes;
+			}
+		}
+		if (first || packet.mesh->GetVAO() != vao) {
+			vao = packet.mesh->GetVAO();
+			++changes;
+		}
+		first = false;
+	}
+	return changes;
+}
+
+//Every packet becomes one indirect command, written once per frame and shared by all passes
+void RenderQueue::UploadCommands() {
+	if (commandsUploaded) {
+		return;
+	}
+	commandsUploaded = true;
+
+	instanceCount = 0;
+	commands.resize(packets.size());
+	drawFirstVisible.resize(packets.size());
+	for (size_t i = 0; i < packets.size(); ++i) {
+		const GeometryRange& range = packets[i].range;
+		commands[i].count = range.indexCount;
+		commands[i].instanceCount = packets[i].visibleCount;
+		commands[i].firstIndex = range.firstIndex;
+		commands[i].baseVertex = range.baseVertex;
+		commands[i].baseInstance = 0;
+		drawFirstVisible[i] = packets[i].firstVisible;
+		instanceCount += packets[i].visibleCount;
+	}
+
+	if (indirectBuffer == 0) {
+		glGenBuffers(1, &indirectBuffer);
+		glGenBuffers(1, &drawBuffer);
+		glGenBuffers(1, &visibleBuffer);
+	}
+	GLint storageAlignment = 4;
+	glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &storageAlignment);
+	//Through the streaming ring when there is room, so last frame's arrays are never respecified under the GPU
+	indirectSlice = stream->Stream(indirectBuffer, commands.data(), sizeof(DrawElementsIndirectCommand) * commands.size(), sizeof(unsigned));
+	drawSlice = stream->Stream(drawBuffer, drawFirstVisible.data(), sizeof(unsigned) * drawFirstVisible.size(), storageAlignment);
+	visibleSlice = stream->Stream(visibleBuffer, visibleInstances.data(), sizeof(unsigned) * visibleInstances.size(), storageAlignment);
+}
+
+void RenderQueue::BindCommands() const {
+	glBindBufferRange(GL_SHADER_STORAGE_BUFFER, DRAW_SSBO_BINDING, drawSlice.buffer, drawSlice.offset, drawSlice.size);
+	glBindBufferRange(GL_SHADER_STORAGE_BUFFER, VISIBLE_SSBO_BINDING, visibleSlice.buffer, visibleSlice.offset, visibleSlice.size);
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, indirectSlice.buffer);
+}
+
+//Depth only pass: no material is involved, so the whole queue is a single multi-draw
+//over the position only stream
+void RenderQueue::SubmitDepth(unsigned depthProgram, unsigned positionVAO) {
+	if (packets.empty()) {
+		return;
+	}
+	UploadCommands();
+
+	BindCommands();
+	GLState::UseProgram(depthProgram);
+	GLState::BindVertexArray(positionVAO);
+	glUniform1ui(DRAW_OFFSET_LOCATION, 0);
+	glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, (void*)indirectSlice.offset, (GLsizei)packets.size(), 0);
+	GLState::BindVertexArray(0);
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+}
+
+//Runs of packets sharing program, material and VAO go out in a single glMultiDrawElementsIndirect,
+//gl_DrawID + draw_offset indexes the per draw data.
+//The GL state left by whoever ran before is unknown, so the first run binds everything.
+void RenderQueue::Submit(OcclusionQueries* occlusion) {
+	stateChanges = 0;
+	multiDrawCount = 0;
+	if (packets.empty()) {
+		instanceCount = 0;
+		return;
+	}
+	UploadCommands();
+
+	BindCommands();
+
+	unsigned program = 0, uniformBuffer = 0, vao = 0;
+	unsigned textures[3] = { 0, 0, 0 };
+	bool first = true;
+
+	size_t begin = 0;
+	while (begin < packets.size()) {
+		const DrawPacket& packet = packets[begin];
+		const Material& material = *packet.material;
+		const unsigned materialTextures[3] = { material.baseColor, material.occlusionRoughnessMetallic, material.normal };
+
+		if (first || packet.program != program) {
+			program = packet.program;
+			GLState::UseProgram(program);
+			++stateChanges;
+		}
+		if (first || material.uniformBuffer != uniformBuffer) {
+			uniformBuffer = material.uniformBuffer;
+			glBindBufferBase(GL_UNIFORM_BUFFER, MATERIAL_UBO_BINDING, uniformBuffer);
+			++stateChanges;
+		}
+		for (int unit = 0; unit < 3; ++unit) {
+			if (first || materialTextures[unit] != textures[unit]) {
+				textures[unit] = materialTextures[unit];
+				GLState::BindTexture(unit, textures[unit]);
+				++stateChanges;
+			}
+		}
+		if (first || packet.mesh->GetVAO() != vao) {
+			vao = packet.mesh->GetVAO();
+			GLState::BindVertexArray(vao);
+			++stateChanges;
+		}
+		first = false;
+
+		size_t end = begin + 1;
+		while (occlusion == nullptr && end < packets.size() && packets[end].program == program && packets[end].material == packet.material && packets[end].mesh->GetVAO() == vao) {
+			++end;
+		}
+
+		bool conditional = occlusion != nullptr && occlusion->BeginConditional(packet);
+		glUniform1ui(DRAW_OFFSET_LOCATION, (GLuint)begin);
+		glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, (void*)(indirectSlice.offset + sizeof(DrawElementsIndirectCommand) * begin), (GLsizei)(end - begin), 0);
+		if (conditional) {
+			occlusion->EndConditional();
+		}
+		++multiDrawCount;
+		begin = end;
+	}
+
+	GLState::BindVertexArray(0);
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+}
+
+void RenderQueue::Destroy() {
+	glDeleteBuffers(1, &indirectBuffer);
+	glDeleteBuffers(1, &drawBuffer);
+	glDeleteBuffers(1, &visibleBuffer);
+	indirectBuffer = drawBuffer = visibleBuffer = 0;
+}
@@ -0,0 +1,92 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#include "Math/float3.h"
+#include "StreamingBuffer.h"
+#include "GeometryArena.h"
+
+class Mesh;
+struct Material;
+class OcclusionQueries;
+
+#define DRAW_SSBO_BINDING 3
+#define VISIBLE_SSBO_BINDING 4
+#define DRAW_OFFSET_LOCATION 1
+
+// One visible draw. The key orders packets so that the most expensive state
+// changes happen the least: program | material | base texture | VAO | depth.
+struct DrawPacket
+{
+	uint64_t key = 0;
+	unsigned program = 0;
+	const Material* material = nullptr;
+	const Mesh* mesh = nullptr;
+	GeometryRange range; //The whole mesh, or the visible parts of a static batch
+	unsigned firstVisible = 0; //Offset of this draw's instance indices in the visible list
+	unsigned visibleCount = 0;
+	float3 boundsMin, boundsMax; //World box enclosing the visible instances
+};
+
+//Layout fixed by glMultiDrawElementsIndirect
+struct DrawElementsIndirectCommand
+{
+	unsigned count;
+	unsigned instanceCount;
+	unsigned firstIndex;
+	int baseVertex;
+	unsigned baseInstance;
+};
+
+class RenderQueue
+{
+public:
+	RenderQueue();
+	~RenderQueue();
+
+	void Clear();
+	void Push(unsigned program, const Material& material, const Mesh& mesh, const GeometryRange& range, float depth, const unsigned* visibleInstances, unsigned visibleCount, const float3& boundsMin, const float3& boundsMax);
+	void Sort();
+	void SubmitDepth(unsigned depthProgram, unsigned positionVAO);
+	void Submit(OcclusionQueries* occlusion = nullptr);
+	void Destroy();
+
+	inline void SetStreamingBuffer(StreamingBuffer* stream) { this->stream = stream; }
+	inline size_t GetPacketCount() const { return packets.size(); }
+	inline const std::vector<DrawPacket>& GetPackets() const { return packets; }
+	inline const std::vector<unsigned>& GetVisibleInstances() const { return visibleInstances; }
+	//Bind calls the old per-mesh path would have issued: every state, every draw
+	inline unsigned GetUnconditionalStateChanges() const { return (unsigned)packets.size() * STATES_PER_DRAW; }
+	//Bind calls needed in push (file) order once redundant ones are skipped
+	inline unsigned GetUnsortedStateChanges() const { return unsortedStateChanges; }
+	//Bind calls actually issued by the last Submit
+	inline unsigned GetStateChanges() const { return stateChanges; }
+	//Draws the last Submit would have needed with one call per instance
+	inline unsigned GetInstanceCount() const { return instanceCount; }
+	//glMultiDrawElementsIndirect calls issued by the last Submit, one per program/material run,
+	//or one per packet when occlusion queries need each draw under its own conditional render
+	inline unsigned GetMultiDrawCount() const { return multiDrawCount; }
+
+private:
+	static const unsigned STATES_PER_DRAW = 6; //program, material block, 3 texture units, VAO
+
+	static uint64_t MakeKey(unsigned program, const Material& material, const Mesh& mesh, float depth);
+	unsigned CountStateChanges() const;
+	void UploadCommands();
+	void BindCommands() const;
+
+	std::vector<DrawPacket> packets;
+	std::vector<DrawPacket> scratch;
+	std::vector<DrawElementsIndirectCommand> commands;
+	std::vector<unsigned> drawFirstVisible; //Per draw data, read with gl_DrawID
+	std::vector<unsigned> visibleInstances; //Indices into the model's instance buffer that survived culling
+	unsigned indirectBuffer = 0;
+	unsigned drawBuffer = 0;
+	unsigned visibleBuffer = 0;
+	StreamingBuffer* stream = nullptr;
+	BufferSlice indirectSlice, drawSlice, visibleSlice;
+	bool commandsUploaded = false;
+	unsigned unsortedStateChanges = 0;
+	unsigned stateChanges = 0;
+	unsigned instanceCount = 0;
+	unsigned multiDrawCount = 0;
+};
@@ -0,0 +1,141 @@
+#include "RenderThread.h"
+#include "SDL.h"
+#include <GL/glew.h>
+#ifndef _WIN32
+#include "SurfacelessContext.h"
+#endif
+
+//Headless runs outside Windows have a surfaceless EGL context and no window
+static void MakeCurrent(SDL_Window* window, void* context) {
+#ifndef _WIN32
+	if (window == nullptr) {
+		SurfacelessContext::MakeCurrent(context);
+		return;
+	}
+#endif
+	SDL_GL_MakeCurrent(window, (SDL_GLContext)context);
+}
+
+void RenderCommandList::Execute() {
+	for (RenderCommand& command : commands) {
+		command();
+	}
+}
+
+RenderThread::RenderThread() {
+
+}
+
+RenderThread::~RenderThread() {
+	Stop();
+}
+
+//The context can only be current on one thread, the caller gives it up before the thread takes it
+void RenderThread::Start(SDL_Window* window, void* context) {
+	if (running) {
+		return;
+	}
+	this->window = window;
+	this->context = context;
+	quit = false;
+	framePending = false;
+	MakeCurrent(window, nullptr);
+	running = true;
+	thread = std::thread(&RenderThread::Run, this);
+}
+
+//Lets the thread finish the frame it was given and takes the context back
+void RenderThread::Stop() {
+	if (!running) {
+		return;
+	}
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		quit = true;
+	}
+	wake.notify_one();
+	thread.join();
+	running = false;
+	MakeCurrent(window, context);
+}
+
+void RenderThread::Record(RenderCommand command) {
+	lists[recording].Record(std::move(command));
+}
+
+void RenderThread::Replay(RenderCommandList& list) {
+	Uint64 start = SDL_GetPerformanceCounter();
+	commandCount = list.GetCommandCount();
+	list.Execute();
+	list.Clear();
+	if (window != nullptr) {
+		SDL_GL_SwapWindow(window);
+	}
+	else {
+		//Nothing to present, the frame only has to reach the GPU
+		glFlush();
+	}
+	replayMs = (SDL_GetPerformanceCounter() - start) / (float)SDL_GetPerformanceFrequency() * 1000.0f;
+}
+
+void RenderThread::Submit() {
+	if (!running) {
+		waitMs = 0.0f;
+		Replay(lists[recording]);
+		return;
+	}
+
+	Uint64 start = SDL_GetPerformanceCounter();
+	std::unique_lock<std::mutex> lock(mutex);
+	done.wait(lock, [this]() { return !framePending; });
+	waitMs = (SDL_GetPerformanceCounter() - start) / (float)SDL_GetPerformanceFrequency() * 1000.0f;
+
+	recording = 1 - recording;
+	framePending = true;
+	lock.unlock();
+	wake.notify_one();
+}
+
+void RenderThread::Invoke(const RenderCommand& command) {
+	if (!running) {
+		command();
+		return;
+	}
+
+	std::unique_lock<std::mutex> lock(mutex);
+	done.wait(lock, [this]() { return !framePending && job == nullptr; });
+	job = &command;
+	wake.notify_one();
+	done.wait(lock, [this]() { return job == nullptr; });
+}
+
+void RenderThread::Run() {
+	MakeCurrent(window, context);
+
+	std::unique_lock<std::mutex> lock(mutex);
+	while (true) {
+		wake.wait(lock, [this]() { return quit || framePending || job != nullptr; });
+
+		if (job != nullptr) {
+			//The caller is blocked until this returns, nothing else touches the shared state
+			(*job)();
+			job = nullptr;
+			done.notify_all();
+		}
+		else if (framePending) {
+			//The list that was just swapped out of recording
+			RenderCommandList& list = lists[1 - recording];
+			lock.unlock();
+			Replay(list);
+			lock.lock();
+			framePending = false;
+			done.notify_all();
+		}
+		else {
+			break;
+		}
+	}
+	lock.unlock();
+
+	MakeCurrent(window, nullptr);
+}
@@ -0,0 +1,73 @@
+#pragma once
+#include <vector>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+
+struct SDL_Window;
+
+typedef std::function<void()> RenderCommand;
+
+//GL work recorded by the main thread for one frame, replayed in order by whoever owns the context
+class RenderCommandList
+{
+public:
+	inline void Record(RenderCommand command) { commands.push_back(std::move(command)); }
+	void Execute();
+	inline void Clear() { commands.clear(); }
+	inline size_t GetCommandCount() const { return commands.size(); }
+
+private:
+	std::vector<RenderCommand> commands;
+};
+
+// Owns the GL context while running. The main thread records frame N+1 into one command list
+// while this thread replays frame N from the other one and presents it, so simulation and driver
+// submission overlap. Submit only blocks if the previous frame is still being replayed, which
+// keeps at most one frame in flight.
+// When it is not running the lists are replayed inline by Submit: the single threaded fallback,
+// which goes through exactly the same recorded commands.
+class RenderThread
+{
+public:
+	RenderThread();
+	~RenderThread();
+
+	void Start(SDL_Window* window, void* context);
+	void Stop();
+	void Record(RenderCommand command);
+	void Submit();
+	//Runs command with the context current once the GPU side is idle, and returns when it is done.
+	//Meant for loading and destroying resources the main thread also reads.
+	void Invoke(const RenderCommand& command);
+
+	inline bool IsRunning() const { return running; }
+	//Time spent replaying and presenting the last frame
+	inline float GetReplayMs() const { return replayMs; }
+	//Time the main thread spent in Submit waiting for the previous frame
+	inline float GetWaitMs() const { return waitMs; }
+	inline size_t GetCommandCount() const { return commandCount; }
+
+private:
+	void Run();
+	void Replay(RenderCommandList& list);
+
+	RenderCommandList lists[2];
+	int recording = 0;
+	std::thread thread;
+	std::mutex mutex;
+	std::condition_variable wake;
+	std::condition_variable done;
+	bool running = false;
+	bool quit = false;
+	bool framePending = false;
+	const RenderCommand* job = nullptr;
+	SDL_Window* window = nullptr;
+	void* context = nullptr;
+	//Written by whoever replays, read by the editor on the main thread
+	std::atomic<float> replayMs{ 0.0f };
+	float waitMs = 0.0f;
+	std::atomic<size_t> commandCount{ 0 };
+};
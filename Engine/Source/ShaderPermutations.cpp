@@ -0,0 +1,95 @@
+#include "ShaderPermutations.h"
+#include "ShaderProgram.h"
+#include "Mesh.h"
+#include "Material.h"
+#include "Globals.h"
+
+static const char* featureNames[SHADER_FEATURE_COUNT] = { "HAS_UV", "HAS_BASE_COLOR_MAP", "HAS_OCCLUSION_MAP", "HAS_NORMAL_MAP" };
+
+ShaderPermutations::ShaderPermutations(const char* vertexFile, const char* fragmentFile) : vertexFile(vertexFile), fragmentFile(fragmentFile) {
+
+}
+
+ShaderPermutations::~ShaderPermutations() {
+	Destroy();
+}
+
+bool ShaderPermutations::Init() {
+	Require(1u << (SHADER_PERMUTATION_COUNT - 1));
+	return programs[SHADER_PERMUTATION_COUNT - 1] != nullptr;
+}
+
+void ShaderPermutations::Require(unsigned permutations) {
+	for (unsigned features = 0; features < SHADER_PERMUTATION_COUNT; ++features) {
+		if ((permutations & (1u << features)) == 0 || programs[features] != nullptr || failed[features]) {
+			continue;
+		}
+		ShaderProgram* program = new ShaderProgram();
+		if (program->Load(vertexFile.c_str(), fragmentFile.c_str(), GetDefines(features))) {
+			programs[features] = program;
+		}
+		else {
+			LOG("Shader permutation %u failed, its draws use the full variant", features);
+			delete program;
+			failed[features] = true;
+		}
+	}
+}
+
+void ShaderPermutations::Destroy() {
+	for (unsigned features = 0; features < SHADER_PERMUTATION_COUNT; ++features) {
+		delete programs[features];
+		programs[features] = nullptr;
+		failed[features] = false;
+	}
+}
+
+unsigned ShaderPermutations::GetFeatures(const Mesh& mesh, const Material& material) {
+	if (!mesh.HasUV()) {
+		return 0;
+	}
+	return SHADER_FEATURE_HAS_UV | (material.shaderFeatures & SHADER_FEATURE_MAPS);
+}
+
+std::string ShaderPermutations::GetDefines(unsigned features) {
+	std::string defines;
+	for (int i = 0; i < SHADER_FEATURE_COUNT; ++i) {
+		if (features & (1u << i)) {
+			defines += "#define ";
+			defines += featureNames[i];
+			defines += "\n";
+		}
+	}
+	return defines;
+}
+
+std::string ShaderPermutations::GetName(unsigned features) {
+	std::string name;
+	for (int i = 0; i < SHADER_FEATURE_COUNT; ++i) {
+		if (features & (1u << i)) {
+			name += name.empty() ? "" : " ";
+			name += featureNames[i];
+		}
+	}
+	return name.empty() ? "no features" : name;
+}
+
+unsigned ShaderPermutations::Select(unsigned features) {
+	const ShaderProgram* program = programs[features] != nullptr ? programs[features] : GetFallback();
+	++drawCounts[programs[features] != nullptr ? features : SHADER_PERMUTATION_COUNT - 1];
+	return program != nullptr ? program->GetID() : 0;
+}
+
+unsigned ShaderPermutations::GetBuiltCount() const {
+	unsigned count = 0;
+	for (const ShaderProgram* program : programs) {
+		if (program != nullptr) {
+			++count;
+		}
+	}
+	return count;
+}
+
+unsigned ShaderPermutations::GetReachableCount() {
+	return 1 + (1u << (SHADER_FEATURE_COUNT - 1));
+}
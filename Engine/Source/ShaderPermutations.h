@@ -0,0 +1,58 @@
+#pragma once
+#include <string>
+
+class ShaderProgram;
+class Mesh;
+struct Material;
+
+//Feature bits of a permutation, each one becomes a #define of the same name without the prefix
+#define SHADER_FEATURE_HAS_UV (1 << 0)
+#define SHADER_FEATURE_HAS_BASE_COLOR_MAP (1 << 1)
+#define SHADER_FEATURE_HAS_OCCLUSION_MAP (1 << 2)
+#define SHADER_FEATURE_HAS_NORMAL_MAP (1 << 3)
+#define SHADER_FEATURE_COUNT 4
+#define SHADER_PERMUTATION_COUNT (1 << SHADER_FEATURE_COUNT)
+//Every map needs texture coordinates to be sampled
+#define SHADER_FEATURE_MAPS (SHADER_FEATURE_HAS_BASE_COLOR_MAP | SHADER_FEATURE_HAS_OCCLUSION_MAP | SHADER_FEATURE_HAS_NORMAL_MAP)
+
+// Specialized variants of one vertex/fragment pair. The features a draw needs come from its mesh
+// (texture coordinates) and its material (which maps are real textures rather than the white and
+// flat defaults), and the variant compiled with exactly those #defines draws it, so the shader never
+// samples a map it does not have.
+// Maps are ignored without texture coordinates, which leaves 1 + 2^3 reachable variants out of
+// SHADER_PERMUTATION_COUNT. Only those a loaded model uses are compiled, and the full variant is
+// built by Init as the fallback for any that fails.
+class ShaderPermutations
+{
+public:
+	ShaderPermutations(const char* vertexFile, const char* fragmentFile);
+	~ShaderPermutations();
+
+	//Context current
+	bool Init();
+	//Context current: compiles the variants in the mask (one bit per permutation) not built yet
+	void Require(unsigned permutations);
+	void Destroy();
+
+	static unsigned GetFeatures(const Mesh& mesh, const Material& material);
+	static std::string GetDefines(unsigned features);
+	//Feature names separated by spaces, for reports
+	static std::string GetName(unsigned features);
+
+	//Main thread: program of the variant for features, counted as one draw of it
+	unsigned Select(unsigned features);
+	inline void ResetDrawCounts() { for (unsigned& count : drawCounts) count = 0; }
+
+	inline ShaderProgram* GetProgram(unsigned features) const { return programs[features]; }
+	inline const ShaderProgram* GetFallback() const { return programs[SHADER_PERMUTATION_COUNT - 1]; }
+	inline unsigned GetDrawCount(unsigned features) const { return drawCounts[features]; }
+	unsigned GetBuiltCount() const;
+	static unsigned GetReachableCount();
+
+private:
+	std::string vertexFile;
+	std::string fragmentFile;
+	ShaderProgram* programs[SHADER_PERMUTATION_COUNT] = {};
+	bool failed[SHADER_PERMUTATION_COUNT] = {}; //Not retried, those draws use the fallback
+	unsigned drawCounts[SHADER_PERMUTATION_COUNT] = {};
+};
@@ -0,0 +1,319 @@
+#include "ShaderProgram.h"
+#include "GLState.h"
+#include "ModuleProgram.h"
+#include "Globals.h"
+#include "ProgramCache.h"
+#include "SDL.h"
+#include <GL/glew.h>
+#ifndef _WIN32
+#include <sys/stat.h>
+#endif
+
+unsigned ShaderProgram::lookupCount = 0;
+std::atomic<unsigned> ShaderProgram::lastLookupCount{ 0 };
+float ShaderProgram::loadMs = 0.0f;
+
+//Last write time at 100 ns resolution (nanoseconds off Windows) mixed with the size, a stat time of
+//whole seconds misses a second save within the same second. Zero when the file can not be read,
+//which never matches a stamp recorded by a successful load.
+static long long GetFileStamp(const std::string& file) {
+#ifdef _WIN32
+	WIN32_FILE_ATTRIBUTE_DATA info;
+	if (!GetFileAttributesExA(file.c_str(), GetFileExInfoStandard, &info)) {
+		return 0;
+	}
+	unsigned long long time = ((unsigned long long)info.ftLastWriteTime.dwHighDateTime << 32) | info.ftLastWriteTime.dwLowDateTime;
+	unsigned long long size = ((unsigned long long)info.nFileSizeHigh << 32) | info.nFileSizeLow;
+#else
+	struct stat info;
+	if (stat(file.c_str(), &info) != 0) {
+		return 0;
+	}
+	unsigned long long time = (unsigned long long)info.st_mtim.tv_sec * 1000000000ull + info.st_mtim.tv_nsec;
+	unsigned long long size = (unsigned long long)info.st_size;
+#endif
+	return (long long)(time ^ (size * 0x9E3779B97F4A7C15ull));
+}
+
+static bool HasParallelCompile() {
+	return GLEW_KHR_parallel_shader_compile || GLEW_ARB_parallel_shader_compile;
+}
+
+static void LogShaderInfo(unsigned shader, const std::string& file) {
+	int compiled = GL_FALSE;
+	glGetShaderiv(shader, GL_COMPILE_STATUS, &compiled);
+	if (compiled == GL_TRUE) {
+		return;
+	}
+	int length = 0;
+	glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &length);
+	std::string info(length > 0 ? length : 1, '\0');
+	glGetShaderInfoLog(shader, length, nullptr, &info[0]);
+	LOG("%s: %s", file.c_str(), info.c_str());
+}
+
+ShaderProgram::ShaderProgram() {
+}
+
+ShaderProgram::~ShaderProgram() {
+	Destroy();
+}
+
+bool ShaderProgram::Load(const char* vertex_shader_file, const char* fragment_shader_file, const std::string& defines) {
+	Uint64 start = SDL_GetPerformanceCounter();
+	vertexFile = vertex_shader_file;
+	fragmentFile = fragment_shader_file;
+	this->defines = defines;
+	vertexStamp = GetFileStamp(vertexFile);
+	fragmentStamp = GetFileStamp(fragmentFile);
+
+	std::string vertex_shader_source, fragment_shader_source;
+	if (!ReadSources(vertex_shader_source, fragment_shader_source)) {
+		LOG("Could not read shader sources %s / %s", vertex_shader_file, fragment_shader_file);
+		return false;
+	}
+
+	Destroy();
+	uint64_t key = ProgramCache::MakeKey({ vertex_shader_source.c_str(), fragment_shader_source.c_str() });
+	programID = ProgramCache::Load(key);
+	bool cached = programID != 0;
+	if (!cached) {
+		ModuleProgram program;
+		unsigned vertex_shader_id = program.CompileShader(GL_VERTEX_SHADER, vertex_shader_source.c_str());
+		unsigned fragment_shader_id = program.CompileShader(GL_FRAGMENT_SHADER, fragment_shader_source.c_str());
+		programID = program.CreateProgram(vertex_shader_id, fragment_shader_id);
+	}
+
+	int linked = GL_FALSE;
+	glGetProgramiv(programID, GL_LINK_STATUS, &linked);
+	if (linked == GL_FALSE) {
+		return false;
+	}
+	if (!cached) {
+		ProgramCache::Store(programID, key);
+	}
+
+	Reflect();
+	float ms = (SDL_GetPerformanceCounter() - start) * 1000.0f / SDL_GetPerformanceFrequency();
+	loadMs += ms;
+	LOG("Program %s + %s%s %s in %.2f ms", vertex_shader_file, fragment_shader_file, defines.empty() ? "" : " (variant)", cached ? "loaded from cache" : "compiled", ms);
+	return true;
+}
+
+//Defines go right after the #version line, which has to stay the first one
+bool ShaderProgram::ReadSources(std::string& vertex, std::string& fragment) const {
+	ModuleProgram program;
+	char* vertex_shader_source = program.LoadShaderSource(vertexFile.c_str());
+	char* fragment_shader_source = program.LoadShaderSource(fragmentFile.c_str());
+	bool read = vertex_shader_source != nullptr && fragment_shader_source != nullptr;
+	if (read) {
+		vertex = vertex_shader_source;
+		fragment = fragment_shader_source;
+		for (std::string* source : { &vertex, &fragment }) {
+			size_t version = source->find("#version");
+			size_t line = version == std::string::npos ? std::string::npos : source->find('\n', version);
+			if (line == std::string::npos) {
+				source->insert(0, defines);
+			}
+			else {
+				source->insert(line + 1, defines);
+			}
+		}
+	}
+	free(vertex_shader_source);
+	free(fragment_shader_source);
+	return read;
+}
+
+void ShaderProgram::Use() const {
+	GLState::UseProgram(programID);
+}
+
+void ShaderProgram::Destroy() {
+	DiscardReload();
+	if (programID != 0) {
+		GLState::DeleteProgram(programID);
+		programID = 0;
+	}
+	uniforms.clear();
+	uniformBlocks.clear();
+}
+
+//Records the new stamps right away, so one save starts exactly one reload
+bool ShaderProgram::SourcesChanged() {
+	if (vertexFile.empty()) {
+		return false;
+	}
+	long long vertex = GetFileStamp(vertexFile);
+	long long fragment = GetFileStamp(fragmentFile);
+	if (vertex == vertexStamp && fragment == fragmentStamp) {
+		return false;
+	}
+	vertexStamp = vertex;
+	fragmentStamp = fragment;
+	return true;
+}
+
+bool ShaderProgram::BeginReload() {
+	DiscardReload();
+	reloadStart = SDL_GetPerformanceCounter();
+	std::string vertex_shader_source, fragment_shader_source;
+	if (!ReadSources(vertex_shader_source, fragment_shader_source)) {
+		//Probably still being written, forget the times so the next poll tries again
+		LOG("Could not read shader sources %s / %s, keeping program %u", vertexFile.c_str(), fragmentFile.c_str(), programID);
+		vertexStamp = fragmentStamp = 0;
+		return false;
+	}
+
+	//Going back to a version that was already linked is a cache hit, ready at once
+	pendingKey = ProgramCache::MakeKey({ vertex_shader_source.c_str(), fragment_shader_source.c_str() });
+	pendingProgram = ProgramCache::Load(pendingKey);
+	if (pendingProgram == 0) {
+		const char* sources[2] = { vertex_shader_source.c_str(), fragment_shader_source.c_str() };
+		const unsigned types[2] = { GL_VERTEX_SHADER, GL_FRAGMENT_SHADER };
+		pendingProgram = glCreateProgram();
+		for (int i = 0; i < 2; ++i) {
+			pendingShaders[i] = glCreateShader(types[i]);
+			glShaderSource(pendingShaders[i], 1, &sources[i], nullptr);
+			glCompileShader(pendingShaders[i]);
+			glAttachShader(pendingProgram, pendingShaders[i]);
+		}
+		glProgramParameteri(pendingProgram, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+		//No status is queried here, that would wait for the compiler
+		glLinkProgram(pendingProgram);
+	}
+	return true;
+}
+
+//Without parallel compile support the driver may have compiled synchronously already, otherwise
+//FinishReload waits for it
+bool ShaderProgram::IsReloadComplete() const {
+	if (pendingProgram == 0) {
+		return false;
+	}
+	if (pendingShaders[0] == 0 || !HasParallelCompile()) {
+		return true;
+	}
+	int complete = GL_FALSE;
+	glGetProgramiv(pendingProgram, GL_COMPLETION_STATUS_KHR, &complete);
+	return complete == GL_TRUE;
+}
+
+bool ShaderProgram::FinishReload() {
+	if (pendingProgram == 0) {
+		return false;
+	}
+
+	int linked = GL_FALSE;
+	glGetProgramiv(pendingProgram, GL_LINK_STATUS, &linked);
+	if (linked == GL_FALSE) {
+		if (pendingShaders[0] != 0) {
+			LogShaderInfo(pendingShaders[0], vertexFile);
+			LogShaderInfo(pendingShaders[1], fragmentFile);
+		}
+		int length = 0;
+		glGetProgramiv(pendingProgram, GL_INFO_LOG_LENGTH, &length);
+		std::string info(length > 0 ? length : 1, '\0');
+		glGetProgramInfoLog(pendingProgram, length, nullptr, &info[0]);
+		LOG("Program %s + %s failed to link, keeping program %u: %s", vertexFile.c_str(), fragmentFile.c_str(), programID, info.c_str());
+		DiscardReload();
+		return false;
+	}
+
+	bool compiled = pendingShaders[0] != 0;
+	if (compiled) {
+		ProgramCache::Store(pendingProgram, pendingKey);
+	}
+	unsigned program = pendingProgram;
+	pendingProgram = 0;
+	DiscardReload();
+
+	if (programID != 0) {
+		GLState::DeleteProgram(programID);
+	}
+	programID = program;
+	uniforms.clear();
+	uniformBlocks.clear();
+	Reflect();
+	LOG("Program %s + %s reloaded %s in %.2f ms", vertexFile.c_str(), fragmentFile.c_str(), compiled ? "from source" : "from cache",
+		(SDL_GetPerformanceCounter() - reloadStart) * 1000.0f / SDL_GetPerformanceFrequency());
+	return true;
+}
+
+void ShaderProgram::DiscardReload() {
+	for (unsigned& shader : pendingShaders) {
+		if (shader != 0) {
+			glDeleteShader(shader);
+			shader = 0;
+		}
+	}
+	if (pendingProgram != 0) {
+		GLState::DeleteProgram(pendingProgram);
+		pendingProgram = 0;
+	}
+}
+
+void ShaderProgram::Reflect() {
+	int count = 0, maxLength = 0;
+	glGetProgramiv(programID, GL_ACTIVE_UNIFORMS, &count);
+	glGetProgramiv(programID, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+
+	std::string name;
+	name.resize(maxLength);
+	for (int i = 0; i < count; ++i) {
+		int length = 0, size = 0;
+		unsigned type = 0;
+		glGetActiveUniform(programID, i, maxLength, &length, &size, &type, &name[0]);
+
+		std::string uniformName(name.c_str(), length);
+		size_t bracket = uniformName.find("[0]");
+		if (bracket != std::string::npos) {
+			uniformName.erase(bracket);
+		}
+
+		//Members of uniform blocks report location -1, they are reached through the block
+		++lookupCount;
+		uniforms[uniformName] = glGetUniformLocation(programID, uniformName.c_str());
+	}
+
+	glGetProgramiv(programID, GL_ACTIVE_UNIFORM_BLOCKS, &count);
+	glGetProgramiv(programID, GL_ACTIVE_UNIFORM_BLOCK_MAX_NAME_LENGTH, &maxLength);
+	name.resize(maxLength);
+	for (int i = 0; i < count; ++i) {
+		int length = 0;
+		glGetActiveUniformBlockName(programID, i, maxLength, &length, &name[0]);
+		uniformBlocks[std::string(name.c_str(), length)] = i;
+	}
+
+	LOG("Program %u: %i active uniforms, %i uniform blocks", programID, uniforms.size(), uniformBlocks.size());
+}
+
+int ShaderProgram::GetUniformLocation(const char* name) const {
+	const auto& it = uniforms.find(name);
+	if (it != uniforms.end()) {
+		return it->second;
+	}
+
+	//Not active after linking: ask GL once and remember the answer
+	++lookupCount;
+	int location = glGetUniformLocation(programID, name);
+	uniforms[name] = location;
+	return location;
+}
+
+int ShaderProgram::GetUniformBlockIndex(const char* name) const {
+	const auto& it = uniformBlocks.find(name);
+	if (it != uniformBlocks.end()) {
+		return it->second;
+	}
+
+	++lookupCount;
+	int index = glGetUniformBlockIndex(programID, name);
+	uniformBlocks[name] = index;
+	return index;
+}
+
+void ShaderProgram::NewFrame() {
+	lastLookupCount.store(lookupCount, std::memory_order_relaxed);
+	lookupCount = 0;
+}
@@ -0,0 +1,64 @@
+#pragma once
+#include <string>
+#include <unordered_map>
+#include <cstdint>
+#include <atomic>
+
+// Linked GL program that reflects its active uniforms and uniform blocks once after linking,
+// so the draw loop can work with integer handles instead of looking names up every frame.
+class ShaderProgram
+{
+public:
+	ShaderProgram();
+	~ShaderProgram();
+
+	//defines are inserted after the #version line of both sources, one "#define NAME\n" per feature
+	bool Load(const char* vertex_shader_file, const char* fragment_shader_file, const std::string& defines = "");
+	void Use() const;
+	void Destroy();
+
+	inline unsigned GetID() const { return programID; }
+	inline int GetUniformCount() const { return uniforms.size(); }
+	inline int GetUniformBlockCount() const { return uniformBlocks.size(); }
+
+	//Hot reload, driven by ShaderWatcher. SourcesChanged is polled on the main thread, the rest
+	//runs with the context current. BeginReload only issues the compile and link, the driver may
+	//finish them on its own threads. FinishReload swaps the new program in if it linked and keeps
+	//the current one otherwise.
+	bool SourcesChanged();
+	bool BeginReload();
+	bool IsReloadComplete() const;
+	bool FinishReload();
+
+	int GetUniformLocation(const char* name) const;
+	int GetUniformBlockIndex(const char* name) const;
+
+	//Number of glGetUniformLocation/glGetUniformBlockIndex calls issued during the last complete
+	//frame, safe to read from any thread. NewFrame latches and restarts the count on the render thread.
+	static inline unsigned GetLookupCount() { return lastLookupCount.load(std::memory_order_relaxed); }
+	static void NewFrame();
+	//Time spent by every Load so far, compiling or reading the program cache
+	static inline float GetLoadMs() { return loadMs; }
+
+private:
+	void Reflect();
+	void DiscardReload();
+	bool ReadSources(std::string& vertex, std::string& fragment) const;
+
+	unsigned programID = 0;
+	std::string vertexFile;
+	std::string fragmentFile;
+	std::string defines;
+	long long vertexStamp = 0, fragmentStamp = 0; //Write time and size of the sources last loaded
+
+	unsigned pendingProgram = 0;
+	unsigned pendingShaders[2] = { 0, 0 }; //Zero when the pending program came from the cache
+	uint64_t pendingKey = 0;
+	uint64_t reloadStart = 0;
+	mutable std::unordered_map<std::string, int> uniforms;
+	mutable std::unordered_map<std::string, int> uniformBlocks;
+
+	static unsigned lookupCount;
+	static std::atomic<unsigned> lastLookupCount;
+	static float loadMs;
+};
@@ -0,0 +1,90 @@
+#include "ShaderWatcher.h"
+#include "ShaderProgram.h"
+#include "RenderThread.h"
+#include "Globals.h"
+#include "SDL.h"
+#include <GL/glew.h>
+
+ShaderWatcher::ShaderWatcher() {
+
+}
+
+ShaderWatcher::~ShaderWatcher() {
+
+}
+
+void ShaderWatcher::Init() {
+	//0xFFFFFFFF leaves the thread count to the implementation
+	if (GLEW_KHR_parallel_shader_compile) {
+		glMaxShaderCompilerThreadsKHR(0xFFFFFFFF);
+		parallel = true;
+	}
+	else if (GLEW_ARB_parallel_shader_compile) {
+		glMaxShaderCompilerThreadsARB(0xFFFFFFFF);
+		parallel = true;
+	}
+	LOG("Shader hot reload: %s", parallel ? "parallel compile" : "no parallel compile, reloads may stall a frame");
+	lastPoll = SDL_GetTicks();
+}
+
+void ShaderWatcher::Watch(ShaderProgram* program) {
+	for (const Entry& entry : entries) {
+		if (entry.program == program) {
+			return;
+		}
+	}
+	entries.emplace_back(program);
+}
+
+void ShaderWatcher::Update(RenderThread* renderThread) {
+	unsigned now = SDL_GetTicks();
+	bool poll = now - lastPoll >= SHADER_WATCH_INTERVAL;
+	if (poll) {
+		lastPoll = now;
+	}
+
+	for (Entry& entry : entries) {
+		Entry* watched = &entry;
+		switch (entry.state) {
+		case IDLE:
+			if (poll && entry.program->SourcesChanged()) {
+				entry.state = COMPILING;
+				renderThread->Record([watched]() {
+					if (!watched->program->BeginReload()) {
+						watched->state = IDLE;
+					}
+				});
+			}
+			break;
+		case COMPILING:
+			//Replayed after the command that started the compile, never before it
+			renderThread->Record([watched]() {
+				if (watched->program->IsReloadComplete()) {
+					watched->state = READY;
+				}
+			});
+			break;
+		case READY:
+			renderThread->Invoke([this, watched]() {
+				if (watched->program->FinishReload()) {
+					++reloads;
+				}
+				else {
+					++failures;
+				}
+			});
+			entry.state = IDLE;
+			break;
+		}
+	}
+}
+
+unsigned ShaderWatcher::GetPendingCount() const {
+	unsigned pending = 0;
+	for (const Entry& entry : entries) {
+		if (entry.state != IDLE) {
+			++pending;
+		}
+	}
+	return pending;
+}
@@ -0,0 +1,50 @@
+#pragma once
+#include <list>
+#include <atomic>
+
+class ShaderProgram;
+class RenderThread;
+
+//Time between two looks at the modification times of the watched sources
+#define SHADER_WATCH_INTERVAL 500
+
+// Reloads programs whose source files change on disk, so shaders can be edited while the engine runs.
+// Files are polled on the main thread. A changed program is compiled and linked by a recorded command,
+// and with GL_KHR_parallel_shader_compile the driver does that on its own threads while later frames
+// poll GL_COMPLETION_STATUS_KHR. Once it is done the program is swapped in by Invoke, so no frame in
+// flight still refers to the old one. If it fails to compile or link, the old program stays.
+class ShaderWatcher
+{
+public:
+	ShaderWatcher();
+	~ShaderWatcher();
+
+	//Context current: lets the driver use as many compiler threads as it likes
+	void Init();
+	//Watching a program twice is ignored
+	void Watch(ShaderProgram* program);
+	//Main thread, once per frame before anything is recorded
+	void Update(RenderThread* renderThread);
+
+	inline bool IsParallel() const { return parallel; }
+	inline unsigned GetReloadCount() const { return reloads; }
+	inline unsigned GetFailedCount() const { return failures; }
+	unsigned GetPendingCount() const;
+
+private:
+	enum State { IDLE, COMPILING, READY };
+
+	//State is written by the render thread when the compile is started or found complete
+	struct Entry
+	{
+		Entry(ShaderProgram* program) : program(program), state(IDLE) {}
+		ShaderProgram* program;
+		std::atomic<int> state;
+	};
+
+	std::list<Entry> entries; //Recorded commands keep pointers to entries, they must not move
+	bool parallel = false;
+	unsigned lastPoll = 0;
+	unsigned reloads = 0;
+	unsigned failures = 0;
+};
@@ -0,0 +1,592 @@
+#include "SoftwareRasterizer.h"
+#include "Globals.h"
+#include "GLState.h"
+#include "RenderQueue.h"
+#include "LightClusters.h"
+#include "Material.h"
+#include "Mesh.h"
+#include "ShaderPermutations.h"
+#include "Math/float3x3.h"
+#include "SDL.h"
+#include <GL/glew.h>
+#include <immintrin.h>
+#include <future>
+#include <atomic>
+#include <thread>
+#include <algorithm>
+#include <cmath>
+
+//Same clear color as ModuleOpenGL, packed RGBA8
+#define SOFTWARE_CLEAR_COLOR 0xFF1A4D66u
+
+static float3 Normalize(const float3& v) {
+	float length = v.Length();
+	return length > 0.0f ? v / length : v;
+}
+
+static float Saturate(float value) {
+	return std::min(std::max(value, 0.0f), 1.0f);
+}
+
+static float SmoothStep(float edge0, float edge1, float x) {
+	float t = Saturate((x - edge0) / (edge1 - edge0));
+	return t * t * (3.0f - 2.0f * t);
+}
+
+//GLSL's reflect
+static float3 Reflect(const float3& incident, const float3& normal) {
+	return incident - 2.0f * normal.Dot(incident) * normal;
+}
+
+static uint32_t PackColor(const float3& color) {
+	uint32_t r = (uint32_t)(Saturate(color.x) * 255.0f + 0.5f);
+	uint32_t g = (uint32_t)(Saturate(color.y) * 255.0f + 0.5f);
+	uint32_t b = (uint32_t)(Saturate(color.z) * 255.0f + 0.5f);
+	return r | (g << 8) | (b << 16) | 0xFF000000u;
+}
+
+SoftwareRasterizer::SoftwareRasterizer() {
+	threadCount = std::max(std::thread::hardware_concurrency(), 1u);
+}
+
+SoftwareRasterizer::~SoftwareRasterizer() {
+
+}
+
+void SoftwareRasterizer::Prepare(const GeometryArena& arena, const std::vector<unsigned>& textureNames) {
+	vertices.resize(arena.GetVertexCount());
+	indices.resize(arena.GetIndexCount());
+	glBindBuffer(GL_COPY_READ_BUFFER, arena.GetVBO());
+	glGetBufferSubData(GL_COPY_READ_BUFFER, 0, sizeof(ArenaVertex) * vertices.size(), vertices.data());
+	glBindBuffer(GL_COPY_READ_BUFFER, arena.GetEBO());
+	glGetBufferSubData(GL_COPY_READ_BUFFER, 0, sizeof(unsigned) * indices.size(), indices.data());
+	glBindBuffer(GL_COPY_READ_BUFFER, 0);
+
+	//Compressed maps come back decompressed, the top mip is all the sampler below uses
+	textures.clear();
+	for (unsigned name : textureNames) {
+		if (name == 0 || textures.count(name) != 0) {
+			continue;
+		}
+		GLint width = 0, height = 0;
+		glGetTextureLevelParameteriv(name, 0, GL_TEXTURE_WIDTH, &width);
+		glGetTextureLevelParameteriv(name, 0, GL_TEXTURE_HEIGHT, &height);
+		if (width <= 0 || height <= 0) {
+			continue;
+		}
+		Texture& texture = textures[name];
+		texture.width = width;
+		texture.height = height;
+		texture.texels.resize(width * height);
+		glGetTextureImage(name, 0, GL_RGBA, GL_UNSIGNED_BYTE, sizeof(uint32_t) * texture.texels.size(), texture.texels.data());
+	}
+
+	LOG("Software rasterizer: %u vertices, %u indices, %u textures", (unsigned)vertices.size(), (unsigned)indices.size(), (unsigned)textures.size());
+	prepared = true;
+}
+
+void SoftwareRasterizer::Render(const RenderQueue& queue, const SoftwareFrame& frame, const LightClusters& clusters) {
+	Uint64 start = SDL_GetPerformanceCounter();
+	this->frame = frame;
+	this->clusters = &clusters;
+	Resize(frame.width, frame.height);
+
+	//One material per packet, every visible instance becomes an item
+	materials.clear();
+	items.clear();
+	std::vector<unsigned> itemTriangles;
+	unsigned totalTriangles = 0;
+	const std::vector<unsigned>& visible = queue.GetVisibleInstances();
+	for (const DrawPacket& packet : queue.GetPackets()) {
+		ShadingMaterial material;
+		material.baseColor = FindTexture(packet.material->baseColor);
+		material.occlusionRoughnessMetallic = FindTexture(packet.material->occlusionRoughnessMetallic);
+		if (ShaderPermutations::GetFeatures(*packet.mesh, *packet.material) & SHADER_FEATURE_HAS_NORMAL_MAP) {
+			material.normal = FindTexture(packet.material->normal);
+		}
+		material.diffuseConstant = packet.material->diffuseConstant;
+		material.specularConstant = packet.material->specularConstant;
+		material.shininess = packet.material->shininess;
+		materials.push_back(material);
+
+		const std::vector<float4x4>* instances = packet.mesh->GetInstances();
+		const unsigned triangles = packet.range.indexCount / 3;
+		for (unsigned i = 0; i < packet.visibleCount; ++i) {
+			DrawItem item;
+			item.range = packet.range;
+			item.world = &instances->at(visible[packet.firstVisible + i] - packet.mesh->GetFirstInstance());
+			item.material = materials.size() - 1;
+			items.push_back(item);
+			itemTriangles.push_back(triangles);
+			totalTriangles += triangles;
+		}
+	}
+
+	//Chunks end once they reach their share of triangles, the last one takes whatever is left
+	chunks.resize(threadCount);
+	const unsigned perChunk = totalTriangles / threadCount + 1;
+	unsigned item = 0;
+	for (unsigned c = 0; c < threadCount; ++c) {
+		chunks[c].firstItem = item;
+		unsigned count = 0;
+		while (item < items.size() && (count < perChunk || c == threadCount - 1)) {
+			count += itemTriangles[item++];
+		}
+		chunks[c].lastItem = item;
+	}
+
+	std::vector<std::future<void>> jobs;
+	for (unsigned c = 1; c < threadCount; ++c) {
+		jobs.push_back(std::async(std::launch::async, [this, c]() { SetupChunk(chunks[c]); }));
+	}
+	SetupChunk(chunks[0]);
+	for (std::future<void>& job : jobs) {
+		job.wait();
+	}
+	Uint64 setupEnd = SDL_GetPerformanceCounter();
+
+	triangleCount = 0;
+	binnedCount = 0;
+	for (const Chunk& chunk : chunks) {
+		triangleCount += chunk.triangles.size();
+		for (const std::vector<unsigned>& bin : chunk.bins) {
+			binnedCount += bin.size();
+		}
+	}
+
+	//Tiles are handed out one at a time, busy tiles do not hold the rest of a static split back
+	std::atomic<unsigned> nextTile(0);
+	const unsigned tileCount = tilesX * tilesY;
+	auto worker = [this, &nextTile, tileCount]() {
+		for (unsigned tile = nextTile++; tile < tileCount; tile = nextTile++) {
+			RasterTile(tile);
+		}
+	};
+	jobs.clear();
+	for (unsigned i = 1; i < threadCount; ++i) {
+		jobs.push_back(std::async(std::launch::async, worker));
+	}
+	worker();
+	for (std::future<void>& job : jobs) {
+		job.wait();
+	}
+	Uint64 end = SDL_GetPerformanceCounter();
+
+	const float frequency = (float)SDL_GetPerformanceFrequency();
+	setupMs = (setupEnd - start) * 1000.0f / frequency;
+	rasterMs = (end - setupEnd) * 1000.0f / frequency;
+	totalMs = (end - start) * 1000.0f / frequency;
+	writeBuffer = 1 - writeBuffer;
+}
+
+void SoftwareRasterizer::Resize(unsigned width, unsigned height) {
+	tilesX = (width + SOFTWARE_TILE_SIZE - 1) / SOFTWARE_TILE_SIZE;
+	tilesY = (height + SOFTWARE_TILE_SIZE - 1) / SOFTWARE_TILE_SIZE;
+
+	//Padded to whole tiles, quads past the right edge write into the padding
+	ColorBuffer& color = colorBuffers[writeBuffer];
+	color.width = width;
+	color.height = height;
+	color.stride = tilesX * SOFTWARE_TILE_SIZE;
+	color.pixels.resize(color.stride * tilesY * SOFTWARE_TILE_SIZE);
+	depthBuffer.resize(color.pixels.size());
+}
+
+void SoftwareRasterizer::SetupChunk(Chunk& chunk) {
+	chunk.triangles.clear();
+	chunk.bins.resize(tilesX * tilesY);
+	for (std::vector<unsigned>& bin : chunk.bins) {
+		bin.clear();
+	}
+
+	for (unsigned i = chunk.firstItem; i < chunk.lastItem; ++i) {
+		const DrawItem& item = items[i];
+		const GeometryRange& range = item.range;
+		if (range.baseVertex + range.firstVertex + range.vertexCount > vertices.size() || range.firstIndex + range.indexCount > indices.size()) {
+			continue;
+		}
+
+		//Same transforms as VertexShader.glsl, only for the vertices the range references: a run of
+		//static batch parts would otherwise transform the whole batch once per run
+		const float4x4& world = *item.world;
+		const float3x3 normalMatrix = world.Float3x3Part().InverseTransposed();
+		const ArenaVertex* rangeVertices = vertices.data() + range.baseVertex + range.firstVertex;
+		chunk.vertices.resize(range.vertexCount);
+		for (unsigned v = 0; v < range.vertexCount; ++v) {
+			const ArenaVertex& source = rangeVertices[v];
+			ClipVertex& vertex = chunk.vertices[v];
+			vertex.world = world.TransformPos(source.position);
+			vertex.clip = frame.viewProj * float4(vertex.world, 1.0f);
+			vertex.normal = normalMatrix * source.normal;
+			vertex.uv = source.uv;
+		}
+
+		const unsigned* triangleIndices = &indices[range.firstIndex];
+		const unsigned first = range.firstVertex;
+		for (unsigned t = 0; t + 2 < range.indexCount; t += 3) {
+			const ClipVertex triangle[3] = { chunk.vertices[triangleIndices[t] - first], chunk.vertices[triangleIndices[t + 1] - first], chunk.vertices[triangleIndices[t + 2] - first] };
+
+			//Entirely outside one of the other planes, what is left is only partly outside and the
+			//bounding box clamp takes care of it
+			bool outside = false;
+			for (int axis = 0; axis < 3 && !outside; ++axis) {
+				outside = (triangle[0].clip[axis] > triangle[0].clip.w && triangle[1].clip[axis] > triangle[1].clip.w && triangle[2].clip[axis] > triangle[2].clip.w)
+					|| (axis < 2 && triangle[0].clip[axis] < -triangle[0].clip.w && triangle[1].clip[axis] < -triangle[1].clip.w && triangle[2].clip[axis] < -triangle[2].clip.w);
+			}
+			if (outside) {
+				continue;
+			}
+
+			int inside = 0;
+			for (int k = 0; k < 3; ++k) {
+				inside += triangle[k].clip.z >= -triangle[k].clip.w ? 1 : 0;
+			}
+			if (inside == 3) {
+				SetupTriangle(chunk, triangle[0], triangle[1], triangle[2], item.material);
+			}
+			else if (inside > 0) {
+				ClipVertex polygon[4];
+				int count = ClipNear(triangle, polygon);
+				for (int k = 1; k + 1 < count; ++k) {
+					SetupTriangle(chunk, polygon[0], polygon[k], polygon[k + 1], item.material);
+				}
+			}
+		}
+	}
+}
+
+int SoftwareRasterizer::ClipNear(const ClipVertex* triangle, ClipVertex* polygon) {
+	int count = 0;
+	for (int k = 0; k < 3; ++k) {
+		const ClipVertex& a = triangle[k];
+		const ClipVertex& b = triangle[(k + 1) % 3];
+		const float distanceA = a.clip.z + a.clip.w;
+		const float distanceB = b.clip.z + b.clip.w;
+		if (distanceA >= 0.0f) {
+			polygon[count++] = a;
+		}
+		if ((distanceA >= 0.0f) != (distanceB >= 0.0f)) {
+			const float t = distanceA / (distanceA - distanceB);
+			ClipVertex& vertex = polygon[count++];
+			vertex.clip = a.clip + (b.clip - a.clip) * t;
+			vertex.world = a.world + (b.world - a.world) * t;
+			vertex.normal = a.normal + (b.normal - a.normal) * t;
+			vertex.uv = a.uv + (b.uv - a.uv) * t;
+		}
+	}
+	return count;
+}
+
+void SoftwareRasterizer::SetupTriangle(Chunk& chunk, const ClipVertex& a, const ClipVertex& b, const ClipVertex& c, unsigned material) const {
+	const ClipVertex* vertex[3] = { &a, &b, &c };
+	Triangle triangle;
+	float x[3], y[3];
+	for (int k = 0; k < 3; ++k) {
+		const float inverseW = 1.0f / vertex[k]->clip.w;
+		x[k] = (vertex[k]->clip.x * inverseW * 0.5f + 0.5f) * frame.width;
+		y[k] = (vertex[k]->clip.y * inverseW * 0.5f + 0.5f) * frame.height;
+		triangle.z[k] = vertex[k]->clip.z * inverseW * 0.5f + 0.5f;
+		triangle.inverseW[k] = inverseW;
+		float* attributes = triangle.attributes[k];
+		attributes[0] = vertex[k]->world.x * inverseW;
+		attributes[1] = vertex[k]->world.y * inverseW;
+		attributes[2] = vertex[k]->world.z * inverseW;
+		attributes[3] = vertex[k]->normal.x * inverseW;
+		attributes[4] = vertex[k]->normal.y * inverseW;
+		attributes[5] = vertex[k]->normal.z * inverseW;
+		attributes[6] = vertex[k]->uv.x * inverseW;
+		attributes[7] = vertex[k]->uv.y * inverseW;
+	}
+
+	//Window y goes up, so counter clockwise front faces have a positive area
+	const float area = (x[1] - x[0]) * (y[2] - y[0]) - (x[2] - x[0]) * (y[1] - y[0]);
+	if (!(area > 0.0f)) {
+		return;
+	}
+
+	triangle.minX = std::max((int)floorf(std::min(std::min(x[0], x[1]), x[2])), 0);
+	triangle.minY = std::max((int)floorf(std::min(std::min(y[0], y[1]), y[2])), 0);
+	triangle.maxX = std::min((int)ceilf(std::max(std::max(x[0], x[1]), x[2])), (int)frame.width - 1);
+	triangle.maxY = std::min((int)ceilf(std::max(std::max(y[0], y[1]), y[2])), (int)frame.height - 1);
+	if (triangle.minX > triangle.maxX || triangle.minY > triangle.maxY) {
+		return;
+	}
+
+	//Edge k runs between the other two vertices, its value over the area is vertex k's weight.
+	//Pixels exactly on an edge belong to the triangle only for top and left edges, as in GL.
+	for (int k = 0; k < 3; ++k) {
+		const int i = (k + 1) % 3, j = (k + 2) % 3;
+		triangle.edgeA[k] = y[i] - y[j];
+		triangle.edgeB[k] = x[j] - x[i];
+		triangle.edgeC[k] = x[i] * y[j] - x[j] * y[i];
+		const float dy = y[j] - y[i], dx = x[j] - x[i];
+		triangle.topLeft[k] = dy < 0.0f || (dy == 0.0f && dx < 0.0f);
+	}
+	triangle.inverseArea = 1.0f / area;
+	triangle.material = material;
+
+	const unsigned index = chunk.triangles.size();
+	chunk.triangles.push_back(triangle);
+	for (int tileY = triangle.minY / SOFTWARE_TILE_SIZE; tileY <= triangle.maxY / SOFTWARE_TILE_SIZE; ++tileY) {
+		for (int tileX = triangle.minX / SOFTWARE_TILE_SIZE; tileX <= triangle.maxX / SOFTWARE_TILE_SIZE; ++tileX) {
+			chunk.bins[tileX + tileY * tilesX].push_back(index);
+		}
+	}
+}
+
+void SoftwareRasterizer::RasterTile(unsigned tile) {
+	ColorBuffer& color = colorBuffers[writeBuffer];
+	const int tileX = (tile % tilesX) * SOFTWARE_TILE_SIZE;
+	const int tileY = (tile / tilesX) * SOFTWARE_TILE_SIZE;
+	for (int y = tileY; y < tileY + SOFTWARE_TILE_SIZE; ++y) {
+		std::fill_n(&color.pixels[y * color.stride + tileX], SOFTWARE_TILE_SIZE, SOFTWARE_CLEAR_COLOR);
+		std::fill_n(&depthBuffer[y * color.stride + tileX], SOFTWARE_TILE_SIZE, 1.0f);
+	}
+
+	for (const Chunk& chunk : chunks) {
+		for (unsigned index : chunk.bins[tile]) {
+			const Triangle& triangle = chunk.triangles[index];
+			RasterTriangle(triangle, std::max(triangle.minX, tileX), std::max(triangle.minY, tileY),
+				std::min(triangle.maxX, tileX + SOFTWARE_TILE_SIZE - 1), std::min(triangle.maxY, tileY + SOFTWARE_TILE_SIZE - 1));
+		}
+	}
+}
+
+static inline __m128 EdgeTest(__m128 edge, bool topLeft) {
+	return topLeft ? _mm_cmpge_ps(edge, _mm_setzero_ps()) : _mm_cmpgt_ps(edge, _mm_setzero_ps());
+}
+
+void SoftwareRasterizer::RasterTriangle(const Triangle& triangle, int minX, int minY, int maxX, int maxY) {
+	ColorBuffer& color = colorBuffers[writeBuffer];
+	const __m128 laneCenters = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+	const __m128i laneIndices = _mm_setr_epi32(0, 1, 2, 3);
+	const __m128i laneBits = _mm_setr_epi32(1, 2, 4, 8);
+	const __m128i firstX = _mm_set1_epi32(minX - 1), lastX = _mm_set1_epi32(maxX + 1);
+	const __m128 inverseArea = _mm_set1_ps(triangle.inverseArea);
+	const __m128 z0 = _mm_set1_ps(triangle.z[0]);
+	const __m128 z10 = _mm_set1_ps(triangle.z[1] - triangle.z[0]);
+	const __m128 z20 = _mm_set1_ps(triangle.z[2] - triangle.z[0]);
+	__m128 edgeA[3];
+	for (int k = 0; k < 3; ++k) {
+		edgeA[k] = _mm_set1_ps(triangle.edgeA[k]);
+	}
+
+	alignas(16) float weights1[4], weights2[4];
+	for (int y = minY; y <= maxY; ++y) {
+		const float centerY = y + 0.5f;
+		__m128 rowEdge[3];
+		for (int k = 0; k < 3; ++k) {
+			rowEdge[k] = _mm_set1_ps(triangle.edgeB[k] * centerY + triangle.edgeC[k]);
+		}
+
+		for (int x = minX & ~3; x <= maxX; x += 4) {
+			const __m128 centerX = _mm_add_ps(_mm_set1_ps((float)x), laneCenters);
+			__m128 edge[3];
+			for (int k = 0; k < 3; ++k) {
+				edge[k] = _mm_add_ps(_mm_mul_ps(edgeA[k], centerX), rowEdge[k]);
+			}
+			const __m128i lane = _mm_add_epi32(_mm_set1_epi32(x), laneIndices);
+			const __m128i inRange = _mm_and_si128(_mm_cmpgt_epi32(lane, firstX), _mm_cmplt_epi32(lane, lastX));
+			__m128 inside = _mm_and_ps(_mm_and_ps(EdgeTest(edge[0], triangle.topLeft[0]), EdgeTest(edge[1], triangle.topLeft[1])), EdgeTest(edge[2], triangle.topLeft[2]));
+			int mask = _mm_movemask_ps(_mm_and_ps(inside, _mm_castsi128_ps(inRange)));
+			if (mask == 0) {
+				continue;
+			}
+
+			//Screen space z is linear, no 1/w correction needed
+			const __m128 weight1 = _mm_mul_ps(edge[1], inverseArea);
+			const __m128 weight2 = _mm_mul_ps(edge[2], inverseArea);
+			const __m128 z = _mm_add_ps(z0, _mm_add_ps(_mm_mul_ps(weight1, z10), _mm_mul_ps(weight2, z20)));
+			float* depth = &depthBuffer[y * color.stride + x];
+			const __m128 stored = _mm_loadu_ps(depth);
+			mask &= _mm_movemask_ps(_mm_cmplt_ps(z, stored));
+			if (mask == 0) {
+				continue;
+			}
+			const __m128 written = _mm_castsi128_ps(_mm_cmpgt_epi32(_mm_and_si128(_mm_set1_epi32(mask), laneBits), _mm_setzero_si128()));
+			_mm_storeu_ps(depth, _mm_or_ps(_mm_and_ps(written, z), _mm_andnot_ps(written, stored)));
+
+			_mm_store_ps(weights1, weight1);
+			_mm_store_ps(weights2, weight2);
+			uint32_t* pixels = &color.pixels[y * color.stride + x];
+			for (int i = 0; i < 4; ++i) {
+				if (mask & (1 << i)) {
+					pixels[i] = Shade(triangle, weights1[i], weights2[i], x + i, y);
+				}
+			}
+		}
+	}
+}
+
+void SoftwareRasterizer::Interpolate(const Triangle& triangle, float weight1, float weight2, float* attributes) {
+	const float weight0 = 1.0f - weight1 - weight2;
+	const float w = 1.0f / (weight0 * triangle.inverseW[0] + weight1 * triangle.inverseW[1] + weight2 * triangle.inverseW[2]);
+	for (int k = 0; k < 8; ++k) {
+		attributes[k] = (weight0 * triangle.attributes[0][k] + weight1 * triangle.attributes[1][k] + weight2 * triangle.attributes[2][k]) * w;
+	}
+}
+
+//FragmentShader.glsl's NormalFromMap. The derivatives are the attributes one pixel right and one
+//pixel up minus these, the weights there follow from the edge functions.
+float3 SoftwareRasterizer::NormalFromMap(const Triangle& triangle, float weight1, float weight2, const float* attributes, const float3& normal, const Texture* texture) const {
+	float right[8], up[8];
+	Interpolate(triangle, weight1 + triangle.edgeA[1] * triangle.inverseArea, weight2 + triangle.edgeA[2] * triangle.inverseArea, right);
+	Interpolate(triangle, weight1 + triangle.edgeB[1] * triangle.inverseArea, weight2 + triangle.edgeB[2] * triangle.inverseArea, up);
+	const float3 positionDx(right[0] - attributes[0], right[1] - attributes[1], right[2] - attributes[2]);
+	const float3 positionDy(up[0] - attributes[0], up[1] - attributes[1], up[2] - attributes[2]);
+	const float2 uvDx(right[6] - attributes[6], right[7] - attributes[7]);
+	const float2 uvDy(up[6] - attributes[6], up[7] - attributes[7]);
+
+	const float determinant = uvDx.x * uvDy.y - uvDy.x * uvDx.y;
+	if (fabsf(determinant) < 1e-12f) {
+		return normal;
+	}
+	const float3 t_ = (uvDy.y * positionDx - uvDx.y * positionDy) / determinant;
+	const float3 t = Normalize(t_ - normal * normal.Dot(t_));
+	const float3 b = normal.Cross(t);
+	const float4 texel = Sample(texture, float2(attributes[6], attributes[7]));
+	const float tx = texel.x * 2.0f - 1.0f, ty = texel.y * 2.0f - 1.0f;
+	const float tz = sqrtf(std::max(1.0f - tx * tx - ty * ty, 0.0f));
+	return Normalize(t * tx + b * ty + normal * tz);
+}
+
+//FragmentShader.glsl's main, term by term
+uint32_t SoftwareRasterizer::Shade(const Triangle& triangle, float weight1, float weight2, int x, int y) const {
+	float attributes[8];
+	Interpolate(triangle, weight1, weight2, attributes);
+	const float3 position(attributes[0], attributes[1], attributes[2]);
+	float3 normal = Normalize(float3(attributes[3], attributes[4], attributes[5]));
+	const float2 uv(attributes[6], attributes[7]);
+
+	const ShadingMaterial& material = materials[triangle.material];
+	if (material.normal != nullptr) {
+		normal = NormalFromMap(triangle, weight1, weight2, attributes, normal, material.normal);
+	}
+	const float3 diffuseColor = Sample(material.baseColor, uv).xyz();
+	const float occlusion = Sample(material.occlusionRoughnessMetallic, uv).x;
+	const float3 lightDirection = Normalize(frame.lightDirection);
+
+	float3 color = frame.ambientColor.Mul(diffuseColor) * occlusion + ClusteredLights(normal, position, diffuseColor, material, x, y);
+	const float NdotL = std::max(normal.Dot(lightDirection), 0.0f);
+	if (NdotL > 0.0f) {
+		const float3 V = Normalize(position - frame.cameraPosition);
+		const float3 R = Reflect(lightDirection, normal);
+		const float RdotV = std::max(R.Dot(V), 0.0f);
+		color += material.diffuseConstant * diffuseColor.Mul(frame.lightColor) * NdotL;
+		color += material.specularConstant * frame.lightColor * powf(RdotV, material.shininess);
+	}
+	return PackColor(color);
+}
+
+float3 SoftwareRasterizer::ClusteredLights(const float3& normal, const float3& position, const float3& diffuseColor, const ShadingMaterial& material, int x, int y) const {
+	float3 result = float3::zero;
+	const std::vector<unsigned>& clusterData = clusters->GetClusters();
+	if (clusterData.empty()) {
+		return result;
+	}
+
+	const float depth = (position - frame.cameraPosition).Dot(frame.cameraFront);
+	const float slice = std::min(std::max(floorf(logf(std::max(depth, frame.clusterDepth.x)) * frame.clusterDepth.z + frame.clusterDepth.w), 0.0f), (float)(CLUSTER_Z - 1));
+	const int tileX = std::min(std::max((int)((x + 0.5f) / frame.width * CLUSTER_X), 0), CLUSTER_X - 1);
+	const int tileY = std::min(std::max((int)((y + 0.5f) / frame.height * CLUSTER_Y), 0), CLUSTER_Y - 1);
+	const unsigned cluster = tileX + tileY * CLUSTER_X + (unsigned)slice * CLUSTER_X * CLUSTER_Y;
+
+	const std::vector<Light>& lights = clusters->GetLights();
+	const std::vector<unsigned>& lightIndices = clusters->GetIndices();
+	const unsigned offset = clusterData[cluster * 2];
+	const unsigned count = clusterData[cluster * 2 + 1];
+	const float3 V = Normalize(frame.cameraPosition - position);
+	for (unsigned i = 0; i < count; ++i) {
+		const Light& light = lights[lightIndices[offset + i]];
+		float3 L = light.positionRadius.xyz() - position;
+		const float lightDistance = L.Length();
+		L /= lightDistance;
+		const float window = Saturate(1.0f - powf(lightDistance / light.positionRadius.w, 4.0f));
+		float attenuation = window * window / (lightDistance * lightDistance + 1.0f);
+		if (light.directionCosOuter.w > -1.0f) {
+			attenuation *= SmoothStep(light.directionCosOuter.w, light.cosInner.x, (-L).Dot(light.directionCosOuter.xyz()));
+		}
+		const float NdotL = std::max(normal.Dot(L), 0.0f);
+		const float3 radiance = light.colorIntensity.xyz() * light.colorIntensity.w * attenuation;
+		const float3 R = Reflect(-L, normal);
+		const float3 lit = material.diffuseConstant * diffuseColor * NdotL + float3::one * (material.specularConstant * powf(std::max(R.Dot(V), 0.0f), material.shininess));
+		result += lit.Mul(radiance);
+	}
+	return result;
+}
+
+const SoftwareRasterizer::Texture* SoftwareRasterizer::FindTexture(unsigned name) const {
+	auto it = textures.find(name);
+	return it != textures.end() ? &it->second : nullptr;
+}
+
+//Bilinear with GL_REPEAT, on the top mip
+float4 SoftwareRasterizer::Sample(const Texture* texture, const float2& uv) {
+	if (texture == nullptr) {
+		return float4::one;
+	}
+	const float x = uv.x * texture->width - 0.5f;
+	const float y = uv.y * texture->height - 0.5f;
+	const float floorX = floorf(x), floorY = floorf(y);
+	const float fx = x - floorX, fy = y - floorY;
+	const int w = texture->width, h = texture->height;
+	const int x0 = ((int)floorX % w + w) % w, y0 = ((int)floorY % h + h) % h;
+	const int x1 = (x0 + 1) % w, y1 = (y0 + 1) % h;
+
+	auto fetch = [texture](int x, int y) {
+		const uint32_t texel = texture->texels[y * texture->width + x];
+		return float4((float)(texel & 0xFF), (float)((texel >> 8) & 0xFF), (float)((texel >> 16) & 0xFF), (float)(texel >> 24)) * (1.0f / 255.0f);
+	};
+	const float4 top = fetch(x0, y0) * (1.0f - fx) + fetch(x1, y0) * fx;
+	const float4 bottom = fetch(x0, y1) * (1.0f - fx) + fetch(x1, y1) * fx;
+	return top * (1.0f - fy) + bottom * fy;
+}
+
+void SoftwareRasterizer::Present(int buffer, bool split) {
+	const ColorBuffer& source = colorBuffers[buffer];
+	if (source.width == 0 || source.height == 0) {
+		return;
+	}
+
+	GLint target = 0;
+	glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &target);
+
+	//Grows only, frames smaller than the texture use its corner like DynamicResolution
+	if (framebuffer == 0 || source.width > textureWidth || source.height > textureHeight) {
+		glDeleteFramebuffers(1, &framebuffer);
+		GLState::DeleteTextures(1, &colorTexture);
+		textureWidth = std::max(source.width, textureWidth);
+		textureHeight = std::max(source.height, textureHeight);
+		glGenTextures(1, &colorTexture);
+		GLState::BindTexture(0, colorTexture);
+		glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGBA8, textureWidth, textureHeight);
+		glGenFramebuffers(1, &framebuffer);
+		glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
+		glFramebufferTexture2D(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, colorTexture, 0);
+		if (glCheckFramebufferStatus(GL_READ_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+			LOG("Software rasterizer: framebuffer %ux%u is incomplete", textureWidth, textureHeight);
+		}
+	}
+
+	GLState::BindTexture(0, colorTexture);
+	glPixelStorei(GL_UNPACK_ROW_LENGTH, source.stride);
+	glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, source.width, source.height, GL_RGBA, GL_UNSIGNED_BYTE, source.pixels.data());
+	glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+
+	const unsigned left = split ? source.width / 2 : 0;
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, target);
+	glBlitFramebuffer(left, 0, source.width, source.height, left, 0, source.width, source.height, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+	glBindFramebuffer(GL_FRAMEBUFFER, target);
+}
+
+void SoftwareRasterizer::Destroy() {
+	glDeleteFramebuffers(1, &framebuffer);
+	GLState::DeleteTextures(1, &colorTexture);
+	framebuffer = colorTexture = 0;
+	textureWidth = textureHeight = 0;
+	vertices.clear();
+	indices.clear();
+	textures.clear();
+	prepared = false;
+}
@@ -0,0 +1,164 @@
+#pragma once
+#include <vector>
+#include <unordered_map>
+#include <cstdint>
+#include "Math/float2.h"
+#include "Math/float3.h"
+#include "Math/float4.h"
+#include "Math/float4x4.h"
+#include "GeometryArena.h"
+
+class Mesh;
+class RenderQueue;
+class LightClusters;
+struct Material;
+
+//Square tiles, a multiple of 4 so SSE quads never straddle two of them
+#define SOFTWARE_TILE_SIZE 64
+
+//The part of the Frame block the software backend shades with
+struct SoftwareFrame
+{
+	float4x4 viewProj;
+	float3 cameraPosition;
+	float3 cameraFront;
+	float3 lightColor;
+	float3 lightDirection;
+	float3 ambientColor;
+	float4 clusterDepth;
+	unsigned width = 0, height = 0;
+};
+
+// CPU renderer for the same RenderQueue the GL backend submits, for machines without a GPU and to
+// compare output and throughput with it.
+// Geometry: the visible instances are split into chunks of about the same triangle count, one per
+// core. Each chunk transforms its vertices, clips against the near plane, culls back faces and bins
+// the triangles into SOFTWARE_TILE_SIZE tiles.
+// Raster: cores take tiles one at a time. Edge functions and depth are evaluated for 4 pixels at once
+// with SSE, covered pixels interpolate 1/w corrected attributes and run the Phong terms of
+// FragmentShader.glsl, clustered lights and normal maps included. Normal map derivatives are exact
+// per pixel rather than taken across a 2x2 quad, so edges of the frame can differ slightly. Chunks are walked in order, so draw order holds.
+// Geometry and textures are read back from GL once by Prepare, the rest never touches the GPU.
+class SoftwareRasterizer
+{
+public:
+	SoftwareRasterizer();
+	~SoftwareRasterizer();
+
+	//Render thread: copies the arena and the given textures to memory
+	void Prepare(const GeometryArena& arena, const std::vector<unsigned>& textureNames);
+	inline void Invalidate() { prepared = false; }
+	inline bool IsPrepared() const { return prepared; }
+
+	//Main thread, after the queue is sorted and the lights binned
+	void Render(const RenderQueue& queue, const SoftwareFrame& frame, const LightClusters& clusters);
+	//Render thread: blits the last rendered frame into the bound draw framebuffer, only its right half when split
+	void Present(int buffer, bool split);
+	void Destroy();
+
+	inline int GetPresentBuffer() const { return 1 - writeBuffer; }
+	inline unsigned GetThreadCount() const { return threadCount; }
+	inline unsigned GetTriangleCount() const { return triangleCount; }
+	inline unsigned GetBinnedCount() const { return binnedCount; }
+	inline float GetSetupMs() const { return setupMs; }
+	inline float GetRasterMs() const { return rasterMs; }
+	inline float GetTotalMs() const { return totalMs; }
+
+private:
+	struct Texture
+	{
+		unsigned width = 0, height = 0;
+		std::vector<uint32_t> texels; //RGBA8, first row is v = 0 like in GL
+	};
+
+	struct ShadingMaterial
+	{
+		const Texture* baseColor = nullptr; //Null samples as white
+		const Texture* occlusionRoughnessMetallic = nullptr;
+		const Texture* normal = nullptr; //Only set when the GL side draws this packet with HAS_NORMAL_MAP
+		float diffuseConstant = 0.0f;
+		float specularConstant = 0.0f;
+		float shininess = 1.0f;
+	};
+
+	struct DrawItem
+	{
+		GeometryRange range; //Static batches draw only part of their mesh's indices
+		const float4x4* world = nullptr;
+		unsigned material = 0;
+	};
+
+	struct ClipVertex
+	{
+		float4 clip;
+		float3 world;
+		float3 normal;
+		float2 uv;
+	};
+
+	//Attributes are stored over w, so interpolating them linearly in screen space is perspective correct
+	struct Triangle
+	{
+		float edgeA[3], edgeB[3], edgeC[3]; //Edge opposite each vertex, positive inside
+		bool topLeft[3];
+		float inverseArea;
+		float z[3], inverseW[3];
+		float attributes[3][8]; //world xyz, normal xyz, uv, all divided by w
+		int minX, minY, maxX, maxY;
+		unsigned material;
+	};
+
+	struct Chunk
+	{
+		unsigned firstItem = 0, lastItem = 0;
+		std::vector<ClipVertex> vertices;
+		std::vector<Triangle> triangles;
+		std::vector<std::vector<unsigned>> bins; //Triangle indices per tile
+	};
+
+	struct ColorBuffer
+	{
+		std::vector<uint32_t> pixels; //Bottom row first, like a GL framebuffer
+		unsigned width = 0, height = 0, stride = 0;
+	};
+
+	void Resize(unsigned width, unsigned height);
+	void SetupChunk(Chunk& chunk);
+	void SetupTriangle(Chunk& chunk, const ClipVertex& a, const ClipVertex& b, const ClipVertex& c, unsigned material) const;
+	void RasterTile(unsigned tile);
+	void RasterTriangle(const Triangle& triangle, int minX, int minY, int maxX, int maxY);
+	uint32_t Shade(const Triangle& triangle, float weight1, float weight2, int x, int y) const;
+	static void Interpolate(const Triangle& triangle, float weight1, float weight2, float* attributes);
+	float3 NormalFromMap(const Triangle& triangle, float weight1, float weight2, const float* attributes, const float3& normal, const Texture* texture) const;
+	float3 ClusteredLights(const float3& normal, const float3& position, const float3& diffuseColor, const ShadingMaterial& material, int x, int y) const;
+	const Texture* FindTexture(unsigned name) const;
+	static float4 Sample(const Texture* texture, const float2& uv);
+	//Cuts the part behind the near plane (z < -w), returns the vertex count of the polygon left
+	static int ClipNear(const ClipVertex* triangle, ClipVertex* polygon);
+
+	bool prepared = false;
+	std::vector<ArenaVertex> vertices;
+	std::vector<unsigned> indices;
+	std::unordered_map<unsigned, Texture> textures;
+
+	SoftwareFrame frame;
+	const LightClusters* clusters = nullptr;
+	std::vector<ShadingMaterial> materials;
+	std::vector<DrawItem> items;
+	std::vector<Chunk> chunks;
+	unsigned threadCount = 1;
+	unsigned tilesX = 0, tilesY = 0;
+	ColorBuffer colorBuffers[2]; //One is rendered while the render thread presents the other
+	int writeBuffer = 0;
+	std::vector<float> depthBuffer;
+
+	unsigned triangleCount = 0;
+	unsigned binnedCount = 0;
+	float setupMs = 0.0f;
+	float rasterMs = 0.0f;
+	float totalMs = 0.0f;
+
+	unsigned framebuffer = 0;
+	unsigned colorTexture = 0;
+	unsigned textureWidth = 0, textureHeight = 0;
+};
@@ -0,0 +1,117 @@
+#include "StaticBatcher.h"
+#include "Mesh.h"
+#include "Globals.h"
+#include "Math/float3x3.h"
+#include "Geometry/OBB.h"
+#include <algorithm>
+
+StaticBatcher::StaticBatcher() {
+
+}
+
+StaticBatcher::~StaticBatcher() {
+
+}
+
+//Read through a Mesh that is never uploaded, so batched primitives are parsed exactly like the rest
+void StaticBatcher::Add(const tinygltf::Model& srcModel, const tinygltf::Mesh& srcMesh, const tinygltf::Primitive& primitive, const std::vector<float4x4>& transforms, bool occluder) {
+	Source source;
+	Mesh reader;
+	reader.LoadVBO(srcModel, srcMesh, primitive, source.vertices);
+	reader.LoadEBO(srcModel, srcMesh, primitive, source.indices);
+	source.materialIndex = primitive.material;
+	source.hasUV = reader.HasUV();
+	source.occluder = occluder;
+	source.transforms = transforms;
+	for (const float4x4& transform : transforms) {
+		source.bounds.push_back(reader.GetAABB()->Transform(transform).MinimalEnclosingAABB());
+	}
+
+	++sourceCount;
+	partCount += transforms.size();
+	sourceBytes += source.vertices.size() * sizeof(ArenaVertex) + source.indices.size() * sizeof(unsigned);
+	sources.push_back(std::move(source));
+}
+
+void StaticBatcher::Build(GeometryArena* arena, std::vector<Mesh*>& batches) {
+	//Groups are keyed by material and uv layout, the shader permutation of a draw depends on both
+	std::vector<std::pair<int, bool>> keys;
+	for (const Source& source : sources) {
+		std::pair<int, bool> key(source.materialIndex, source.hasUV);
+		if (std::find(keys.begin(), keys.end(), key) == keys.end()) {
+			keys.push_back(key);
+		}
+	}
+
+	for (const std::pair<int, bool>& key : keys) {
+		//Source and transform of every part in the group
+		std::vector<std::pair<const Source*, unsigned>> parts;
+		AABB groupBounds;
+		groupBounds.SetNegativeInfinity();
+		for (const Source& source : sources) {
+			if (source.materialIndex != key.first || source.hasUV != key.second) {
+				continue;
+			}
+			for (unsigned t = 0; t < source.transforms.size(); ++t) {
+				parts.push_back(std::make_pair(&source, t));
+				groupBounds.Enclose(source.bounds[t]);
+			}
+		}
+
+		float3 size = groupBounds.Size();
+		int axis = size.x >= size.y && size.x >= size.z ? 0 : (size.y >= size.z ? 1 : 2);
+		std::sort(parts.begin(), parts.end(), [axis](const std::pair<const Source*, unsigned>& a, const std::pair<const Source*, unsigned>& b) {
+			return a.first->bounds[a.second].CenterPoint()[axis] < b.first->bounds[b.second].CenterPoint()[axis];
+		});
+
+		std::vector<ArenaVertex> vertices;
+		std::vector<unsigned> indices;
+		std::vector<MeshPart> meshParts;
+		std::vector<float3> occluderPositions;
+		std::vector<unsigned> occluderIndices;
+		for (const std::pair<const Source*, unsigned>& part : parts) {
+			const Source& source = *part.first;
+			const float4x4& world = source.transforms[part.second];
+			const float3x3 normalMatrix = world.Float3x3Part().InverseTransposed();
+			const unsigned baseVertex = vertices.size();
+
+			MeshPart meshPart;
+			meshPart.firstIndex = indices.size();
+			meshPart.indexCount = source.indices.size();
+			meshPart.firstVertex = baseVertex;
+			meshPart.vertexCount = source.vertices.size();
+			meshPart.bounds = source.bounds[part.second];
+			meshParts.push_back(meshPart);
+
+			for (const ArenaVertex& vertex : source.vertices) {
+				ArenaVertex transformed = vertex;
+				transformed.position = world.TransformPos(vertex.position);
+				transformed.normal = (normalMatrix * vertex.normal).Normalized();
+				vertices.push_back(transformed);
+			}
+			for (unsigned index : source.indices) {
+				indices.push_back(baseVertex + index);
+			}
+
+			if (source.occluder) {
+				const unsigned baseOccluder = occluderPositions.size();
+				for (unsigned v = baseVertex; v < vertices.size(); ++v) {
+					occluderPositions.push_back(vertices[v].position);
+				}
+				for (unsigned index : source.indices) {
+					occluderIndices.push_back(baseOccluder + index);
+				}
+			}
+		}
+
+		Mesh* batch = new Mesh();
+		std::string name = "Static batch, material " + std::to_string(key.first) + ", " + std::to_string(meshParts.size()) + " parts";
+		batch->LoadBatch(name, key.first, key.second, vertices, indices, meshParts, arena, occluderPositions, occluderIndices);
+		batches.push_back(batch);
+		batchedBytes += vertices.size() * sizeof(ArenaVertex) + indices.size() * sizeof(unsigned);
+	}
+
+	LOG("Static batching: %u primitives, %u parts in %u batches, %u KB of geometry instead of %u KB", sourceCount, partCount,
+		(unsigned)keys.size(), (unsigned)(batchedBytes / 1024), (unsigned)(sourceBytes / 1024));
+	sources.clear();
+}
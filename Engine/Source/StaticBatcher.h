@@ -0,0 +1,59 @@
+#pragma once
+#include <vector>
+#include <string>
+#include "Geometry/AABB.h"
+#include "Math/float4x4.h"
+#include "GeometryArena.h"
+
+namespace tinygltf
+{
+	class Model;
+	class Mesh;
+	class Primitive;
+}
+
+class Mesh;
+
+//Primitives drawn by more nodes than this stay instanced, copying them would cost more memory than the draws it saves
+#define STATIC_BATCH_MAX_INSTANCES 8
+
+// Import time merge of static primitives that share a material into a single mesh, with every
+// vertex transformed to world space by its node, so a batch draws with an identity transform.
+// Each source instance stays a MeshPart, with its own index range and box, so culling still
+// skips parts and the visible parts that are next to each other in the index buffer draw as one range.
+// Parts are ordered along the longest axis of the batch, which keeps neighbours in space next to each
+// other in the buffer and the visible ranges long.
+class StaticBatcher
+{
+public:
+	StaticBatcher();
+	~StaticBatcher();
+
+	void Add(const tinygltf::Model& srcModel, const tinygltf::Mesh& srcMesh, const tinygltf::Primitive& primitive, const std::vector<float4x4>& transforms, bool occluder);
+	//Uploads one mesh per material and texture coordinate layout
+	void Build(GeometryArena* arena, std::vector<Mesh*>& batches);
+
+	inline unsigned GetSourceCount() const { return sourceCount; }
+	inline unsigned GetPartCount() const { return partCount; }
+	//Geometry the sources would have taken as instanced meshes, and what the batches take
+	inline size_t GetSourceBytes() const { return sourceBytes; }
+	inline size_t GetBatchedBytes() const { return batchedBytes; }
+
+private:
+	struct Source
+	{
+		int materialIndex = -1;
+		bool hasUV = false;
+		bool occluder = false;
+		std::vector<ArenaVertex> vertices;
+		std::vector<unsigned> indices;
+		std::vector<float4x4> transforms;
+		std::vector<AABB> bounds; //World box of each transform
+	};
+
+	std::vector<Source> sources;
+	unsigned sourceCount = 0;
+	unsigned partCount = 0;
+	size_t sourceBytes = 0;
+	size_t batchedBytes = 0;
+};
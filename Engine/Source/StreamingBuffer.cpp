@@ -0,0 +1,118 @@
+#include "StreamingBuffer.h"
+#include <GL/glew.h>
+#include <cstring>
+#include "Globals.h"
+
+//Upper bound for waiting on a region, one second in nanoseconds
+#define FENCE_TIMEOUT 1000000000
+
+StreamingBuffer::StreamingBuffer() {
+
+}
+
+StreamingBuffer::~StreamingBuffer() {
+
+}
+
+bool StreamingBuffer::Init(size_t frameSize) {
+	this->frameSize = frameSize;
+	const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+	const GLsizeiptr totalSize = frameSize * STREAMING_FRAMES_IN_FLIGHT;
+
+	glGenBuffers(1, &buffer);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+	glBufferStorage(GL_COPY_WRITE_BUFFER, totalSize, nullptr, flags);
+	mapped = (unsigned char*)glMapBufferRange(GL_COPY_WRITE_BUFFER, 0, totalSize, flags);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+	if (mapped == nullptr) {
+		LOG("Streaming buffer: persistent mapping of %u bytes failed", (unsigned)totalSize);
+		Destroy();
+		return false;
+	}
+	frame = 0;
+	cursor = 0;
+	return true;
+}
+
+void StreamingBuffer::Destroy() {
+	for (int i = 0; i < STREAMING_FRAMES_IN_FLIGHT; ++i) {
+		if (fences[i] != nullptr) {
+			glDeleteSync(fences[i]);
+			fences[i] = nullptr;
+		}
+	}
+	if (mapped != nullptr) {
+		glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+		glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+		mapped = nullptr;
+	}
+	glDeleteBuffers(1, &buffer);
+	buffer = 0;
+}
+
+//Moves to the next region, waiting only if the GPU has not finished the frame that last used it.
+//With three regions that frame was submitted two frames ago, so the fence is normally already signalled.
+void StreamingBuffer::BeginFrame() {
+	frame = (frame + 1) % STREAMING_FRAMES_IN_FLIGHT;
+	cursor = 0;
+
+	GLsync fence = fences[frame];
+	if (fence == nullptr) {
+		return;
+	}
+	GLenum result = glClientWaitSync(fence, 0, 0);
+	if (result == GL_TIMEOUT_EXPIRED) {
+		++stallCount;
+		result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, FENCE_TIMEOUT);
+	}
+	if (result == GL_WAIT_FAILED) {
+		LOG("Streaming buffer: fence wait failed");
+	}
+	glDeleteSync(fence);
+	fences[frame] = nullptr;
+}
+
+void StreamingBuffer::EndFrame() {
+	if (mapped == nullptr) {
+		return;
+	}
+	fences[frame] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+size_t StreamingBuffer::Write(const void* data, size_t size, size_t alignment) {
+	if (mapped == nullptr) {
+		return INVALID_OFFSET;
+	}
+	//Aligned from the start of the buffer, which is what binding offsets are checked against.
+	//Alignments are not always powers of two, vertex strides for instance.
+	const size_t regionStart = frame * frameSize;
+	size_t bufferOffset = (regionStart + cursor + alignment - 1) / alignment * alignment;
+	if (bufferOffset + size > regionStart + frameSize) {
+		++overflowCount;
+		return INVALID_OFFSET;
+	}
+	cursor = bufferOffset + size - regionStart;
+
+	memcpy(mapped + bufferOffset, data, size);
+	return bufferOffset;
+}
+
+BufferSlice StreamingBuffer::Stream(unsigned fallbackBuffer, const void* data, size_t size, size_t alignment) {
+	BufferSlice slice;
+	slice.size = size;
+	size_t offset = Write(data, size, alignment);
+	if (offset != INVALID_OFFSET) {
+		slice.buffer = buffer;
+		slice.offset = offset;
+		return slice;
+	}
+
+	glBindBuffer(GL_COPY_WRITE_BUFFER, fallbackBuffer);
+	glBufferData(GL_COPY_WRITE_BUFFER, size, data, GL_STREAM_DRAW);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+	slice.buffer = fallbackBuffer;
+	slice.offset = 0;
+	return slice;
+}
@@ -0,0 +1,57 @@
+#pragma once
+#include <cstddef>
+
+struct __GLsync;
+
+//Where one of the per frame arrays was written: a range of the streaming ring,
+//or the whole of the caller's own buffer when the ring was full
+struct BufferSlice
+{
+	unsigned buffer = 0;
+	size_t offset = 0;
+	size_t size = 0;
+};
+
+#define STREAMING_FRAMES_IN_FLIGHT 3
+
+// Ring of per frame regions inside one buffer created with glBufferStorage and kept
+// persistently and coherently mapped. The CPU writes the current frame's region with
+// plain memcpy while the GPU still reads the previous ones, a fence per region tells
+// when it can be reused. Nothing is ever orphaned or synchronised implicitly by the driver.
+// The buffer has no fixed target: vertices, indirect commands, SSBOs and UBOs are bound
+// straight from it with the offset Write returns.
+class StreamingBuffer
+{
+public:
+	StreamingBuffer();
+	~StreamingBuffer();
+
+	bool Init(size_t frameSize);
+	void Destroy();
+	void BeginFrame();
+	void EndFrame();
+	//Copies size bytes into the current frame's region and returns their offset in the buffer,
+	//or INVALID_OFFSET when the region is full and the caller has to fall back to its own buffer
+	size_t Write(const void* data, size_t size, size_t alignment = 4);
+	//Write, falling back to respecifying fallbackBuffer (orphaning it) when the region is full
+	BufferSlice Stream(unsigned fallbackBuffer, const void* data, size_t size, size_t alignment = 4);
+
+	inline unsigned GetBuffer() const { return buffer; }
+	inline size_t GetFrameSize() const { return frameSize; }
+	inline size_t GetFrameUsed() const { return cursor; }
+	//Frames where BeginFrame found the GPU still reading the region and had to block
+	inline unsigned GetStallCount() const { return stallCount; }
+	inline unsigned GetOverflowCount() const { return overflowCount; }
+
+	static const size_t INVALID_OFFSET = (size_t)-1;
+
+private:
+	unsigned buffer = 0;
+	unsigned char* mapped = nullptr;
+	size_t frameSize = 0;
+	size_t cursor = 0;
+	unsigned frame = 0;
+	__GLsync* fences[STREAMING_FRAMES_IN_FLIGHT] = {};
+	unsigned stallCount = 0;
+	unsigned overflowCount = 0;
+};
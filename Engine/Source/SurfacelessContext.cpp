@@ -0,0 +1,67 @@
+#ifndef _WIN32
+#include "Globals.h"
+#include "SurfacelessContext.h"
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include <stdlib.h>
+
+static EGLDisplay display = EGL_NO_DISPLAY;
+
+void* SurfacelessContext::Create()
+{
+	//llvmpipe implements what the engine uses but reports a lower version, without the override
+	//it refuses the 4.6 compatibility context. Values already in the environment win.
+	setenv("MESA_GL_VERSION_OVERRIDE", "4.6COMPAT", 0);
+	setenv("MESA_GLSL_VERSION_OVERRIDE", "460", 0);
+
+	PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay = (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+	if (getPlatformDisplay == nullptr) {
+		LOG("EGL_EXT_platform_base not available");
+		return nullptr;
+	}
+	display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+	EGLint major = 0, minor = 0;
+	if (display == EGL_NO_DISPLAY || !eglInitialize(display, &major, &minor)) {
+		LOG("Could not initialize the surfaceless EGL display: 0x%x", eglGetError());
+		return nullptr;
+	}
+	LOG("EGL %d.%d (%s)", major, minor, eglQueryString(display, EGL_VENDOR));
+
+	//The surfaceless platform exposes no configs, the context is created without one
+	eglBindAPI(EGL_OPENGL_API);
+	const EGLint attributes[] = {
+		EGL_CONTEXT_MAJOR_VERSION, 4,
+		EGL_CONTEXT_MINOR_VERSION, 6,
+		EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_COMPATIBILITY_PROFILE_BIT,
+		EGL_CONTEXT_OPENGL_DEBUG, EGL_TRUE,
+		EGL_NONE
+	};
+	EGLContext context = eglCreateContext(display, EGL_NO_CONFIG_KHR, EGL_NO_CONTEXT, attributes);
+	if (context == EGL_NO_CONTEXT) {
+		LOG("Could not create the surfaceless OpenGL 4.6 context: 0x%x", eglGetError());
+		eglTerminate(display);
+		display = EGL_NO_DISPLAY;
+		return nullptr;
+	}
+	MakeCurrent(context);
+	return context;
+}
+
+bool SurfacelessContext::MakeCurrent(void* context)
+{
+	return eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context != nullptr ? (EGLContext)context : EGL_NO_CONTEXT) == EGL_TRUE;
+}
+
+void SurfacelessContext::Destroy(void* context)
+{
+	if (display == EGL_NO_DISPLAY) {
+		return;
+	}
+	MakeCurrent(nullptr);
+	if (context != nullptr) {
+		eglDestroyContext(display, (EGLContext)context);
+	}
+	eglTerminate(display);
+	display = EGL_NO_DISPLAY;
+}
+#endif
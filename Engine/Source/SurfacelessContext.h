@@ -0,0 +1,14 @@
+#pragma once
+
+//OpenGL context with no window or display server behind it, for headless runs on Linux.
+//Frames go to ModuleHeadless' framebuffer, so Mesa's surfaceless EGL platform is enough and
+//llvmpipe renders them on machines without a GPU. Windows keeps the hidden SDL window.
+class SurfacelessContext
+{
+public:
+	//Returns the EGLContext, nullptr on failure
+	static void* Create();
+	//nullptr releases the current context from the calling thread
+	static bool MakeCurrent(void* context);
+	static void Destroy(void* context);
+};
@@ -0,0 +1,20 @@
+#pragma once
+
+//CPU copy of a loaded texture. DirectXTex is Windows only, the portable build (ENGINE_NO_DIRECTXTEX)
+//decodes with stb_image into a single RGBA8 level and lets the driver build the mip chain.
+#ifdef ENGINE_NO_DIRECTXTEX
+#include <vector>
+
+struct TextureImage
+{
+	unsigned width = 0, height = 0;
+	std::vector<unsigned char> pixels;
+};
+#else
+namespace DirectX
+{
+	class ScratchImage;
+}
+
+typedef DirectX::ScratchImage TextureImage;
+#endif
@@ -2,8 +2,13 @@
 #include "Globals.h"
 #include "Application.h"
 #include "ModuleEditor.h"
+#include <stdarg.h>
+#include <mutex>
 void log(const char file[], int line, const char* format, ...)
 {
+	//The render thread logs too, the buffers below are shared
+	static std::mutex mutex;
+	std::lock_guard<std::mutex> lock(mutex);
 	static char tmp_string[4096];
 	static char tmp_string2[4096];
 	static va_list  ap;
@@ -13,9 +18,17 @@ void log(const char file[], int line, const char* format, ...)
 	vsprintf_s(tmp_string, 4096, format, ap);
 	va_end(ap);
 	sprintf_s(tmp_string2, 4096, "\n%s(%d) : %s", file, line, tmp_string);
+#ifdef _WIN32
 	OutputDebugString(tmp_string2);
+	//Nobody watches the debugger output on an automated run
+	if (App != nullptr && App->IsHeadless()) {
+		fputs(tmp_string2, stdout);
+	}
+#else
+	fputs(tmp_string2, stdout);
+#endif
 
-	if (App != nullptr) {
+	if (App != nullptr && App->GetEditor() != nullptr) {
 		//App->GetEditor()->logs.appendf(tmp_string2);
 		App->GetEditor()->AddLog(tmp_string2);
 	}